@@ -0,0 +1,127 @@
+/**
+ * @file csv-aggregate.h
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Header file for the column aggregate kernels
+ * @version 0.1
+ * @date 2025-01-17
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef CSV_AGGREGATE
+#define CSV_AGGREGATE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/************ MOMENTS ************/
+
+typedef struct csv_moments {
+  size_t count;
+
+  /* -- INT_TYPE kernels, the exact sum is int_carry * 2^64 + int_sum, the
+   * carry counts the times the 64 bit sum wrapped up or down */
+  int64_t int_sum;
+  int64_t int_carry;
+  int64_t int_min;
+  int64_t int_max;
+
+  /* -- DOUBLE_TYPE kernels, sums of value - shift and of its square, the
+   * errors are only kept by compensated kernels */
+  double sum;
+  double sum_error;
+  double squares;
+  double squares_error;
+
+  double min;
+  double max;
+} CSV_MOMENTS;
+
+/************ KERNELS ************/
+
+/**
+ * @brief Portable kernel, keep may be NULL or hold one byte per value, values
+ * with a 0 byte are skipped
+ *
+ * @param data
+ * @param keep
+ * @param length
+ * @param moments
+ */
+void csv_agg_int_scalar(const int64_t *data, const uint8_t *keep,
+                        size_t length, CSV_MOMENTS *moments);
+
+/**
+ * @brief Portable kernel, see csv_agg_int_scalar()
+ *
+ * @param data
+ * @param keep
+ * @param length
+ * @param shift
+ * @param compensated
+ * @param moments
+ */
+void csv_agg_double_scalar(const double *data, const uint8_t *keep,
+                           size_t length, double shift, bool compensated,
+                           CSV_MOMENTS *moments);
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/**
+ * @brief AVX2 kernel, 4 values per step
+ *
+ * @param data
+ * @param keep
+ * @param length
+ * @param moments
+ */
+void csv_agg_int_avx2(const int64_t *data, const uint8_t *keep, size_t length,
+                      CSV_MOMENTS *moments);
+
+/**
+ * @brief AVX2 kernel, 4 values per step in 4 independent lanes
+ *
+ * @param data
+ * @param keep
+ * @param length
+ * @param shift
+ * @param compensated
+ * @param moments
+ */
+void csv_agg_double_avx2(const double *data, const uint8_t *keep,
+                         size_t length, double shift, bool compensated,
+                         CSV_MOMENTS *moments);
+
+#endif
+
+/************ AGGREGATE API ************/
+
+/**
+ * @brief Add count, sum, minimum and maximum of length integers to moments,
+ * using the best kernel the CPU supports
+ *
+ * @param data
+ * @param keep
+ * @param length
+ * @param moments
+ */
+void csv_agg_int(const int64_t *data, const uint8_t *keep, size_t length,
+                 CSV_MOMENTS *moments);
+
+/**
+ * @brief Add count, minimum, maximum and the sums of value - shift and its
+ * square of length doubles to moments, using the best kernel the CPU supports
+ *
+ * @param data
+ * @param keep
+ * @param length
+ * @param shift
+ * @param compensated
+ * @param moments
+ */
+void csv_agg_double(const double *data, const uint8_t *keep, size_t length,
+                    double shift, bool compensated, CSV_MOMENTS *moments);
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * @file csv-arena.h
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Header file for the CSV_LIST arena and allocator hooks
+ * @version 0.1
+ * @date 2025-01-11
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef CSV_ALLOC
+#define CSV_ALLOC
+
+#include <libcsv.h>
+#include <stddef.h>
+
+/************ ALLOCATOR API ************/
+
+/**
+ * @brief Allocator used when no allocator is given, backed by malloc
+ */
+extern const CSV_ALLOCATOR csv_malloc_allocator;
+
+/**
+ * @brief Grow or shrink an allocation, data may be NULL for a new allocation
+ *
+ * @param allocator
+ * @param data
+ * @param old_size
+ * @param size
+ * @return void*
+ */
+void *csv_alloc_resize(CSV_ALLOCATOR *allocator, void *data, size_t old_size,
+                       size_t size);
+
+/**
+ * @brief Give an allocation back, data may be NULL
+ *
+ * @param allocator
+ * @param data
+ * @param size
+ */
+void csv_alloc_release(CSV_ALLOCATOR *allocator, void *data, size_t size);
+
+/************ ARENA API ************/
+
+/**
+ * @brief Bump allocate zeroed memory from the arena, it is only given back
+ * when the whole arena is released
+ *
+ * @param arena
+ * @param size
+ * @return void*
+ */
+void *csv_arena_alloc(CSV_ARENA *arena, size_t size);
+
+/**
+ * @brief Copy a string into the arena
+ *
+ * @param arena
+ * @param string
+ * @return char*
+ */
+char *csv_arena_string(CSV_ARENA *arena, const char *string);
+
+/**
+ * @brief Release every block of the arena
+ *
+ * @param arena
+ */
+void csv_arena_release(CSV_ARENA *arena);
+
+/**
+ * @brief Create an empty CSV_LIST and its metadata inside a new arena, NULL
+ * allocator uses malloc
+ *
+ * @param allocator
+ * @param metadata
+ * @return CSV_LIST*
+ */
+CSV_LIST *csv_arena_list(CSV_ALLOCATOR *allocator, CSV_METADATA **metadata);
+
+#endif
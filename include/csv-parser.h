@@ -0,0 +1,115 @@
+/**
+ * @file csv-parser.h
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Header file for the RFC 4180 row parser
+ * @version 0.1
+ * @date 2025-01-10
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef CSV_PARSE
+#define CSV_PARSE
+
+#include <csv-scan.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/************ FIELD SPAN ************/
+
+#define CSV_SPAN_QUOTED 0x1
+#define CSV_SPAN_ESCAPED 0x2
+
+typedef struct csv_span {
+  size_t begin;
+  size_t length;
+
+  unsigned flags;
+} CSV_SPAN;
+
+/************ PARSER ************/
+
+typedef enum {
+  CSV_STATE_FIELD,
+  CSV_STATE_QUOTED,
+  CSV_STATE_QUOTE,
+  CSV_STATE_AFTER_QUOTE,
+  CSV_STATES
+} CSV_STATE;
+
+typedef enum {
+  CSV_CLASS_DELIMITER,
+  CSV_CLASS_QUOTE,
+  CSV_CLASS_NEWLINE,
+  CSV_CLASSES
+} CSV_CLASS;
+
+typedef enum {
+  CSV_ACTION_NONE,
+  CSV_ACTION_FIELD,
+  CSV_ACTION_ROW,
+  CSV_ACTION_OPEN,
+  CSV_ACTION_CLOSE,
+  CSV_ACTION_ESCAPE
+} CSV_ACTION;
+
+typedef struct csv_parser {
+  CSV_SCANNER scanner;
+
+  /* -- Next structural position and start of the next row */
+  size_t next;
+  size_t row;
+
+  /* -- Field boundaries of the current row */
+  CSV_SPAN *fields;
+  unsigned max_fields;
+} CSV_PARSER;
+
+/************ PARSER API ************/
+
+/**
+ * @brief Index a block of data and rewind the row cursor
+ *
+ * @param parser
+ * @param data
+ * @param length
+ * @return int
+ */
+int csv_parse_block(CSV_PARSER *parser, const char *data, size_t length);
+
+/**
+ * @brief Collect the field boundaries of the next row into parser->fields
+ *
+ * Quoted fields may hold delimiters, newlines and doubled quotes, empty
+ * fields are kept and blank lines are skipped. Returns false when no complete
+ * row is left, parser->row is then the offset of the partial row; with last
+ * set, a trailing row without a newline counts as complete.
+ *
+ * @param parser
+ * @param last
+ * @param fields
+ * @return true
+ * @return false
+ */
+bool csv_parse_row(CSV_PARSER *parser, bool last, unsigned *fields);
+
+/**
+ * @brief Copy a quoted field, collapsing doubled quotes, returns the length
+ * of the copy. output may be data.
+ *
+ * @param data
+ * @param length
+ * @param output
+ * @return size_t
+ */
+size_t csv_parse_unescape(const char *data, size_t length, char *output);
+
+/**
+ * @brief Free the parser index and field boundaries
+ *
+ * @param parser
+ */
+void csv_parse_free(CSV_PARSER *parser);
+
+#endif
@@ -0,0 +1,105 @@
+/**
+ * @file csv-scan.h
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Header file for the structural character scanner
+ * @version 0.1
+ * @date 2025-01-09
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef CSV_SCAN
+#define CSV_SCAN
+
+#include <stddef.h>
+#include <stdint.h>
+
+/************ SCANNER ************/
+
+typedef struct csv_scanner {
+  const char *data;
+  size_t length;
+
+  /* -- Offsets of every delimiter, quote and newline in data */
+  uint32_t *positions;
+  size_t count;
+  size_t capacity;
+} CSV_SCANNER;
+
+/************ KERNELS ************/
+
+/**
+ * @brief Portable kernel, positions needs room for length + 1 entries: one
+ * per byte and a scratch slot written past the last match
+ *
+ * @param data
+ * @param length
+ * @param delimiter
+ * @param positions
+ * @return size_t
+ */
+size_t csv_scan_scalar(const char *data, size_t length, char delimiter,
+                       uint32_t *positions);
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/**
+ * @brief SSE2 kernel, 16 bytes per step, positions as for the portable one
+ *
+ * @param data
+ * @param length
+ * @param delimiter
+ * @param positions
+ * @return size_t
+ */
+size_t csv_scan_sse2(const char *data, size_t length, char delimiter,
+                     uint32_t *positions);
+
+/**
+ * @brief AVX2 kernel, 32 bytes per step, positions as for the portable one
+ *
+ * @param data
+ * @param length
+ * @param delimiter
+ * @param positions
+ * @return size_t
+ */
+size_t csv_scan_avx2(const char *data, size_t length, char delimiter,
+                     uint32_t *positions);
+
+#endif
+
+/************ SCANNER API ************/
+
+/**
+ * @brief Find every structural character of data in one pass, using the best
+ * kernel the CPU supports. positions needs room for length + 1 entries.
+ *
+ * @param data
+ * @param length
+ * @param delimiter
+ * @param positions
+ * @return size_t
+ */
+size_t csv_scan(const char *data, size_t length, char delimiter,
+                uint32_t *positions);
+
+/**
+ * @brief Index a block of data, the index is grown to length + 1 entries
+ *
+ * @param scanner
+ * @param data
+ * @param length
+ * @return int
+ */
+int csv_scan_reset(CSV_SCANNER *scanner, const char *data, size_t length);
+
+/**
+ * @brief Free the scanner index
+ *
+ * @param scanner
+ */
+void csv_scan_free(CSV_SCANNER *scanner);
+
+#endif
@@ -12,28 +12,665 @@
 #ifndef CSV_UTILS
 #define CSV_UTILS
 
+#include <csv-parser.h>
 #include <libcsv.h>
 #include <stdio.h>
+#include <sys/stat.h>
+
+/************ WRITER ************/
+
+typedef struct csv_writer {
+  FILE *stream;
+
+  char *buffer;
+  size_t size;
+  size_t used;
+
+  bool error;
+} CSV_WRITER;
+
+/**
+ * @brief CSV utility function to make room for length more bytes in the
+ * string pool
+ *
+ * @param string_pool
+ * @param length
+ * @return int
+ */
+int csv_util_pool_reserve(CSV_STRING_POOL *string_pool, size_t length);
+
+/**
+ * @brief CSV utility function to copy a string into the string pool, returns
+ * the offset of the copy or SIZE_MAX
+ *
+ * @param string_pool
+ * @param string
+ * @param length
+ * @return size_t
+ */
+size_t csv_util_pool_add(CSV_STRING_POOL *string_pool, const char *string,
+                         size_t length);
+
+/**
+ * @brief CSV utility function to store a string, strings inside the file
+ * mapping are referenced instead of copied
+ *
+ * @param string_pool
+ * @param string
+ * @param length
+ * @return size_t
+ */
+size_t csv_util_pool_store(CSV_STRING_POOL *string_pool, const char *string,
+                           size_t length);
+
+/**
+ * @brief CSV utility function to resolve a string pool offset, offsets below
+ * mapped_size point into the file mapping
+ *
+ * @param string_pool
+ * @param offset
+ * @return char*
+ */
+char *csv_util_string(CSV_STRING_POOL *string_pool, size_t offset);
+
+/**
+ * @brief CSV utility function to grow column storage to hold rows
+ *
+ * @param field_list
+ * @param rows
+ * @return int
+ */
+int csv_util_reserve(CSV_FIELD_LIST *field_list, size_t rows);
+
+/**
+ * @brief CSV utility function to convert a column to a wider type
+ *
+ * @param field_list
+ * @param field_type
+ * @return int
+ */
+int csv_util_promote(CSV_FIELD_LIST *field_list, CSV_FIELD_TYPE field_type);
+
+/**
+ * @brief CSV utility function to store the string of a CHAR_TYPE cell, plain
+ * or dictionary encoded
+ *
+ * @param field_list
+ * @param row
+ * @param string
+ * @param length
+ * @return int
+ */
+int csv_util_set_string(CSV_FIELD_LIST *field_list, size_t row,
+                        const char *string, size_t length);
+
+/**
+ * @brief CSV utility function to get the string of a CHAR_TYPE cell
+ *
+ * @param field_list
+ * @param row
+ * @param length
+ * @return char*
+ */
+char *csv_util_char(CSV_FIELD_LIST *field_list, size_t row, size_t *length);
+
+/************ DICTIONARY ************/
+
+/**
+ * @brief CSV utility function to switch an empty or numeric column to
+ * dictionary encoded strings
+ *
+ * @param field_list
+ * @return int
+ */
+int csv_util_dictionary_create(CSV_FIELD_LIST *field_list);
+
+/**
+ * @brief CSV utility function to grow the code array to capacity rows
+ *
+ * @param field_list
+ * @param capacity
+ * @return int
+ */
+int csv_util_dictionary_reserve(CSV_FIELD_LIST *field_list, size_t capacity);
+
+/**
+ * @brief CSV utility function to read the code of a row
+ *
+ * @param dictionary
+ * @param row
+ * @return uint32_t
+ */
+uint32_t csv_util_dictionary_code(CSV_DICTIONARY *dictionary, size_t row);
+
+/**
+ * @brief CSV utility function to write the code of a row
+ *
+ * @param dictionary
+ * @param row
+ * @param code
+ */
+void csv_util_dictionary_set(CSV_DICTIONARY *dictionary, size_t row,
+                             uint32_t code);
+
+/**
+ * @brief CSV utility function to look up the code of a string
+ *
+ * @param field_list
+ * @param string
+ * @param length
+ * @return uint32_t
+ */
+uint32_t csv_util_dictionary_find(CSV_FIELD_LIST *field_list,
+                                  const char *string, size_t length);
+
+/**
+ * @brief CSV utility function to get the code of a string, adding it to the
+ * dictionary when it is new. Codes are widened as the dictionary grows.
+ *
+ * @param field_list
+ * @param string
+ * @param length
+ * @return uint32_t
+ */
+uint32_t csv_util_dictionary_intern(CSV_FIELD_LIST *field_list,
+                                    const char *string, size_t length);
+
+/**
+ * @brief CSV utility function to build the hash table of the values a
+ * dictionary already holds, e.g. after they were loaded
+ *
+ * @param field_list
+ * @return int
+ */
+int csv_util_dictionary_index(CSV_FIELD_LIST *field_list);
+
+/**
+ * @brief CSV utility function to turn a dictionary encoded column back into
+ * plain string offsets
+ *
+ * @param field_list
+ * @return int
+ */
+int csv_util_dictionary_decode(CSV_FIELD_LIST *field_list);
+
+/**
+ * @brief CSV utility function to free the dictionary of a column
+ *
+ * @param field_list
+ */
+void csv_util_dictionary_free(CSV_FIELD_LIST *field_list);
+
+/************ CELLS ************/
 
 /**
- * @brief CSV utility function to add a node to CSV_LIST
+ * @brief CSV utility function to append a cell to a column of CSV_LIST
  *
  * @param csv_list
  * @param field
  * @param data
+ * @param length
  * @param csv_field_type
  */
-void csv_util_add_node(CSV_LIST *csv_list, unsigned field, void *data,
-                       CSV_FIELD_TYPE csv_field_type);
+void csv_util_add_cell(CSV_LIST *csv_list, unsigned field, void *data,
+                       size_t length, CSV_FIELD_TYPE csv_field_type);
+
+/**
+ * @brief CSV utility function to append an empty cell to a column of CSV_LIST
+ *
+ * @param csv_list
+ * @param field
+ */
+void csv_util_add_null(CSV_LIST *csv_list, unsigned field);
+
+/**
+ * @brief CSV utility function to trim a raw token and detect its type, the
+ * importer and the streaming reader share it
+ *
+ * @param token
+ * @param length
+ * @param cell
+ */
+void csv_util_convert(const char *token, size_t length, unsigned flags,
+                      CSV_CELL *cell);
+
+/**
+ * @brief CSV utility function to mark a row as removed
+ *
+ * @param tombstones
+ * @param row
+ * @return int
+ */
+int csv_util_tombstone(CSV_TOMBSTONES *tombstones, size_t row);
+
+/**
+ * @brief CSV utility function to check whether a row is marked as removed
+ *
+ * @param tombstones
+ * @param row
+ * @return bool
+ */
+bool csv_util_row_dead(const CSV_TOMBSTONES *tombstones, size_t row);
+
+/**
+ * @brief CSV utility function to drop the removed rows of a column
+ *
+ * @param field_list
+ */
+void csv_util_compact_field(CSV_FIELD_LIST *field_list);
+
+/**
+ * @brief CSV utility function to gather the rows listed in order to the
+ * front of a column, scratch holds total_rows words
+ *
+ * @param field_list
+ * @param order
+ * @param total_rows
+ * @param scratch
+ */
+void csv_util_permute_field(CSV_FIELD_LIST *field_list, const size_t *order,
+                            size_t total_rows, uint64_t *scratch);
+
+/**
+ * @brief CSV utility function to give the null rows counted before a column
+ * had storage their null flags and placeholders
+ *
+ * @param field_list
+ * @return int
+ */
+int csv_util_fill_nulls(CSV_FIELD_LIST *field_list);
+
+/**
+ * @brief CSV utility function to check whether a cell is null
+ *
+ * @param field_list
+ * @param row
+ * @return bool
+ */
+bool csv_util_is_null(const CSV_FIELD_LIST *field_list, size_t row);
+
+/**
+ * @brief CSV utility function to read a stored cell of a column into CSV_CELL
+ *
+ * @param field_list
+ * @param row
+ * @param cell
+ */
+void csv_util_fill_cell(CSV_FIELD_LIST *field_list, size_t row,
+                        CSV_CELL *cell);
+
+/**
+ * @brief CSV utility function to convert a token to an integer
+ *
+ * @param token
+ * @param length
+ * @param data
+ * @return int
+ */
+int csv_util_convert_int(const char *token, size_t length, int64_t *data);
+
+/**
+ * @brief CSV utility function to convert a token to a double
+ *
+ * @param token
+ * @param length
+ * @param data
+ * @return int
+ */
+int csv_util_convert_double(const char *token, size_t length, double *data);
+
+/**
+ * @brief CSV utility function to trim, type and append a raw token. Columns
+ * with a settled type use their converter only.
+ *
+ * @param csv_list
+ * @param field
+ * @param token
+ * @param length
+ * @param flags
+ */
+void csv_util_parse_cell(CSV_LIST *csv_list, unsigned field,
+                         const char *token, size_t length, unsigned flags);
+
+/**
+ * @brief CSV utility function to copy a header field into a new string
+ *
+ * @param data
+ * @param span
+ * @return char*
+ */
+char *csv_util_field_name(const char *data, CSV_SPAN *span);
+
+/**
+ * @brief CSV utility function to look up a field name in the name index
+ *
+ * @param csv_list
+ * @param field
+ * @return int column number, -1 if the field is not found
+ */
+int csv_util_field_find(CSV_LIST *csv_list, const char *field);
+
+/**
+ * @brief CSV utility function to make room for fields columns in CSV_LIST,
+ * new descriptors are reserved side by side
+ *
+ * @param csv_list
+ * @param metadata
+ * @param fields
+ * @return int
+ */
+int csv_util_reserve_fields(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                            unsigned fields);
+
+/**
+ * @brief CSV utility function to append a field to CSV_LIST, the field name
+ * is copied into the list arena and added to the name index
+ *
+ * @param csv_list
+ * @param metadata
+ * @param field
+ * @return int
+ */
+int csv_util_add_field(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                       const char *field);
+
+/**
+ * @brief CSV utility function to add the fields of a header, or only the
+ * projected ones when the import asked for a projection
+ *
+ * @param csv_list
+ * @param metadata
+ * @param names
+ * @param total_fields
+ * @return int
+ */
+int csv_util_add_fields(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                        char **names, unsigned total_fields);
+
+/**
+ * @brief CSV utility function to create the fields of CSV_LIST from the
+ * header line
+ *
+ * @param csv_list
+ * @param metadata
+ * @param data
+ * @param fields
+ * @param total_fields
+ */
+void csv_util_add_header(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                         const char *data, CSV_SPAN *fields,
+                         unsigned total_fields);
+
+/**
+ * @brief CSV utility function to apply a caller supplied schema to the
+ * fields of CSV_LIST
+ *
+ * @param csv_list
+ * @param metadata
+ * @param schema
+ */
+void csv_util_apply_schema(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                           CSV_SCHEMA *schema);
+
+/**
+ * @brief CSV utility function to settle the type of every guessed column
+ * that has seen a value
+ *
+ * @param csv_list
+ * @param metadata
+ */
+void csv_util_infer_schema(CSV_LIST *csv_list, CSV_METADATA *metadata);
+
+/**
+ * @brief CSV utility function to append a parsed row, rows with
+ * a different number of fields are skipped
+ *
+ * @param csv_list
+ * @param metadata
+ * @param data
+ * @param fields
+ * @param total_fields
+ * @return int, -1 when the row could not be stored, nothing of it is then
+ */
+int csv_util_add_line(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                      const char *data, CSV_SPAN *fields,
+                      unsigned total_fields);
+
+/**
+ * @brief CSV utility function to collapse the doubled quotes of a token into
+ * the list scratch buffer, token then points into it
+ *
+ * @param csv_list
+ * @param token
+ * @param length
+ * @return int
+ */
+int csv_util_unescape(CSV_LIST *csv_list, const char **token, size_t *length);
+
+/**
+ * @brief CSV utility function to resolve a predicate against the header,
+ * the filter is allocated from the list arena
+ *
+ * @param csv_list
+ * @param predicate
+ * @param names
+ * @param total_fields
+ * @return CSV_FILTER*
+ */
+CSV_FILTER *csv_util_filter_compile(CSV_LIST *csv_list,
+                                    const CSV_PREDICATE *predicate,
+                                    char **names, unsigned total_fields);
+
+/**
+ * @brief CSV utility function to test a row on its raw fields, only the
+ * fields the filter looks at are converted
+ *
+ * @param csv_list
+ * @param filter
+ * @param data
+ * @param fields
+ * @param total_fields
+ * @return true
+ * @return false
+ */
+bool csv_util_filter_row(CSV_LIST *csv_list, const CSV_FILTER *filter,
+                         const char *data, CSV_SPAN *fields,
+                         unsigned total_fields);
+
+/**
+ * @brief CSV utility function to copy the import options kept by CSV_LIST
+ *
+ * @param csv_list
+ * @param options
+ */
+void csv_util_prepare(CSV_LIST *csv_list, CSV_OPTIONS *options);
+
+/**
+ * @brief CSV utility function to drop the state only used while importing,
+ * rows added later have the layout of the list
+ *
+ * @param csv_list
+ */
+void csv_util_end_import(CSV_LIST *csv_list);
 
 /**
- * @brief CSV utility function to print data based on the stream
+ * @brief CSV utility function to map a whole file read only, an empty file
+ * gives a NULL mapping of size 0
+ *
+ * @param csv_file
+ * @param data
+ * @param size
+ * @return int
+ */
+int csv_util_map_file(const char *csv_file, const char **data, size_t *size);
+
+/**
+ * @brief CSV utility function to import a file through a read only memory
+ * mapping, string cells stay views into the mapping
+ *
+ * @param csv_file
+ * @param metadata
+ * @param options
+ * @return CSV_LIST*
+ */
+CSV_LIST *csv_util_import_mmap(char *csv_file, CSV_METADATA **metadata,
+                               CSV_OPTIONS *options);
+
+/**
+ * @brief CSV utility function to import a mapped file with several threads,
+ * each parsing a run of whole rows into its own segment
+ *
+ * @param csv_file
+ * @param metadata
+ * @param options
+ * @return CSV_LIST*
+ */
+CSV_LIST *csv_util_import_parallel(char *csv_file, CSV_METADATA **metadata,
+                                   CSV_OPTIONS *options);
+
+/**
+ * @brief CSV utility function to parse a range of complete rows held in
+ * memory, optionally starting with the header. Stops after max_rows rows and
+ * returns the offset just past the last row parsed, -1 when a row could not
+ * be stored.
+ *
+ * @param csv_list
+ * @param metadata
+ * @param data
+ * @param size
+ * @param header
+ * @param max_rows
+ * @return ptrdiff_t
+ */
+ptrdiff_t csv_util_parse_range(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                               const char *data, size_t size, bool header,
+                               size_t max_rows);
+
+/**
+ * @brief CSV utility function to read from a source until size bytes are in
+ * or the input ends, returns the bytes read or -1
+ *
+ * @param source
+ * @param data
+ * @param size
+ * @return ptrdiff_t
+ */
+ptrdiff_t csv_util_source_fill(CSV_SOURCE *source, char *data, size_t size);
+
+/**
+ * @brief CSV utility function to import the rows of an open reader, the
+ * reader is closed
+ *
+ * @param csv_reader
+ * @param metadata
+ * @param options
+ * @return CSV_LIST*
+ */
+CSV_LIST *csv_util_import_reader(CSV_READER *csv_reader,
+                                 CSV_METADATA **metadata,
+                                 CSV_OPTIONS *options);
+
+/**
+ * @brief CSV utility function to refill the reader buffer after the last
+ * complete row and index it, growing the buffer if one row fills it
+ *
+ * @param csv_reader
+ * @return true
+ * @return false
+ */
+bool csv_util_read_block(CSV_READER *csv_reader);
+
+/**
+ * @brief CSV utility function to parse the next complete row of the reader,
+ * its field boundaries are left in the parser
+ *
+ * @param csv_reader
+ * @param fields
+ * @return true
+ * @return false
+ */
+bool csv_util_read_line(CSV_READER *csv_reader, unsigned *fields);
+
+/**
+ * @brief CSV utility function to write the buffered bytes to the stream
+ *
+ * @param csv_writer
+ * @return int
+ */
+int csv_util_flush(CSV_WRITER *csv_writer);
+
+/**
+ * @brief CSV utility function to append bytes to the output buffer
+ *
+ * @param csv_writer
+ * @param data
+ * @param length
+ */
+void csv_util_write(CSV_WRITER *csv_writer, const char *data, size_t length);
+
+/**
+ * @brief CSV utility function to write a string field, quoting it when it
+ * holds a delimiter, quote, line break or edge spaces
+ *
+ * @param csv_writer
+ * @param data
+ * @param length
+ */
+void csv_util_write_string(CSV_WRITER *csv_writer, const char *data,
+                           size_t length);
+
+/**
+ * @brief CSV utility function to print data based on the stream, rows are
+ * formatted into a buffer of buffer_size bytes before being written. With an
+ * order only the rows it lists are written, in that order.
  *
  * @param csv_list
  * @param csv_stream
  * @param metadata
+ * @param buffer_size
+ * @param order may be NULL
+ * @param total_rows rows in order
  */
 void csv_util_show(CSV_LIST *csv_list, FILE *csv_stream,
-                   CSV_METADATA *metadata);
+                   CSV_METADATA *metadata, size_t buffer_size,
+                   const size_t *order, size_t total_rows);
+
+/**
+ * @brief CSV utility function to write a snapshot of a list, source is the
+ * stat of the CSV file it was imported from or NULL
+ *
+ * @param csv_list
+ * @param metadata
+ * @param snapshot_file
+ * @param source
+ * @return int
+ */
+int csv_util_snapshot_write(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                            const char *snapshot_file,
+                            const struct stat *source);
+
+/**
+ * @brief CSV utility function to import through the snapshot in
+ * options->snapshot, loaded while it is fresh and written again when not
+ *
+ * @param csv_file
+ * @param metadata
+ * @param options
+ * @return CSV_LIST*
+ */
+CSV_LIST *csv_util_import_cached(char *csv_file, CSV_METADATA **metadata,
+                                 CSV_OPTIONS *options);
+
+/**
+ * @brief CSV utility function to import the complete rows of a file and keep
+ * following it, see csv_refresh()
+ *
+ * @param csv_file
+ * @param metadata
+ * @param options
+ * @return CSV_LIST*
+ */
+CSV_LIST *csv_util_import_follow(char *csv_file, CSV_METADATA **metadata,
+                                 CSV_OPTIONS *options);
 
 #endif
\ No newline at end of file
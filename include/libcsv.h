@@ -19,59 +19,440 @@
 #define CSV_BUFFER_SIZE 1024
 #define CSV_DELIMETER ","
 
-#define CSV_MAX_FIELDS 1024
 #define CSV_FILE_NAME 1024
 
 #define CSV_DEFAULT_FILE_NAME "output.csv"
+#define CSV_READER_BUFFER_SIZE (64 << 10)
+#define CSV_SOURCE_BUFFER_SIZE (256 << 10)
+#define CSV_SCAN_BLOCK_SIZE (1 << 20)
+#define CSV_OUTPUT_BUFFER_SIZE (1 << 20)
+
+#define CSV_ARENA_BLOCK_SIZE (64 << 10)
+#define CSV_INITIAL_ROWS 64
+#define CSV_INITIAL_FIELDS 16
+#define CSV_INITIAL_POOL 4096
+
+#define CSV_PARALLEL_CHUNK (1 << 20)
+#define CSV_SCHEMA_SAMPLE 1024
+#define CSV_COMPACT_RATIO 0.25
+
+#define CSV_AGGREGATE_BLOCK 4096
+#define CSV_GROUP_ROWS (1 << 16)
+#define CSV_SORT_ROWS (1 << 16)
+#define CSV_JOIN_PARTITION_ROWS (1 << 15)
+
+#define CSV_SNAPSHOT_VERSION 1
+
+#define CSV_DICTIONARY_LIMIT 65536
+#define CSV_DICTIONARY_SAMPLE 1024
+#define CSV_NO_CODE UINT32_MAX
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/************ FIELD TYPE ************/
+
+typedef enum { CHAR_TYPE, INT_TYPE, DOUBLE_TYPE } CSV_FIELD_TYPE;
+
+/************ ALLOCATOR ************/
+
+typedef struct csv_allocator {
+  void *(*alloc)(size_t size, void *context);
+  void *(*resize)(void *data, size_t old_size, size_t size, void *context);
+  void (*release)(void *data, size_t size, void *context);
+
+  void *context;
+} CSV_ALLOCATOR;
 
-/************ TYPE BLOCKS ************/
+typedef struct csv_arena_block {
+  struct csv_arena_block *next_block;
 
-typedef struct csv_char_block {
-  struct csv_char_block *next_block;
+  size_t size;
+  size_t used;
+} CSV_ARENA_BLOCK;
 
+typedef struct csv_arena {
+  CSV_ALLOCATOR allocator;
+
+  struct csv_arena_block *block_head;
+} CSV_ARENA;
+
+/************ STRING POOL ************/
+
+typedef struct csv_string_pool {
   char *data;
-} CSV_CHAR_BLOCK;
 
-typedef struct csv_int_block {
-  struct csv_int_block *next_block;
+  size_t size;
+  size_t capacity;
 
-  int data;
-} CSV_INT_BLOCK;
+  /* -- Read only file mapping, offsets below mapped_size point into it */
+  const char *mapped_data;
+  size_t mapped_size;
 
-typedef struct csv_double_block {
-  struct csv_double_block *next_block;
+  struct csv_allocator *allocator;
+} CSV_STRING_POOL;
 
-  double data;
-} CSV_DOUBLE_BLOCK;
+/************ TOMBSTONES ************/
 
-/************ FIELD BLOCK ************/
+typedef struct csv_tombstones {
+  /* -- One bit per row, rows past the end of the bitmap are live */
+  uint64_t *bits;
+  size_t words;
 
-typedef enum { CHAR_TYPE, INT_TYPE, DOUBLE_TYPE } CSV_FIELD_TYPE;
+  size_t dead;
+
+  /* -- Removed rows are compacted away once dead > ratio * rows */
+  double ratio;
+
+  struct csv_allocator *allocator;
+} CSV_TOMBSTONES;
+
+/************ SCHEMA ************/
+
+typedef enum {
+  /* -- Every cell is typed on its own and the column widens to fit */
+  CSV_TYPE_GUESSED,
+  /* -- Typed from the sample rows, cells that do not fit still widen it */
+  CSV_TYPE_INFERRED,
+  /* -- Given by the caller, cells that do not fit become nulls */
+  CSV_TYPE_DECLARED
+} CSV_TYPE_SOURCE;
+
+typedef struct csv_schema {
+  unsigned fields;
+
+  /* -- Field names to match, NULL applies the types column by column */
+  const char **field;
+  CSV_FIELD_TYPE *field_type;
+} CSV_SCHEMA;
+
+/************ PROJECTION ************/
+
+typedef struct csv_projection {
+  unsigned fields;
+
+  /* -- Field names to keep, NULL keeps the source columns in column */
+  const char **field;
+  const unsigned *column;
+} CSV_PROJECTION;
+
+/************ PREDICATE ************/
+
+typedef enum {
+  CSV_EQUAL,
+  CSV_NOT_EQUAL,
+  CSV_LESS,
+  CSV_LESS_EQUAL,
+  CSV_GREATER,
+  CSV_GREATER_EQUAL,
+  /* -- Strings starting with char_data */
+  CSV_PREFIX,
+  /* -- Combine the predicates in terms */
+  CSV_AND,
+  CSV_OR
+} CSV_OPERATOR;
+
+typedef struct csv_predicate {
+  CSV_OPERATOR operator;
+
+  /* -- Field name to test, NULL tests the source column in column */
+  const char *field;
+  unsigned column;
+
+  /* -- INT_TYPE and DOUBLE_TYPE compare numbers, CHAR_TYPE compares bytes */
+  CSV_FIELD_TYPE field_type;
+  int64_t int_data;
+  double double_data;
+  const char *char_data;
+
+  struct csv_predicate *terms;
+  unsigned total_terms;
+} CSV_PREDICATE;
+
+typedef struct csv_filter {
+  const struct csv_predicate *predicate;
+
+  /* -- Source field of a comparison, past the header when it is unknown */
+  unsigned source;
+  size_t char_length;
+
+  struct csv_filter *terms;
+} CSV_FILTER;
+
+/************ FOLLOW ************/
+
+typedef struct csv_follow {
+  /* -- Kept open, the name is checked on every refresh for a rotated file */
+  char *csv_file;
+  int descriptor;
+
+  /* -- Bytes parsed so far, always the end of a complete row */
+  size_t offset;
+
+  /* -- Header line of the file, a rotated file has to repeat it */
+  size_t header_size;
+  uint64_t header_hash;
+
+  /* -- Import options kept until the header shows up */
+  struct csv_projection *columns;
+  struct csv_predicate *predicate;
+  struct csv_schema *schema;
+
+  /* -- Layout of the source rows, see CSV_LIST */
+  unsigned *projection;
+  unsigned source_fields;
+  struct csv_filter *filter;
+} CSV_FOLLOW;
+
+/************ DICTIONARY ************/
+
+typedef enum {
+  /* -- Encode string columns while their cardinality stays low */
+  CSV_DICTIONARY_AUTO,
+  CSV_DICTIONARY_OFF,
+  CSV_DICTIONARY_ALWAYS
+} CSV_DICTIONARY_MODE;
+
+typedef struct csv_dictionary {
+  /* -- Distinct values as string pool offsets, indexed by code */
+  size_t *value_offset;
+  uint32_t *value_length;
+  uint32_t values;
+  uint32_t value_capacity;
+
+  /* -- Open addressing table of code + 1, zero marks an empty slot */
+  uint32_t *slots;
+  uint32_t slot_count;
+
+  /* -- One code per row, code_width is 1, 2 or 4 bytes */
+  unsigned code_width;
+
+  union {
+    void *codes;
+    uint8_t *code8;
+    uint16_t *code16;
+    uint32_t *code32;
+  };
+} CSV_DICTIONARY;
+
+/************ FIELD BLOCK ************/
 
 typedef struct csv_field_list {
   char *field;
 
   CSV_FIELD_TYPE field_type;
+  CSV_TYPE_SOURCE type_source;
+
+  size_t rows;
+  size_t capacity;
+
+  /* -- INT_TYPE and DOUBLE_TYPE cells share the same 8 byte slots */
+  union {
+    int64_t *int_data;
+    double *double_data;
+  };
 
-  struct csv_char_block *char_block_head;
-  struct csv_char_block *char_block_tail;
+  /* -- CHAR_TYPE cells are views into the string pool, NUL terminated
+   * unless they point into the file mapping of csv_import_mmap() */
+  size_t *char_offset;
+  uint32_t *char_length;
 
-  struct csv_int_block *int_block_head;
-  struct csv_int_block *int_block_tail;
+  /* -- Replaces char_offset and char_length when the column is encoded */
+  struct csv_dictionary *dictionary;
+  CSV_DICTIONARY_MODE dictionary_mode;
 
-  struct csv_double_block *double_block_head;
-  struct csv_double_block *double_block_tail;
+  /* -- One byte per row, only allocated once an empty cell shows up */
+  uint8_t *null_data;
+  size_t nulls;
+
+  struct csv_string_pool *string_pool;
+  struct csv_tombstones *tombstones;
+  struct csv_allocator *allocator;
 } CSV_FIELD_LIST;
 
 /************ TOP BLOCK ************/
 
 typedef struct csv_list {
-  struct csv_field_list *field_list[CSV_MAX_FIELDS];
+  /* -- Grows with the schema, descriptors never move */
+  struct csv_field_list **field_list;
+  unsigned field_capacity;
+
+  /* -- Descriptors reserved for a header, handed out in column order */
+  struct csv_field_list *field_spare;
+  unsigned field_spares;
+
+  /* -- Open addressing index of field names, slots hold column + 1 */
+  uint32_t *field_slots;
+  uint32_t field_slot_count;
+
+  struct csv_string_pool string_pool;
+
+  /* -- Rows removed but not compacted yet, shared by every field */
+  struct csv_tombstones tombstones;
+
+  /* -- Owns the list itself, its metadata, fields and field names */
+  struct csv_arena arena;
+
+  /* -- Applied to string columns created from now on */
+  CSV_DICTIONARY_MODE dictionary_mode;
+
+  /* -- Column types are settled after this many rows, 0 never settles */
+  size_t sample_rows;
+
+  /* -- Columns asked for by the import options, resolved on the header */
+  struct csv_projection *columns;
+
+  /* -- While importing, column + 1 of every source field, 0 skips it */
+  unsigned *projection;
+  unsigned source_fields;
 
+  /* -- Rows kept by the import, resolved on the header like the columns */
+  struct csv_predicate *predicate;
+  struct csv_filter *filter;
+
+  /* -- Reusable buffer for unescaping quoted fields */
+  char *scratch;
+  size_t scratch_size;
+
+  /* -- Where csv_refresh() picks up the file, NULL when not followed */
+  struct csv_follow *follow;
 } CSV_LIST;
 
+/************ ITERATOR ************/
+
+typedef struct csv_iterator {
+  CSV_FIELD_LIST *field_list;
+
+  size_t row;
+
+  bool is_null;
+
+  char *char_data;
+  size_t char_length;
+
+  int64_t int_data;
+  double double_data;
+} CSV_ITERATOR;
+
+/************ CELL BLOCK ************/
+
+typedef struct csv_cell {
+  CSV_FIELD_TYPE field_type;
+
+  bool is_null;
+
+  char *char_data;
+  size_t char_length;
+
+  int64_t int_data;
+  double double_data;
+} CSV_CELL;
+
+typedef struct csv_row {
+  unsigned fields;
+
+  CSV_CELL *cells;
+} CSV_ROW;
+
+/************ AGGREGATE ************/
+
+typedef enum {
+  /* -- Independent lane sums, the fastest */
+  CSV_SUM_FAST,
+  /* -- Every lane carries the rounding error of its sum (Neumaier) */
+  CSV_SUM_COMPENSATED
+} CSV_SUMMATION;
+
+/************ GROUP BY ************/
+
+typedef enum {
+  CSV_AGG_COUNT,
+  CSV_AGG_SUM,
+  CSV_AGG_MIN,
+  CSV_AGG_MAX,
+  CSV_AGG_MEAN
+} CSV_AGG_FUNCTION;
+
+typedef struct csv_group_agg {
+  CSV_AGG_FUNCTION function;
+  unsigned column;
+} CSV_GROUP_AGG;
+
+typedef struct csv_group_by {
+  /* -- Columns whose values together make up the key of a group */
+  unsigned keys;
+  const unsigned *key_column;
+
+  /* -- One result column each, after the key columns */
+  unsigned aggregates;
+  const CSV_GROUP_AGG *aggregate;
+} CSV_GROUP_BY;
+
+/************ JOIN ************/
+
+typedef enum {
+  /* -- Rows of the left list with a match, once per match */
+  CSV_JOIN_INNER,
+  /* -- And the rows without one, the right columns null */
+  CSV_JOIN_LEFT
+} CSV_JOIN_KIND;
+
+typedef struct csv_join {
+  CSV_JOIN_KIND kind;
+
+  unsigned left_key;
+  unsigned right_key;
+
+  /* -- Put before the field names of each side, NULL for "left." and
+   * "right." */
+  const char *left_prefix;
+  const char *right_prefix;
+} CSV_JOIN;
+
+/************ SORT ************/
+
+typedef enum {
+  CSV_ASCENDING,
+  CSV_DESCENDING
+} CSV_DIRECTION;
+
+/************ SOURCE BLOCK ************/
+
+typedef struct csv_source {
+  /* -- Fill data with up to size bytes, returns the bytes read, 0 at the
+   * end of the input and -1 on an error */
+  ptrdiff_t (*read)(void *data, size_t size, void *context);
+
+  /* -- Called once when the source is closed, may be NULL */
+  void (*close)(void *context);
+
+  void *context;
+} CSV_SOURCE;
+
+/************ READER BLOCK ************/
+
+typedef struct csv_reader {
+  /* -- Closed with the reader */
+  struct csv_source *source;
+  bool error;
+
+  /* -- Reusable read buffer, rows are parsed in place */
+  char *buffer;
+  size_t size;
+  size_t begin;
+  size_t end;
+  bool eof;
+
+  struct csv_parser *parser;
+
+  unsigned fields;
+  char **field;
+
+  CSV_CELL *cells;
+} CSV_READER;
+
 /************ METADATA BLOCK ************/
 
 typedef struct csv_metadata {
@@ -79,6 +460,47 @@ typedef struct csv_metadata {
   unsigned items;
 } CSV_METADATA;
 
+/************ OPTIONS BLOCK ************/
+
+typedef struct csv_options {
+  /* -- Map the file instead of reading it, see csv_import_mmap() */
+  bool mmap;
+
+  /* -- Where the list gets its memory from, NULL uses malloc */
+  CSV_ALLOCATOR *allocator;
+
+  /* -- Dictionary encoding of string columns */
+  CSV_DICTIONARY_MODE dictionary;
+
+  /* -- Column types given by the caller, the other columns are inferred
+   * from the first sample_rows rows (0 uses CSV_SCHEMA_SAMPLE) */
+  CSV_SCHEMA *schema;
+  size_t sample_rows;
+
+  /* -- Only import these columns, in this order, NULL imports all of them */
+  CSV_PROJECTION *projection;
+
+  /* -- Only import the rows it holds for, tested on the raw fields */
+  CSV_PREDICATE *predicate;
+
+  /* -- Parse with this many threads, the file is then always mapped and a
+   * custom allocator must be thread safe */
+  unsigned threads;
+
+  /* -- Dead row ratio that triggers compaction (0 uses CSV_COMPACT_RATIO,
+   * 1 or more only compacts on csv_compact()) */
+  double compact_ratio;
+
+  /* -- Snapshot reused while the CSV file keeps its size and modification
+   * time, written after the import otherwise, see csv_snapshot_save() */
+  const char *snapshot;
+
+  /* -- Stop at the last complete row and keep the file position for
+   * csv_refresh(), the file is then read in blocks, without threads or a
+   * mapping. projection, predicate and schema must outlive the list. */
+  bool follow;
+} CSV_OPTIONS;
+
 /************ API ************/
 
 /**
@@ -90,6 +512,141 @@ typedef struct csv_metadata {
  */
 CSV_LIST *csv_import(char *csv_file, CSV_METADATA **metadata);
 
+/**
+ * @brief Import data from CSV file through a read only memory mapping
+ *
+ * CHAR_TYPE cells point into the mapping instead of being copied, so they
+ * are not NUL terminated, use their length. The mapping lives until
+ * csv_clear().
+ *
+ * @param csv_file
+ * @param metadata
+ * @return CSV_LIST*
+ */
+CSV_LIST *csv_import_mmap(char *csv_file, CSV_METADATA **metadata);
+
+/**
+ * @brief Import data from CSV file with import options, options may be NULL
+ *
+ * @param csv_file
+ * @param metadata
+ * @param options
+ * @return CSV_LIST*
+ */
+CSV_LIST *csv_import_ex(char *csv_file, CSV_METADATA **metadata,
+                        CSV_OPTIONS *options);
+
+/**
+ * @brief Open a CSV file for streaming, only the header is read
+ *
+ * Rows are parsed from a reusable buffer of buffer_size bytes (0 selects
+ * CSV_READER_BUFFER_SIZE), which only grows if a single row does not fit.
+ *
+ * @param csv_file
+ * @param buffer_size
+ * @return CSV_READER*
+ */
+CSV_READER *csv_reader_open(char *csv_file, size_t buffer_size);
+
+/**
+ * @brief Read the next row, returns false at the end of the file
+ *
+ * The cells of row are only valid until the next call.
+ *
+ * @param csv_reader
+ * @param row
+ * @return true
+ * @return false
+ */
+bool csv_reader_next(CSV_READER *csv_reader, CSV_ROW *row);
+
+/**
+ * @brief Close the reader and free its buffer
+ *
+ * @param csv_reader
+ */
+void csv_reader_close(CSV_READER *csv_reader);
+
+/**
+ * @brief Open a reader on a source, the source is closed with the reader.
+ * Only the header is read, see csv_reader_open().
+ *
+ * @param source
+ * @param buffer_size
+ * @return CSV_READER*
+ */
+CSV_READER *csv_reader_source(CSV_SOURCE *source, size_t buffer_size);
+
+/**
+ * @brief Create a source that calls read until it returns 0, close may be
+ * NULL
+ *
+ * @param read
+ * @param close
+ * @param context
+ * @return CSV_SOURCE*
+ */
+CSV_SOURCE *csv_source_callback(ptrdiff_t (*read)(void *data, size_t size,
+                                                  void *context),
+                                void (*close)(void *context), void *context);
+
+/**
+ * @brief Create a source reading a buffer, which is not copied and must
+ * outlive the source
+ *
+ * @param data
+ * @param size
+ * @return CSV_SOURCE*
+ */
+CSV_SOURCE *csv_source_memory(const char *data, size_t size);
+
+/**
+ * @brief Create a source reading a file descriptor from its current
+ * position, the descriptor is left open
+ *
+ * @param descriptor
+ * @return CSV_SOURCE*
+ */
+CSV_SOURCE *csv_source_fd(int descriptor);
+
+/**
+ * @brief Create a source reading a file, NULL if it can not be opened
+ *
+ * @param csv_file
+ * @return CSV_SOURCE*
+ */
+CSV_SOURCE *csv_source_file(const char *csv_file);
+
+/**
+ * @brief Create a source inflating the gzip (or zlib) data of another one,
+ * which is closed with it. Concatenated gzip members are read one after the
+ * other, bytes after the last one that do not start a member are ignored.
+ *
+ * @param compressed
+ * @return CSV_SOURCE*, NULL when compressed is NULL
+ */
+CSV_SOURCE *csv_source_gzip(CSV_SOURCE *compressed);
+
+/**
+ * @brief Close a source that was not handed to an import or a reader
+ *
+ * @param source
+ */
+void csv_source_close(CSV_SOURCE *source);
+
+/**
+ * @brief Import data from a source, which is read to its end and closed.
+ * options may be NULL, mmap, threads, snapshot and follow need a file and
+ * are not used.
+ *
+ * @param source
+ * @param metadata
+ * @param options
+ * @return CSV_LIST*, NULL when the source is NULL or fails
+ */
+CSV_LIST *csv_import_source(CSV_SOURCE *source, CSV_METADATA **metadata,
+                            CSV_OPTIONS *options);
+
 /**
  * @brief Export C data structure into csv file
  *
@@ -99,15 +656,52 @@ CSV_LIST *csv_import(char *csv_file, CSV_METADATA **metadata);
  */
 void csv_export(CSV_LIST *csv_list, CSV_METADATA *metadata, char *output);
 
+/**
+ * @brief Export C data structure into csv file through an output buffer of
+ * buffer_size bytes
+ *
+ * @param csv_list
+ * @param metadata
+ * @param output
+ * @param buffer_size
+ */
+void csv_export_buffered(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                         char *output, size_t buffer_size);
+
+/**
+ * @brief Export the rows listed in order, in that order, e.g. the order
+ * csv_sort() returns
+ *
+ * @param csv_list
+ * @param metadata
+ * @param output
+ * @param order
+ * @param total_rows
+ */
+void csv_export_ordered(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                        char *output, const size_t *order, size_t total_rows);
+
 /**
  * @brief Extract data from a specific field
  *
  * @param field
  * @param csv_list
  * @param metadata
- * @return void*
+ * @return CSV_FIELD_LIST*
  */
-void *csv_field(char *field, CSV_LIST *csv_list, CSV_METADATA *metadata);
+CSV_FIELD_LIST *csv_field(char *field, CSV_LIST *csv_list,
+                          CSV_METADATA *metadata);
+
+/**
+ * @brief Resolve a field name to its column number once, use it with
+ * csv_column() in loops. Columns keep their number for the life of the list.
+ *
+ * @param field
+ * @param csv_list
+ * @param metadata
+ * @return int column number, -1 if the field is not found
+ */
+int csv_field_index(char *field, CSV_LIST *csv_list, CSV_METADATA *metadata);
 
 /**
  * @brief Extract data from specific column
@@ -115,10 +709,72 @@ void *csv_field(char *field, CSV_LIST *csv_list, CSV_METADATA *metadata);
  * @param column
  * @param csv_list
  * @param metadata
- * @return void*
+ * @return CSV_FIELD_LIST*
+ */
+CSV_FIELD_LIST *csv_column(unsigned int column, CSV_LIST *csv_list,
+                           CSV_METADATA *metadata);
+
+/**
+ * @brief Get the string of a CHAR_TYPE cell and optionally its length
+ *
+ * @param field_list
+ * @param row
+ * @param length
+ * @return char*
  */
-void *csv_column(unsigned int column, CSV_LIST *csv_list,
-                 CSV_METADATA *metadata);
+char *csv_string(CSV_FIELD_LIST *field_list, size_t row, size_t *length);
+
+/**
+ * @brief Get the dictionary code of a cell, CSV_NO_CODE when the column is
+ * not dictionary encoded. Equal codes mean equal strings.
+ *
+ * @param field_list
+ * @param row
+ * @return uint32_t
+ */
+uint32_t csv_code(CSV_FIELD_LIST *field_list, size_t row);
+
+/**
+ * @brief Get the string behind a dictionary code and optionally its length
+ *
+ * @param field_list
+ * @param code
+ * @param length
+ * @return char*
+ */
+char *csv_code_string(CSV_FIELD_LIST *field_list, uint32_t code,
+                      size_t *length);
+
+/**
+ * @brief Look up the dictionary code of a string, CSV_NO_CODE when the
+ * string is not in the column or the column is not encoded
+ *
+ * @param field_list
+ * @param string
+ * @param length
+ * @return uint32_t
+ */
+uint32_t csv_code_find(CSV_FIELD_LIST *field_list, const char *string,
+                       size_t length);
+
+/**
+ * @brief Create an iterator over the cells of a field, in row order
+ *
+ * Compatibility helper for code written against the old per cell blocks.
+ *
+ * @param field_list
+ * @return CSV_ITERATOR
+ */
+CSV_ITERATOR csv_iterator(CSV_FIELD_LIST *field_list);
+
+/**
+ * @brief Move the iterator to the next cell, returns false at the end
+ *
+ * @param iterator
+ * @return true
+ * @return false
+ */
+bool csv_iterator_next(CSV_ITERATOR *iterator);
 
 /**
  * @brief Add a row of data
@@ -129,16 +785,275 @@ void *csv_column(unsigned int column, CSV_LIST *csv_list,
 void csv_add_row(char *data, CSV_LIST *csv_list, CSV_METADATA *metadata);
 
 /**
- * @brief Remove a row of data
+ * @brief Append every row of a buffer with the import parser, the buffer is
+ * not modified and can be released afterwards
  *
- * @param data
+ * @param buffer
+ * @param length
+ * @param csv_list
+ * @param metadata
+ * @return size_t number of rows appended, it stops at a row that can not be
+ * stored
+ */
+size_t csv_append_buffer(const char *buffer, size_t length, CSV_LIST *csv_list,
+                         CSV_METADATA *metadata);
+
+/**
+ * @brief Append the rows added to a followed file since the last import or
+ * refresh, see CSV_OPTIONS.follow
+ *
+ * Only the new bytes are read and only complete rows are parsed, a partial
+ * last row is left for the next refresh. Rows go through the projection and
+ * predicate of the import. A file that was truncated, rewritten or replaced
+ * by another one (rotated) is read again from its start, its header must be
+ * the one imported first.
+ *
+ * @param csv_list
+ * @param metadata
+ * @return size_t number of rows appended
+ */
+size_t csv_refresh(CSV_LIST *csv_list, CSV_METADATA *metadata);
+
+/**
+ * @brief Remove a row of data, the rows after it move down one and
+ * metadata->items drops by one. The list is compacted on every call, use
+ * csv_remove_rows() to remove many rows.
+ *
+ * @param row
  * @param csv_list
  * @param metadata
  */
 void csv_remove_row(unsigned int row, CSV_LIST *csv_list,
                     CSV_METADATA *metadata);
 
-void csv_row();
+/**
+ * @brief Mark rows as removed. Row numbers stay the same until the dead row
+ * ratio is crossed and the list is compacted.
+ *
+ * @param rows
+ * @param total_rows
+ * @param csv_list
+ * @param metadata
+ */
+void csv_remove_rows(const size_t *rows, size_t total_rows, CSV_LIST *csv_list,
+                     CSV_METADATA *metadata);
+
+/**
+ * @brief Check whether a row has been removed
+ *
+ * @param row
+ * @param csv_list
+ * @return true if the row is waiting for compaction
+ */
+bool csv_row_removed(size_t row, CSV_LIST *csv_list);
+
+/**
+ * @brief Drop removed rows now, the remaining rows are renumbered
+ *
+ * @param csv_list
+ * @param metadata
+ */
+void csv_compact(CSV_LIST *csv_list, CSV_METADATA *metadata);
+
+/**
+ * @brief Move the rows listed in order to the front in that order, the rows
+ * not listed are dropped like csv_compact() drops removed rows
+ *
+ * @param csv_list
+ * @param metadata
+ * @param order
+ * @param total_rows
+ * @return int, 0 on success and -1 on a row out of range
+ */
+int csv_permute(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                const size_t *order, size_t total_rows);
+
+/**
+ * @brief Read one cell of a row into a caller provided cell. Strings point
+ * into the list and are not copied.
+ *
+ * @param row
+ * @param column
+ * @param cell
+ * @param csv_list
+ * @param metadata
+ * @return true if the row and column exist and the row is not removed
+ */
+bool csv_cell(size_t row, unsigned column, CSV_CELL *cell, CSV_LIST *csv_list,
+              CSV_METADATA *metadata);
+
+/**
+ * @brief Read a whole row into a caller provided row, cells must have room
+ * for metadata->fields cells. Strings point into the list and are not copied.
+ *
+ * @param row
+ * @param row_data
+ * @param csv_list
+ * @param metadata
+ * @return true if the row exists and is not removed
+ */
+bool csv_row(size_t row, CSV_ROW *row_data, CSV_LIST *csv_list,
+             CSV_METADATA *metadata);
+
+/**
+ * @brief Count the cells of a column that are not null or removed, mask may
+ * be NULL or hold one byte per row, rows with a 0 byte are left out
+ *
+ * @param field_list
+ * @param mask
+ * @return size_t
+ */
+size_t csv_agg_count(CSV_FIELD_LIST *field_list, const uint8_t *mask);
+
+/**
+ * @brief Sum an INT_TYPE or DOUBLE_TYPE column, integers are added exactly,
+ * past the range of int64_t too, and the total is rounded to a double once
+ *
+ * @param field_list
+ * @param mask
+ * @param summation
+ * @return double, 0 when no cell is left
+ */
+double csv_agg_sum(CSV_FIELD_LIST *field_list, const uint8_t *mask,
+                   CSV_SUMMATION summation);
+
+/**
+ * @brief Smallest value of an INT_TYPE or DOUBLE_TYPE column
+ *
+ * @param field_list
+ * @param mask
+ * @return double, NAN when no cell is left
+ */
+double csv_agg_min(CSV_FIELD_LIST *field_list, const uint8_t *mask);
+
+/**
+ * @brief Largest value of an INT_TYPE or DOUBLE_TYPE column
+ *
+ * @param field_list
+ * @param mask
+ * @return double, NAN when no cell is left
+ */
+double csv_agg_max(CSV_FIELD_LIST *field_list, const uint8_t *mask);
+
+/**
+ * @brief Mean of an INT_TYPE or DOUBLE_TYPE column
+ *
+ * @param field_list
+ * @param mask
+ * @param summation
+ * @return double, NAN when no cell is left
+ */
+double csv_agg_mean(CSV_FIELD_LIST *field_list, const uint8_t *mask,
+                    CSV_SUMMATION summation);
+
+/**
+ * @brief Sample standard deviation of an INT_TYPE or DOUBLE_TYPE column, in
+ * two passes over the column
+ *
+ * @param field_list
+ * @param mask
+ * @param summation
+ * @return double, NAN with less than two cells
+ */
+double csv_agg_stddev(CSV_FIELD_LIST *field_list, const uint8_t *mask,
+                      CSV_SUMMATION summation);
+
+/**
+ * @brief Group the rows of a list by the values of the key columns and
+ * aggregate every group into a new list
+ *
+ * The result has the key columns first, then one column per aggregate named
+ * like "sum(score)". Null keys form a group of their own, aggregates skip
+ * null cells and are null for a group without any. Groups come in the order
+ * of their first row. options may be NULL, threads and allocator are used.
+ * An integer sum that leaves the range of int64_t in any group makes its
+ * column DOUBLE_TYPE, from a compensated sum of the same cells.
+ *
+ * @param csv_list
+ * @param metadata
+ * @param group_by
+ * @param group_metadata
+ * @param options
+ * @return CSV_LIST*
+ */
+CSV_LIST *csv_group_by(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                       CSV_GROUP_BY *group_by, CSV_METADATA **group_metadata,
+                       CSV_OPTIONS *options);
+
+/**
+ * @brief Join two lists on a key column of each into a new list
+ *
+ * The result has every column of the left list, then every column of the
+ * right one, their names prefixed. Keys match when they are equal strings or
+ * equal numbers, nulls match nothing. Rows keep the order of the left list,
+ * the matches of a row the order of the right one. The smaller list is
+ * hashed, in partitions when it is large. options may be NULL, threads and
+ * allocator are used.
+ *
+ * @param left_list
+ * @param left_metadata
+ * @param right_list
+ * @param right_metadata
+ * @param join
+ * @param join_metadata
+ * @param options
+ * @return CSV_LIST*
+ */
+CSV_LIST *csv_join(CSV_LIST *left_list, CSV_METADATA *left_metadata,
+                   CSV_LIST *right_list, CSV_METADATA *right_metadata,
+                   CSV_JOIN *join, CSV_METADATA **join_metadata,
+                   CSV_OPTIONS *options);
+
+/**
+ * @brief Sort the live rows of a list by the key columns, without moving any
+ * data
+ *
+ * Returns the row numbers in sorted order, the caller frees them. The sort is
+ * stable, ties keep their row order. Nulls sort after every value, before
+ * them when descending. directions may be NULL for an ascending sort.
+ * options may be NULL, threads is used. Pass the result to csv_permute() to
+ * reorder the list or to csv_export_ordered() to write it.
+ *
+ * @param csv_list
+ * @param metadata
+ * @param keys
+ * @param directions
+ * @param total_keys
+ * @param total_rows set to the number of rows returned, may be NULL
+ * @param options
+ * @return size_t*, NULL on failure
+ */
+size_t *csv_sort(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                 const unsigned *keys, const CSV_DIRECTION *directions,
+                 unsigned total_keys, size_t *total_rows,
+                 CSV_OPTIONS *options);
+
+/**
+ * @brief Save a list as a binary columnar snapshot, removed rows are left
+ * out. csv_file may name the CSV file the list came from, its size and
+ * modification time are kept for CSV_OPTIONS.snapshot.
+ *
+ * @param csv_list
+ * @param metadata
+ * @param snapshot_file
+ * @param csv_file may be NULL
+ * @return int, 0 on success
+ */
+int csv_snapshot_save(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                      const char *snapshot_file, const char *csv_file);
+
+/**
+ * @brief Load a list from a snapshot without parsing anything. The file is
+ * mapped and checked, strings are read from the mapping until csv_clear().
+ * options may be NULL, allocator and dictionary are used.
+ *
+ * @param snapshot_file
+ * @param metadata
+ * @param options
+ * @return CSV_LIST*, NULL when the file is not a valid snapshot
+ */
+CSV_LIST *csv_snapshot_load(const char *snapshot_file, CSV_METADATA **metadata,
+                            CSV_OPTIONS *options);
 
 /**
  * @brief Show CSV data on to the terminal
@@ -1,40 +1,68 @@
 #ifndef UTIL
 #define UTIL
 
+#include <stddef.h>
+#include <stdint.h>
+
 /************ UTILITY API ************/
 
 /**
- * @brief Remove left and right spaces
+ * @brief Remove left and right spaces without copying, length is updated
  *
  * @param string
+ * @param length
  * @return char*
  */
-char *util_trim_string(char *string);
+const char *util_trim_span(const char *string, size_t *length);
 
 /**
- * @brief Convert string to number
+ * @brief Convert the first length bytes of string to a number, an optional
+ * sign and decimal digits only
  *
  * @param string
+ * @param length
  * @param data
  * @return int
  */
-int util_string_to_number(char *string, int *data);
+int util_string_to_number(const char *string, size_t length, int64_t *data);
 
 /**
- * @brief Convert string to double
+ * @brief Convert the first length bytes of string to a double, rounded
+ * exactly like strtod() (decimal digits, '.' and exponent only)
  *
  * @param string
+ * @param length
  * @param data
  * @return int
  */
-int util_string_to_double(char *string, double *data);
+int util_string_to_double(const char *string, size_t length, double *data);
 
 /**
- * @brief Extract and return total number of fields
+ * @brief Convert number to string, buffer needs room for 21 bytes
  *
- * @param string
+ * @param data
+ * @param buffer
+ * @return int
+ */
+int util_number_to_string(int64_t data, char *buffer);
+
+/**
+ * @brief Convert double to the shortest string that reads back the same
+ *
+ * @param data
+ * @param buffer
+ * @param size
  * @return int
  */
-int util_total_fields(char *string);
+int util_double_to_string(double data, char *buffer, size_t size);
+
+/**
+ * @brief Hash a run of bytes (64 bit FNV-1a)
+ *
+ * @param data
+ * @param length
+ * @return uint64_t
+ */
+uint64_t util_hash(const void *data, size_t length);
 
 #endif
\ No newline at end of file
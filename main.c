@@ -12,17 +12,20 @@
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <libcsv.h>
 #include <util.h>
 
-#define LIBCSV_ARGS "i:o:a:r:ph"
+#define LIBCSV_ARGS "t:i:m:o:a:r:ph"
 
 void csv_print_help(char *binary) {
   fprintf(stderr,
           "Usage: %s -i [file] -a [data] -e"
           "\n-i = Import CSV data into C object"
+          "\n-m = Import CSV data through a memory mapping"
+          "\n-t = Import with this many threads, give it before -i"
           "\n-o = Export C object into CSV file"
           "\n-a = Append a row of data"
           "\n-r = Remove a row of data"
@@ -38,10 +41,32 @@ int main(int argc, char **argv) {
   CSV_METADATA *metadata = NULL;
   CSV_LIST *csv_list = NULL;
 
+  CSV_OPTIONS options = {0};
+
   while ((opt = getopt(argc, argv, LIBCSV_ARGS)) != -1) {
     switch (opt) {
+    case 't': {
+      int64_t threads = 0;
+      if ((util_string_to_number(optarg, strlen(optarg), &threads) == 0) &&
+          (threads > 0)) {
+        options.threads = threads;
+        break;
+      }
+
+      fprintf(stderr,
+              "Error: Invalid argument %s for"
+              " option -t.\n",
+              optarg);
+
+      break;
+    }
     case 'i': {
-      csv_list = csv_import(optarg, &metadata);
+      csv_list = csv_import_ex(optarg, &metadata, &options);
+      break;
+    }
+    case 'm': {
+      options.mmap = true;
+      csv_list = csv_import_ex(optarg, &metadata, &options);
       break;
     }
     case 'a': {
@@ -49,9 +74,9 @@ int main(int argc, char **argv) {
       break;
     }
     case 'r': {
-      int row = 0;
-      if ((util_string_to_number(optarg, &row) == 0) &&
-          (row < metadata->items)) {
+      int64_t row = 0;
+      if ((util_string_to_number(optarg, strlen(optarg), &row) == 0) &&
+          (row >= 0) && (row < metadata->items)) {
         csv_remove_row(row, csv_list, metadata);
         break;
       }
@@ -0,0 +1,608 @@
+/**
+ * @file aggregate.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Aggregates over INT_TYPE and DOUBLE_TYPE columns
+ *
+ * Columns are contiguous arrays, so the kernels stream over them a block at
+ * a time. Nulls, removed rows and the caller mask are folded into one byte
+ * per row for the block, and only when there is anything to leave out; a
+ * dense column goes straight to the kernel. Integers are summed exactly,
+ * a carry counts the times the 64 bit sum wraps so the total is only rounded
+ * once it is returned as a double. Doubles are summed in independent lanes,
+ * optionally compensated, and the standard deviation takes a second pass
+ * around the mean.
+ *
+ * @version 0.1
+ * @date 2025-01-17
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <csv-aggregate.h>
+#include <csv-utils.h>
+#include <libcsv.h>
+
+/************************************************/
+/*             CSV_AGG_ADD                      */
+/************************************************/
+
+static void csv_agg_add(double *sum, double *error, double value,
+                        bool compensated) {
+  double total = *sum + value;
+
+  /* -- Neumaier, the bits lost by the larger operand are kept */
+  if (compensated) {
+    if (fabs(*sum) >= fabs(value)) {
+      *error += (*sum - total) + value;
+    } else {
+      *error += (value - total) + *sum;
+    }
+  }
+
+  *sum = total;
+}
+
+/************************************************/
+/*             CSV_AGG_INT_SCALAR               */
+/************************************************/
+
+void csv_agg_int_scalar(const int64_t *data, const uint8_t *keep,
+                        size_t length, CSV_MOMENTS *moments) {
+  for (size_t i = 0; i < length; i++) {
+    if (keep != NULL && keep[i] == 0) {
+      continue;
+    }
+
+    int64_t value = data[i];
+
+    moments->count += 1;
+
+    if (__builtin_add_overflow(moments->int_sum, value, &moments->int_sum)) {
+      moments->int_carry += value < 0 ? -1 : 1;
+    }
+
+    if (value < moments->int_min) {
+      moments->int_min = value;
+    }
+
+    if (value > moments->int_max) {
+      moments->int_max = value;
+    }
+  }
+}
+
+/************************************************/
+/*             CSV_AGG_DOUBLE_SCALAR            */
+/************************************************/
+
+void csv_agg_double_scalar(const double *data, const uint8_t *keep,
+                           size_t length, double shift, bool compensated,
+                           CSV_MOMENTS *moments) {
+  for (size_t i = 0; i < length; i++) {
+    if (keep != NULL && keep[i] == 0) {
+      continue;
+    }
+
+    double value = data[i];
+    double delta = value - shift;
+
+    moments->count += 1;
+
+    csv_agg_add(&moments->sum, &moments->sum_error, delta, compensated);
+    csv_agg_add(&moments->squares, &moments->squares_error, delta * delta,
+                compensated);
+
+    if (value < moments->min) {
+      moments->min = value;
+    }
+
+    if (value > moments->max) {
+      moments->max = value;
+    }
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/************************************************/
+/*             CSV_AGG_LANES                    */
+/************************************************/
+
+/* -- All ones in the lanes whose keep byte is set */
+__attribute__((target("avx2"))) static __m256i
+csv_agg_lanes(const uint8_t *keep) {
+  int32_t bytes = 0;
+
+  memcpy(&bytes, keep, sizeof(bytes));
+
+  __m256i wide = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(bytes));
+
+  return _mm256_cmpgt_epi64(wide, _mm256_setzero_si256());
+}
+
+/************************************************/
+/*             CSV_AGG_INT_AVX2                 */
+/************************************************/
+
+__attribute__((target("avx2"))) void
+csv_agg_int_avx2(const int64_t *data, const uint8_t *keep, size_t length,
+                 CSV_MOMENTS *moments) {
+  const __m256i all = _mm256_set1_epi64x(-1);
+  const __m256i highest = _mm256_set1_epi64x(INT64_MAX);
+  const __m256i lowest = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi64x(1);
+
+  __m256i sum = zero;
+  __m256i carry = zero;
+  __m256i min = highest;
+  __m256i max = lowest;
+
+  size_t count = 0;
+  size_t i = 0;
+
+  for (; i + 4 <= length; i += 4) {
+    __m256i values = _mm256_loadu_si256((const __m256i *)(data + i));
+    __m256i lanes = all;
+
+    if (keep != NULL) {
+      lanes = csv_agg_lanes(keep + i);
+      count += __builtin_popcount(
+          _mm256_movemask_pd(_mm256_castsi256_pd(lanes)));
+    } else {
+      count += 4;
+    }
+
+    __m256i added = _mm256_and_si256(values, lanes);
+    __m256i total = _mm256_add_epi64(sum, added);
+
+    /* -- Signed overflow when both operands have the sign the total lacks,
+     * the sign of the added value tells up (+1) from down (-1) */
+    __m256i wrapped = _mm256_cmpgt_epi64(
+        zero, _mm256_andnot_si256(_mm256_xor_si256(sum, added),
+                                  _mm256_xor_si256(sum, total)));
+    __m256i direction =
+        _mm256_or_si256(_mm256_cmpgt_epi64(zero, added), one);
+
+    carry = _mm256_add_epi64(carry, _mm256_and_si256(wrapped, direction));
+    sum = total;
+
+    /* -- Skipped lanes compare as the identity of min and max */
+    __m256i low = _mm256_blendv_epi8(highest, values, lanes);
+    __m256i high = _mm256_blendv_epi8(lowest, values, lanes);
+
+    min = _mm256_blendv_epi8(min, low, _mm256_cmpgt_epi64(min, low));
+    max = _mm256_blendv_epi8(max, high, _mm256_cmpgt_epi64(high, max));
+  }
+
+  int64_t sums[4];
+  int64_t carries[4];
+  int64_t mins[4];
+  int64_t maxs[4];
+
+  _mm256_storeu_si256((__m256i *)sums, sum);
+  _mm256_storeu_si256((__m256i *)carries, carry);
+  _mm256_storeu_si256((__m256i *)mins, min);
+  _mm256_storeu_si256((__m256i *)maxs, max);
+
+  for (int lane = 0; lane < 4; lane++) {
+    moments->int_carry += carries[lane];
+
+    if (__builtin_add_overflow(moments->int_sum, sums[lane],
+                               &moments->int_sum)) {
+      moments->int_carry += sums[lane] < 0 ? -1 : 1;
+    }
+
+    if (mins[lane] < moments->int_min) {
+      moments->int_min = mins[lane];
+    }
+
+    if (maxs[lane] > moments->int_max) {
+      moments->int_max = maxs[lane];
+    }
+  }
+
+  moments->count += count;
+
+  /* -- Tail */
+  csv_agg_int_scalar(data + i, keep ? keep + i : NULL, length - i, moments);
+}
+
+/************************************************/
+/*             CSV_AGG_ADD_AVX2                 */
+/************************************************/
+
+__attribute__((target("avx2"))) static void
+csv_agg_add_avx2(__m256d *sum, __m256d *error, __m256d value) {
+  const __m256d sign = _mm256_set1_pd(-0.0);
+
+  __m256d total = _mm256_add_pd(*sum, value);
+  __m256d larger = _mm256_cmp_pd(_mm256_andnot_pd(sign, *sum),
+                                 _mm256_andnot_pd(sign, value), _CMP_GE_OQ);
+
+  __m256d lost = _mm256_blendv_pd(
+      _mm256_add_pd(_mm256_sub_pd(value, total), *sum),
+      _mm256_add_pd(_mm256_sub_pd(*sum, total), value), larger);
+
+  *error = _mm256_add_pd(*error, lost);
+  *sum = total;
+}
+
+/************************************************/
+/*             CSV_AGG_DOUBLE_AVX2              */
+/************************************************/
+
+__attribute__((target("avx2"))) void
+csv_agg_double_avx2(const double *data, const uint8_t *keep, size_t length,
+                    double shift, bool compensated, CSV_MOMENTS *moments) {
+  const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+  const __m256d highest = _mm256_set1_pd(INFINITY);
+  const __m256d lowest = _mm256_set1_pd(-INFINITY);
+  const __m256d shifts = _mm256_set1_pd(shift);
+
+  __m256d sum = _mm256_setzero_pd();
+  __m256d sum_error = _mm256_setzero_pd();
+  __m256d squares = _mm256_setzero_pd();
+  __m256d squares_error = _mm256_setzero_pd();
+  __m256d min = highest;
+  __m256d max = lowest;
+
+  size_t count = 0;
+  size_t i = 0;
+
+  for (; i + 4 <= length; i += 4) {
+    __m256d values = _mm256_loadu_pd(data + i);
+    __m256d lanes = all;
+
+    if (keep != NULL) {
+      lanes = _mm256_castsi256_pd(csv_agg_lanes(keep + i));
+      count += __builtin_popcount(_mm256_movemask_pd(lanes));
+    } else {
+      count += 4;
+    }
+
+    __m256d delta = _mm256_and_pd(_mm256_sub_pd(values, shifts), lanes);
+    __m256d square = _mm256_mul_pd(delta, delta);
+
+    if (compensated) {
+      csv_agg_add_avx2(&sum, &sum_error, delta);
+      csv_agg_add_avx2(&squares, &squares_error, square);
+    } else {
+      sum = _mm256_add_pd(sum, delta);
+      squares = _mm256_add_pd(squares, square);
+    }
+
+    min = _mm256_min_pd(min, _mm256_blendv_pd(highest, values, lanes));
+    max = _mm256_max_pd(max, _mm256_blendv_pd(lowest, values, lanes));
+  }
+
+  double lane_values[6][4];
+
+  _mm256_storeu_pd(lane_values[0], sum);
+  _mm256_storeu_pd(lane_values[1], sum_error);
+  _mm256_storeu_pd(lane_values[2], squares);
+  _mm256_storeu_pd(lane_values[3], squares_error);
+  _mm256_storeu_pd(lane_values[4], min);
+  _mm256_storeu_pd(lane_values[5], max);
+
+  for (int lane = 0; lane < 4; lane++) {
+    csv_agg_add(&moments->sum, &moments->sum_error, lane_values[0][lane],
+                compensated);
+    csv_agg_add(&moments->squares, &moments->squares_error,
+                lane_values[2][lane], compensated);
+
+    moments->sum_error += lane_values[1][lane];
+    moments->squares_error += lane_values[3][lane];
+
+    if (lane_values[4][lane] < moments->min) {
+      moments->min = lane_values[4][lane];
+    }
+
+    if (lane_values[5][lane] > moments->max) {
+      moments->max = lane_values[5][lane];
+    }
+  }
+
+  moments->count += count;
+
+  /* -- Tail */
+  csv_agg_double_scalar(data + i, keep ? keep + i : NULL, length - i, shift,
+                        compensated, moments);
+}
+
+#endif
+
+/************************************************/
+/*             CSV_AGG_INT                      */
+/************************************************/
+
+void csv_agg_int(const int64_t *data, const uint8_t *keep, size_t length,
+                 CSV_MOMENTS *moments) {
+#if defined(__x86_64__) || defined(__i386__)
+#ifndef CSV_NO_SIMD
+  if (__builtin_cpu_supports("avx2")) {
+    csv_agg_int_avx2(data, keep, length, moments);
+    return;
+  }
+#endif
+#endif
+
+  csv_agg_int_scalar(data, keep, length, moments);
+}
+
+/************************************************/
+/*             CSV_AGG_DOUBLE                   */
+/************************************************/
+
+void csv_agg_double(const double *data, const uint8_t *keep, size_t length,
+                    double shift, bool compensated, CSV_MOMENTS *moments) {
+#if defined(__x86_64__) || defined(__i386__)
+#ifndef CSV_NO_SIMD
+  if (__builtin_cpu_supports("avx2")) {
+    csv_agg_double_avx2(data, keep, length, shift, compensated, moments);
+    return;
+  }
+#endif
+#endif
+
+  csv_agg_double_scalar(data, keep, length, shift, compensated, moments);
+}
+
+/************************************************/
+/*             CSV_AGG_INT_TOTAL                */
+/************************************************/
+
+/* -- Exact while no carry is left, otherwise rounded from 128 bits */
+static double csv_agg_int_total(const CSV_MOMENTS *moments) {
+  if (moments->int_carry == 0) {
+    return (double)moments->int_sum;
+  }
+
+  return ldexp((double)moments->int_carry, 64) + (double)moments->int_sum;
+}
+
+/************************************************/
+/*             CSV_AGG_KEEP                     */
+/************************************************/
+
+/* -- One byte per row of the block, NULL when every row is kept */
+static const uint8_t *csv_agg_keep(CSV_FIELD_LIST *field_list,
+                                   const uint8_t *mask, size_t begin,
+                                   size_t length, uint8_t *keep) {
+  const CSV_TOMBSTONES *tombstones = field_list->tombstones;
+  const uint8_t *null_data = field_list->null_data;
+
+  bool dead = tombstones != NULL && tombstones->dead > 0;
+
+  if (null_data == NULL && mask == NULL && !dead) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    size_t row = begin + i;
+
+    keep[i] = (null_data == NULL || null_data[row] == 0) &&
+              (mask == NULL || mask[row] != 0) &&
+              !(dead && csv_util_row_dead(tombstones, row));
+  }
+
+  return keep;
+}
+
+/************************************************/
+/*             CSV_AGG_MOMENTS                  */
+/************************************************/
+
+static bool csv_agg_moments(CSV_FIELD_LIST *field_list, const uint8_t *mask,
+                            double shift, bool compensated, bool exact,
+                            CSV_MOMENTS *moments, const char *caller) {
+  memset(moments, 0, sizeof(CSV_MOMENTS));
+
+  moments->int_min = INT64_MAX;
+  moments->int_max = INT64_MIN;
+  moments->min = INFINITY;
+  moments->max = -INFINITY;
+
+  if (field_list == NULL) {
+    return false;
+  }
+
+  /* -- A column without storage only holds nulls */
+  if (field_list->capacity == 0) {
+    return true;
+  }
+
+  if (field_list->field_type == CHAR_TYPE) {
+    fprintf(stderr, "%s: %s is not a number column.\n", caller,
+            field_list->field);
+    return false;
+  }
+
+  uint8_t keep[CSV_AGGREGATE_BLOCK];
+  double values[CSV_AGGREGATE_BLOCK];
+
+  for (size_t begin = 0; begin < field_list->rows;
+       begin += CSV_AGGREGATE_BLOCK) {
+    size_t length = field_list->rows - begin;
+
+    if (length > CSV_AGGREGATE_BLOCK) {
+      length = CSV_AGGREGATE_BLOCK;
+    }
+
+    const uint8_t *block_keep =
+        csv_agg_keep(field_list, mask, begin, length, keep);
+
+    if (field_list->field_type == DOUBLE_TYPE) {
+      csv_agg_double(field_list->double_data + begin, block_keep, length,
+                     shift, compensated, moments);
+    } else if (exact) {
+      csv_agg_int(field_list->int_data + begin, block_keep, length, moments);
+    } else {
+      for (size_t i = 0; i < length; i++) {
+        values[i] = (double)field_list->int_data[begin + i];
+      }
+
+      csv_agg_double(values, block_keep, length, shift, compensated, moments);
+    }
+  }
+
+  return true;
+}
+
+/************************************************/
+/*             CSV_AGG_COUNT                    */
+/************************************************/
+
+size_t csv_agg_count(CSV_FIELD_LIST *field_list, const uint8_t *mask) {
+  if (field_list == NULL || field_list->capacity == 0) {
+    return 0;
+  }
+
+  uint8_t keep[CSV_AGGREGATE_BLOCK];
+  size_t count = 0;
+
+  for (size_t begin = 0; begin < field_list->rows;
+       begin += CSV_AGGREGATE_BLOCK) {
+    size_t length = field_list->rows - begin;
+
+    if (length > CSV_AGGREGATE_BLOCK) {
+      length = CSV_AGGREGATE_BLOCK;
+    }
+
+    const uint8_t *block_keep =
+        csv_agg_keep(field_list, mask, begin, length, keep);
+
+    if (block_keep == NULL) {
+      count += length;
+      continue;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+      count += block_keep[i];
+    }
+  }
+
+  return count;
+}
+
+/************************************************/
+/*             CSV_AGG_SUM                      */
+/************************************************/
+
+double csv_agg_sum(CSV_FIELD_LIST *field_list, const uint8_t *mask,
+                   CSV_SUMMATION summation) {
+  CSV_MOMENTS moments;
+
+  if (!csv_agg_moments(field_list, mask, 0, summation == CSV_SUM_COMPENSATED,
+                       true, &moments, __func__)) {
+    return NAN;
+  }
+
+  if (field_list->field_type == INT_TYPE) {
+    return csv_agg_int_total(&moments);
+  }
+
+  return moments.sum + moments.sum_error;
+}
+
+/************************************************/
+/*             CSV_AGG_MIN                      */
+/************************************************/
+
+double csv_agg_min(CSV_FIELD_LIST *field_list, const uint8_t *mask) {
+  CSV_MOMENTS moments;
+
+  if (!csv_agg_moments(field_list, mask, 0, false, true, &moments,
+                       __func__) ||
+      moments.count == 0) {
+    return NAN;
+  }
+
+  if (field_list->field_type == INT_TYPE) {
+    return (double)moments.int_min;
+  }
+
+  return moments.min;
+}
+
+/************************************************/
+/*             CSV_AGG_MAX                      */
+/************************************************/
+
+double csv_agg_max(CSV_FIELD_LIST *field_list, const uint8_t *mask) {
+  CSV_MOMENTS moments;
+
+  if (!csv_agg_moments(field_list, mask, 0, false, true, &moments,
+                       __func__) ||
+      moments.count == 0) {
+    return NAN;
+  }
+
+  if (field_list->field_type == INT_TYPE) {
+    return (double)moments.int_max;
+  }
+
+  return moments.max;
+}
+
+/************************************************/
+/*             CSV_AGG_MEAN                     */
+/************************************************/
+
+double csv_agg_mean(CSV_FIELD_LIST *field_list, const uint8_t *mask,
+                    CSV_SUMMATION summation) {
+  CSV_MOMENTS moments;
+
+  if (!csv_agg_moments(field_list, mask, 0, summation == CSV_SUM_COMPENSATED,
+                       true, &moments, __func__) ||
+      moments.count == 0) {
+    return NAN;
+  }
+
+  if (field_list->field_type == INT_TYPE) {
+    return csv_agg_int_total(&moments) / (double)moments.count;
+  }
+
+  return (moments.sum + moments.sum_error) / (double)moments.count;
+}
+
+/************************************************/
+/*             CSV_AGG_STDDEV                   */
+/************************************************/
+
+double csv_agg_stddev(CSV_FIELD_LIST *field_list, const uint8_t *mask,
+                      CSV_SUMMATION summation) {
+  double mean = csv_agg_mean(field_list, mask, summation);
+
+  if (mean != mean) {
+    return NAN;
+  }
+
+  /* -- Squares are taken around the mean, the sum of the deviations then
+   * only corrects the rounding of the mean itself */
+  CSV_MOMENTS moments;
+
+  csv_agg_moments(field_list, mask, mean, summation == CSV_SUM_COMPENSATED,
+                  false, &moments, __func__);
+
+  if (moments.count < 2) {
+    return NAN;
+  }
+
+  double count = (double)moments.count;
+  double sum = moments.sum + moments.sum_error;
+  double squares = moments.squares + moments.squares_error;
+  double variance = (squares - sum * sum / count) / (count - 1);
+
+  return variance > 0 ? sqrt(variance) : 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * @file arena.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Arena and allocator hooks for libcsv
+ *
+ * Everything that lives exactly as long as a CSV_LIST, the list itself, its
+ * metadata, field descriptors and field names, is bump allocated from an
+ * arena owned by the list. Column storage still grows in place and goes
+ * through the same allocator, so csv_clear() is a handful of releases
+ * instead of one free per object.
+ *
+ * @version 0.1
+ * @date 2025-01-11
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csv-arena.h>
+#include <libcsv.h>
+
+#define CSV_ARENA_ALIGN _Alignof(max_align_t)
+
+/************************************************/
+/*             CSV_MALLOC_ALLOCATOR             */
+/************************************************/
+
+static void *csv_malloc_alloc(size_t size, void *context) {
+  (void)context;
+
+  return malloc(size);
+}
+
+static void *csv_malloc_resize(void *data, size_t old_size, size_t size,
+                               void *context) {
+  (void)old_size;
+  (void)context;
+
+  return realloc(data, size);
+}
+
+static void csv_malloc_release(void *data, size_t size, void *context) {
+  (void)size;
+  (void)context;
+
+  free(data);
+}
+
+const CSV_ALLOCATOR csv_malloc_allocator = {
+    .alloc = csv_malloc_alloc,
+    .resize = csv_malloc_resize,
+    .release = csv_malloc_release,
+    .context = NULL,
+};
+
+/************************************************/
+/*             CSV_ALLOC_RESIZE                 */
+/************************************************/
+
+void *csv_alloc_resize(CSV_ALLOCATOR *allocator, void *data, size_t old_size,
+                       size_t size) {
+  if (data == NULL) {
+    return allocator->alloc(size, allocator->context);
+  }
+
+  return allocator->resize(data, old_size, size, allocator->context);
+}
+
+/************************************************/
+/*             CSV_ALLOC_RELEASE                */
+/************************************************/
+
+void csv_alloc_release(CSV_ALLOCATOR *allocator, void *data, size_t size) {
+  if (data != NULL) {
+    allocator->release(data, size, allocator->context);
+  }
+}
+
+/************************************************/
+/*             CSV_ARENA_ALLOC                  */
+/************************************************/
+
+static size_t csv_arena_align(size_t size) {
+  return (size + CSV_ARENA_ALIGN - 1) & ~(CSV_ARENA_ALIGN - 1);
+}
+
+void *csv_arena_alloc(CSV_ARENA *arena, size_t size) {
+  size_t header = csv_arena_align(sizeof(CSV_ARENA_BLOCK));
+  size = csv_arena_align(size ? size : 1);
+
+  CSV_ARENA_BLOCK *block = arena->block_head;
+
+  if (block == NULL || block->used + size > block->size) {
+    size_t block_size =
+        size > CSV_ARENA_BLOCK_SIZE ? size : CSV_ARENA_BLOCK_SIZE;
+
+    CSV_ARENA_BLOCK *new_block =
+        arena->allocator.alloc(header + block_size, arena->allocator.context);
+
+    if (new_block == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return NULL;
+    }
+
+    new_block->size = block_size;
+    new_block->used = 0;
+
+    /* -- Oversized requests go behind the current block, keep its space */
+    if (block != NULL && size > CSV_ARENA_BLOCK_SIZE) {
+      new_block->next_block = block->next_block;
+      block->next_block = new_block;
+    } else {
+      new_block->next_block = block;
+      arena->block_head = new_block;
+    }
+
+    block = new_block;
+  }
+
+  char *data = (char *)block + header + block->used;
+
+  block->used += size;
+  memset(data, 0, size);
+
+  return data;
+}
+
+/************************************************/
+/*             CSV_ARENA_STRING                 */
+/************************************************/
+
+char *csv_arena_string(CSV_ARENA *arena, const char *string) {
+  size_t length = strlen(string);
+  char *copy = csv_arena_alloc(arena, length + 1);
+
+  if (copy != NULL) {
+    memcpy(copy, string, length);
+  }
+
+  return copy;
+}
+
+/************************************************/
+/*             CSV_ARENA_RELEASE                */
+/************************************************/
+
+void csv_arena_release(CSV_ARENA *arena) {
+  size_t header = csv_arena_align(sizeof(CSV_ARENA_BLOCK));
+  CSV_ARENA_BLOCK *block = arena->block_head;
+
+  while (block != NULL) {
+    CSV_ARENA_BLOCK *next_block = block->next_block;
+
+    arena->allocator.release(block, header + block->size,
+                             arena->allocator.context);
+
+    block = next_block;
+  }
+
+  arena->block_head = NULL;
+}
+
+/************************************************/
+/*             CSV_ARENA_LIST                   */
+/************************************************/
+
+CSV_LIST *csv_arena_list(CSV_ALLOCATOR *allocator, CSV_METADATA **metadata) {
+  CSV_ARENA arena = {0};
+
+  arena.allocator = allocator ? *allocator : csv_malloc_allocator;
+
+  CSV_LIST *csv_list = csv_arena_alloc(&arena, sizeof(CSV_LIST));
+  CSV_METADATA *csv_metadata = csv_arena_alloc(&arena, sizeof(CSV_METADATA));
+
+  if (csv_list == NULL || csv_metadata == NULL) {
+    csv_arena_release(&arena);
+    return NULL;
+  }
+
+  /* -- The list lives in the first block of the arena it owns */
+  csv_list->arena = arena;
+  csv_list->string_pool.allocator = &csv_list->arena.allocator;
+  csv_list->tombstones.allocator = &csv_list->arena.allocator;
+  csv_list->tombstones.ratio = CSV_COMPACT_RATIO;
+
+  *metadata = csv_metadata;
+
+  return csv_list;
+}
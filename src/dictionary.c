@@ -0,0 +1,447 @@
+/**
+ * @file dictionary.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Dictionary encoded string columns for libcsv
+ *
+ * Columns like country or status hold a handful of distinct values over
+ * millions of rows. Each distinct value is interned once and rows keep a 1, 2
+ * or 4 byte code, the narrowest that fits. When a column turns out to have
+ * too many distinct values it is decoded back to plain offsets.
+ *
+ * @version 0.1
+ * @date 2025-01-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csv-arena.h>
+#include <csv-utils.h>
+#include <libcsv.h>
+#include <util.h>
+
+/************************************************/
+/*             CSV_UTIL_DICTIONARY_CREATE       */
+/************************************************/
+
+int csv_util_dictionary_create(CSV_FIELD_LIST *field_list) {
+  CSV_ALLOCATOR *allocator = field_list->allocator;
+  CSV_DICTIONARY *dictionary =
+      csv_alloc_resize(allocator, NULL, 0, sizeof(CSV_DICTIONARY));
+
+  if (dictionary == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
+
+  memset(dictionary, 0, sizeof(CSV_DICTIONARY));
+
+  dictionary->code_width = 1;
+
+  if (field_list->capacity > 0) {
+    dictionary->codes =
+        csv_alloc_resize(allocator, NULL, 0, field_list->capacity);
+
+    if (dictionary->codes == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      csv_alloc_release(allocator, dictionary, sizeof(CSV_DICTIONARY));
+      return -1;
+    }
+
+    memset(dictionary->codes, 0, field_list->capacity);
+  }
+
+  field_list->dictionary = dictionary;
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_DICTIONARY_RESERVE      */
+/************************************************/
+
+int csv_util_dictionary_reserve(CSV_FIELD_LIST *field_list, size_t capacity) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+  size_t width = dictionary->code_width;
+
+  void *codes =
+      csv_alloc_resize(field_list->allocator, dictionary->codes,
+                       field_list->capacity * width, capacity * width);
+
+  if (codes == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
+
+  dictionary->codes = codes;
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_DICTIONARY_CODE         */
+/************************************************/
+
+uint32_t csv_util_dictionary_code(CSV_DICTIONARY *dictionary, size_t row) {
+  switch (dictionary->code_width) {
+  case 1:
+    return dictionary->code8[row];
+  case 2:
+    return dictionary->code16[row];
+  default:
+    return dictionary->code32[row];
+  }
+}
+
+void csv_util_dictionary_set(CSV_DICTIONARY *dictionary, size_t row,
+                             uint32_t code) {
+  switch (dictionary->code_width) {
+  case 1:
+    dictionary->code8[row] = code;
+    break;
+  case 2:
+    dictionary->code16[row] = code;
+    break;
+  default:
+    dictionary->code32[row] = code;
+    break;
+  }
+}
+
+/************************************************/
+/*             CSV_UTIL_DICTIONARY_WIDEN        */
+/************************************************/
+
+static int csv_util_dictionary_widen(CSV_FIELD_LIST *field_list,
+                                     unsigned code_width) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+  size_t capacity = field_list->capacity;
+
+  void *codes = csv_alloc_resize(field_list->allocator, NULL, 0,
+                                 capacity * code_width);
+
+  if (codes == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
+
+  for (size_t row = 0; row < field_list->rows; row++) {
+    uint32_t code = csv_util_dictionary_code(dictionary, row);
+
+    if (code_width == 2) {
+      ((uint16_t *)codes)[row] = code;
+    } else {
+      ((uint32_t *)codes)[row] = code;
+    }
+  }
+
+  csv_alloc_release(field_list->allocator, dictionary->codes,
+                    capacity * dictionary->code_width);
+
+  dictionary->codes = codes;
+  dictionary->code_width = code_width;
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_DICTIONARY_FIND         */
+/************************************************/
+
+static uint32_t *csv_util_dictionary_slot(CSV_FIELD_LIST *field_list,
+                                          const char *string, size_t length,
+                                          uint64_t hash) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+  uint32_t mask = dictionary->slot_count - 1;
+
+  for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    uint32_t entry = dictionary->slots[slot];
+
+    if (entry == 0) {
+      return &dictionary->slots[slot];
+    }
+
+    uint32_t code = entry - 1;
+
+    if (dictionary->value_length[code] == length &&
+        memcmp(csv_util_string(field_list->string_pool,
+                               dictionary->value_offset[code]),
+               string, length) == 0) {
+      return &dictionary->slots[slot];
+    }
+  }
+}
+
+uint32_t csv_util_dictionary_find(CSV_FIELD_LIST *field_list,
+                                  const char *string, size_t length) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+
+  if (dictionary == NULL || dictionary->slot_count == 0) {
+    return CSV_NO_CODE;
+  }
+
+  uint32_t *slot = csv_util_dictionary_slot(field_list, string, length,
+                                            util_hash(string, length));
+
+  return *slot ? *slot - 1 : CSV_NO_CODE;
+}
+
+/************************************************/
+/*             CSV_UTIL_DICTIONARY_TABLE        */
+/************************************************/
+
+static int csv_util_dictionary_table(CSV_FIELD_LIST *field_list,
+                                     uint32_t slot_count) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+  CSV_ALLOCATOR *allocator = field_list->allocator;
+
+  uint32_t *slots =
+      csv_alloc_resize(allocator, NULL, 0, slot_count * sizeof(uint32_t));
+
+  if (slots == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
+
+  memset(slots, 0, slot_count * sizeof(uint32_t));
+
+  csv_alloc_release(allocator, dictionary->slots,
+                    dictionary->slot_count * sizeof(uint32_t));
+
+  dictionary->slots = slots;
+  dictionary->slot_count = slot_count;
+
+  /* -- Values are distinct, every one lands in an empty slot */
+  for (uint32_t code = 0; code < dictionary->values; code++) {
+    const char *value = csv_util_string(field_list->string_pool,
+                                        dictionary->value_offset[code]);
+    size_t length = dictionary->value_length[code];
+
+    *csv_util_dictionary_slot(field_list, value, length,
+                              util_hash(value, length)) = code + 1;
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_DICTIONARY_REHASH       */
+/************************************************/
+
+static int csv_util_dictionary_rehash(CSV_FIELD_LIST *field_list) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+
+  return csv_util_dictionary_table(
+      field_list, dictionary->slot_count ? dictionary->slot_count * 2 : 64);
+}
+
+/************************************************/
+/*             CSV_UTIL_DICTIONARY_INDEX        */
+/************************************************/
+
+int csv_util_dictionary_index(CSV_FIELD_LIST *field_list) {
+  uint32_t values = field_list->dictionary->values;
+  uint32_t slot_count = 64;
+
+  /* -- At most half full, like the table intern keeps */
+  while (slot_count < (uint64_t)(values + 1) * 2) {
+    slot_count *= 2;
+  }
+
+  return csv_util_dictionary_table(field_list, slot_count);
+}
+
+/************************************************/
+/*             CSV_UTIL_DICTIONARY_INTERN       */
+/************************************************/
+
+uint32_t csv_util_dictionary_intern(CSV_FIELD_LIST *field_list,
+                                    const char *string, size_t length) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+  CSV_ALLOCATOR *allocator = field_list->allocator;
+
+  /* -- Keep the table at most half full */
+  if ((dictionary->values + 1) * 2 > dictionary->slot_count &&
+      csv_util_dictionary_rehash(field_list) != 0) {
+    return CSV_NO_CODE;
+  }
+
+  uint64_t hash = util_hash(string, length);
+  uint32_t *slot = csv_util_dictionary_slot(field_list, string, length, hash);
+
+  if (*slot != 0) {
+    return *slot - 1;
+  }
+
+  if (dictionary->values == CSV_NO_CODE) {
+    return CSV_NO_CODE;
+  }
+
+  if (dictionary->values == dictionary->value_capacity) {
+    uint32_t value_capacity =
+        dictionary->value_capacity ? dictionary->value_capacity * 2 : 16;
+
+    size_t *value_offset = csv_alloc_resize(
+        allocator, dictionary->value_offset,
+        dictionary->value_capacity * sizeof(size_t),
+        value_capacity * sizeof(size_t));
+
+    if (value_offset == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return CSV_NO_CODE;
+    }
+
+    dictionary->value_offset = value_offset;
+
+    uint32_t *value_length = csv_alloc_resize(
+        allocator, dictionary->value_length,
+        dictionary->value_capacity * sizeof(uint32_t),
+        value_capacity * sizeof(uint32_t));
+
+    if (value_length == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return CSV_NO_CODE;
+    }
+
+    dictionary->value_length = value_length;
+    dictionary->value_capacity = value_capacity;
+  }
+
+  uint32_t code = dictionary->values;
+
+  /* -- Codes only ever need to grow one step at a time */
+  if (code == (1u << 8) && csv_util_dictionary_widen(field_list, 2) != 0) {
+    return CSV_NO_CODE;
+  }
+
+  if (code == (1u << 16) && csv_util_dictionary_widen(field_list, 4) != 0) {
+    return CSV_NO_CODE;
+  }
+
+  size_t offset = csv_util_pool_store(field_list->string_pool, string, length);
+
+  if (offset == SIZE_MAX) {
+    return CSV_NO_CODE;
+  }
+
+  dictionary->value_offset[code] = offset;
+  dictionary->value_length[code] = length;
+  dictionary->values += 1;
+
+  *slot = code + 1;
+
+  return code;
+}
+
+/************************************************/
+/*             CSV_UTIL_DICTIONARY_DECODE       */
+/************************************************/
+
+int csv_util_dictionary_decode(CSV_FIELD_LIST *field_list) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+  CSV_ALLOCATOR *allocator = field_list->allocator;
+  size_t capacity = field_list->capacity;
+
+  size_t *char_offset =
+      csv_alloc_resize(allocator, NULL, 0, capacity * sizeof(size_t));
+  uint32_t *char_length =
+      csv_alloc_resize(allocator, NULL, 0, capacity * sizeof(uint32_t));
+
+  if (char_offset == NULL || char_length == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    csv_alloc_release(allocator, char_offset, capacity * sizeof(size_t));
+    csv_alloc_release(allocator, char_length, capacity * sizeof(uint32_t));
+    return -1;
+  }
+
+  /* -- Values are already in the pool, rows just point at them */
+  for (size_t row = 0; row < field_list->rows; row++) {
+    uint32_t code = csv_util_dictionary_code(dictionary, row);
+
+    char_offset[row] = dictionary->value_offset[code];
+    char_length[row] = dictionary->value_length[code];
+  }
+
+  csv_util_dictionary_free(field_list);
+
+  field_list->char_offset = char_offset;
+  field_list->char_length = char_length;
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_DICTIONARY_FREE         */
+/************************************************/
+
+void csv_util_dictionary_free(CSV_FIELD_LIST *field_list) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+  CSV_ALLOCATOR *allocator = field_list->allocator;
+
+  if (dictionary == NULL) {
+    return;
+  }
+
+  csv_alloc_release(allocator, dictionary->codes,
+                    field_list->capacity * dictionary->code_width);
+  csv_alloc_release(allocator, dictionary->slots,
+                    dictionary->slot_count * sizeof(uint32_t));
+  csv_alloc_release(allocator, dictionary->value_offset,
+                    dictionary->value_capacity * sizeof(size_t));
+  csv_alloc_release(allocator, dictionary->value_length,
+                    dictionary->value_capacity * sizeof(uint32_t));
+  csv_alloc_release(allocator, dictionary, sizeof(CSV_DICTIONARY));
+
+  field_list->dictionary = NULL;
+}
+
+/************************************************/
+/*             CSV_CODE                         */
+/************************************************/
+
+uint32_t csv_code(CSV_FIELD_LIST *field_list, size_t row) {
+  if (field_list == NULL || field_list->dictionary == NULL ||
+      row >= field_list->rows) {
+    return CSV_NO_CODE;
+  }
+
+  return csv_util_dictionary_code(field_list->dictionary, row);
+}
+
+/************************************************/
+/*             CSV_CODE_STRING                  */
+/************************************************/
+
+char *csv_code_string(CSV_FIELD_LIST *field_list, uint32_t code,
+                      size_t *length) {
+  if (field_list == NULL || field_list->dictionary == NULL ||
+      code >= field_list->dictionary->values) {
+    return NULL;
+  }
+
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+
+  if (length != NULL) {
+    *length = dictionary->value_length[code];
+  }
+
+  return csv_util_string(field_list->string_pool,
+                         dictionary->value_offset[code]);
+}
+
+/************************************************/
+/*             CSV_CODE_FIND                    */
+/************************************************/
+
+uint32_t csv_code_find(CSV_FIELD_LIST *field_list, const char *string,
+                       size_t length) {
+  if (field_list == NULL || string == NULL) {
+    return CSV_NO_CODE;
+  }
+
+  return csv_util_dictionary_find(field_list, string, length);
+}
@@ -0,0 +1,235 @@
+/**
+ * @file filter.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Row filters applied while importing
+ *
+ * A CSV_PREDICATE is resolved against the header once, comparisons then
+ * point at a source field. Rows are tested on their raw field spans before
+ * any cell is stored: only the fields a predicate looks at are trimmed and
+ * converted, a rejected row costs its delimiter scan and those few fields.
+ *
+ * @version 0.1
+ * @date 2025-01-16
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csv-arena.h>
+#include <csv-parser.h>
+#include <csv-utils.h>
+#include <libcsv.h>
+#include <util.h>
+
+/************************************************/
+/*             CSV_UTIL_FILTER_RESOLVE          */
+/************************************************/
+
+static int csv_util_filter_resolve(CSV_LIST *csv_list, CSV_FILTER *filter,
+                                   const CSV_PREDICATE *predicate,
+                                   char **names, unsigned total_fields) {
+  filter->predicate = predicate;
+
+  if (predicate->operator == CSV_AND || predicate->operator == CSV_OR) {
+    if (predicate->total_terms == 0) {
+      return 0;
+    }
+
+    filter->terms = csv_arena_alloc(
+        &csv_list->arena, predicate->total_terms * sizeof(CSV_FILTER));
+
+    if (filter->terms == NULL) {
+      return -1;
+    }
+
+    for (unsigned i = 0; i < predicate->total_terms; i++) {
+      if (csv_util_filter_resolve(csv_list, &filter->terms[i],
+                                  &predicate->terms[i], names,
+                                  total_fields) != 0) {
+        return -1;
+      }
+    }
+
+    return 0;
+  }
+
+  filter->source = total_fields;
+
+  if (predicate->field != NULL) {
+    for (unsigned field = 0; field < total_fields; field++) {
+      if (strcmp(names[field], predicate->field) == 0) {
+        filter->source = field;
+        break;
+      }
+    }
+  } else if (predicate->column < total_fields) {
+    filter->source = predicate->column;
+  }
+
+  /* -- Unknown fields hold for no row */
+  if (filter->source == total_fields) {
+    if (predicate->field != NULL) {
+      fprintf(stderr, "%s: No field %s.\n", __func__, predicate->field);
+    } else {
+      fprintf(stderr, "%s: No column %u.\n", __func__, predicate->column);
+    }
+  }
+
+  if (predicate->char_data != NULL) {
+    filter->char_length = strlen(predicate->char_data);
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_FILTER_COMPILE          */
+/************************************************/
+
+CSV_FILTER *csv_util_filter_compile(CSV_LIST *csv_list,
+                                    const CSV_PREDICATE *predicate,
+                                    char **names, unsigned total_fields) {
+  CSV_FILTER *filter = csv_arena_alloc(&csv_list->arena, sizeof(CSV_FILTER));
+
+  if (filter == NULL || csv_util_filter_resolve(csv_list, filter, predicate,
+                                                names, total_fields) != 0) {
+    return NULL;
+  }
+
+  return filter;
+}
+
+/************************************************/
+/*             CSV_UTIL_FILTER_ORDER            */
+/************************************************/
+
+static bool csv_util_filter_order(CSV_OPERATOR operator, int order) {
+  switch (operator) {
+  case CSV_EQUAL:
+    return order == 0;
+  case CSV_NOT_EQUAL:
+    return order != 0;
+  case CSV_LESS:
+    return order < 0;
+  case CSV_LESS_EQUAL:
+    return order <= 0;
+  case CSV_GREATER:
+    return order > 0;
+  case CSV_GREATER_EQUAL:
+    return order >= 0;
+  default:
+    return false;
+  }
+}
+
+/************************************************/
+/*             CSV_UTIL_FILTER_ROW              */
+/************************************************/
+
+bool csv_util_filter_row(CSV_LIST *csv_list, const CSV_FILTER *filter,
+                         const char *data, CSV_SPAN *fields,
+                         unsigned total_fields) {
+  const CSV_PREDICATE *predicate = filter->predicate;
+
+  if (predicate->operator == CSV_AND) {
+    for (unsigned i = 0; i < predicate->total_terms; i++) {
+      if (!csv_util_filter_row(csv_list, &filter->terms[i], data, fields,
+                               total_fields)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  if (predicate->operator == CSV_OR) {
+    for (unsigned i = 0; i < predicate->total_terms; i++) {
+      if (csv_util_filter_row(csv_list, &filter->terms[i], data, fields,
+                              total_fields)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  if (filter->source >= total_fields) {
+    return false;
+  }
+
+  CSV_SPAN *span = &fields[filter->source];
+
+  const char *token = data + span->begin;
+  size_t length = span->length;
+
+  /* -- The same token a cell would get, nulls hold for nothing */
+  if (!(span->flags & CSV_SPAN_QUOTED)) {
+    token = util_trim_span(token, &length);
+
+    if (length == 0) {
+      return false;
+    }
+  }
+
+  if ((span->flags & CSV_SPAN_ESCAPED) &&
+      csv_util_unescape(csv_list, &token, &length) != 0) {
+    return false;
+  }
+
+  if (predicate->operator == CSV_PREFIX) {
+    return predicate->char_data != NULL && length >= filter->char_length &&
+           memcmp(token, predicate->char_data, filter->char_length) == 0;
+  }
+
+  int order = 0;
+
+  switch (predicate->field_type) {
+  case CHAR_TYPE: {
+    if (predicate->char_data == NULL) {
+      return false;
+    }
+
+    size_t common = length < filter->char_length ? length : filter->char_length;
+
+    order = memcmp(token, predicate->char_data, common);
+
+    if (order == 0) {
+      order = (length > filter->char_length) - (length < filter->char_length);
+    }
+
+    break;
+  }
+  case INT_TYPE: {
+    int64_t number = 0;
+    double data = 0;
+
+    if (util_string_to_number(token, length, &number) == 0) {
+      order = (number > predicate->int_data) - (number < predicate->int_data);
+    } else if (util_string_to_double(token, length, &data) == 0) {
+      double value = (double)predicate->int_data;
+
+      order = (data > value) - (data < value);
+    } else {
+      return false;
+    }
+
+    break;
+  }
+  case DOUBLE_TYPE: {
+    double data = 0;
+
+    if (util_string_to_double(token, length, &data) != 0) {
+      return false;
+    }
+
+    order = (data > predicate->double_data) - (data < predicate->double_data);
+    break;
+  }
+  }
+
+  return csv_util_filter_order(predicate->operator, order);
+}
@@ -0,0 +1,349 @@
+/**
+ * @file follow.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Tail-follow imports of files that are appended to
+ *
+ * A followed list keeps its file open and remembers how far it has parsed,
+ * always the end of a complete row, and the header it started from. A
+ * refresh reads the bytes written since in blocks and parses the complete
+ * rows among them, so it costs the new bytes only. A partial last row is
+ * read again by the next refresh.
+ *
+ * A file shorter than the offset or with another header was truncated or
+ * rewritten and is read again from the start. When the name points to
+ * another file, the open one is read to its end first, then the new one is
+ * followed from its start (log rotation).
+ *
+ * @version 0.1
+ * @date 2025-01-25
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csv-arena.h>
+#include <csv-parser.h>
+#include <csv-utils.h>
+#include <libcsv.h>
+#include <util.h>
+
+/************************************************/
+/*             CSV_UTIL_FOLLOW_HEADER           */
+/************************************************/
+
+static int csv_util_follow_header(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                                  const char *data, CSV_PARSER *parser,
+                                  unsigned fields) {
+  CSV_FOLLOW *follow = csv_list->follow;
+  uint64_t header_hash = util_hash(data, parser->row);
+
+  if (follow->header_size == 0) {
+    /* -- The import options are resolved on the first header only */
+    csv_list->columns = follow->columns;
+    csv_list->predicate = follow->predicate;
+
+    csv_util_add_header(csv_list, metadata, data, parser->fields, fields);
+    csv_util_apply_schema(csv_list, metadata, follow->schema);
+
+    follow->header_size = parser->row;
+    follow->header_hash = header_hash;
+
+    follow->columns = NULL;
+    follow->predicate = NULL;
+    follow->schema = NULL;
+
+    return 0;
+  }
+
+  if (parser->row != follow->header_size ||
+      header_hash != follow->header_hash) {
+    fprintf(stderr, "%s: %s has another header.\n", __func__,
+            follow->csv_file);
+    return -1;
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_FOLLOW_REWRITTEN        */
+/************************************************/
+
+static bool csv_util_follow_rewritten(CSV_FOLLOW *follow, size_t size) {
+  if (size < follow->offset) {
+    return true;
+  }
+
+  if (follow->header_size == 0 || follow->offset < follow->header_size) {
+    return false;
+  }
+
+  /* -- Same length or longer, the header tells a rewritten file apart */
+  char *header = malloc(follow->header_size);
+
+  if (header == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return false;
+  }
+
+  ssize_t bytes = pread(follow->descriptor, header, follow->header_size, 0);
+
+  bool rewritten = bytes != (ssize_t)follow->header_size ||
+                   util_hash(header, follow->header_size) !=
+                       follow->header_hash;
+
+  free(header);
+
+  return rewritten;
+}
+
+/************************************************/
+/*             CSV_UTIL_FOLLOW_READ             */
+/************************************************/
+
+static int csv_util_follow_read(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                                size_t size) {
+  CSV_FOLLOW *follow = csv_list->follow;
+
+  if (size <= follow->offset) {
+    return 0;
+  }
+
+  /* -- Small appends get a small buffer, it only grows for a long row */
+  size_t capacity = size - follow->offset;
+
+  if (capacity > CSV_SCAN_BLOCK_SIZE) {
+    capacity = CSV_SCAN_BLOCK_SIZE;
+  }
+
+  char *buffer = malloc(capacity);
+
+  if (buffer == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
+
+  /* -- Rows are laid out like the ones of the import */
+  csv_list->projection = follow->projection;
+  csv_list->source_fields = follow->source_fields;
+  csv_list->filter = follow->filter;
+
+  CSV_PARSER parser = {0};
+
+  size_t position = follow->offset;
+  size_t used = 0;
+  bool header = position == 0;
+  int status = 0;
+
+  while (status == 0 && position + used < size) {
+    if (used == capacity) {
+      char *grown = realloc(buffer, capacity * 2);
+
+      if (grown == NULL) {
+        fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+        status = -1;
+        break;
+      }
+
+      buffer = grown;
+      capacity *= 2;
+    }
+
+    size_t length = capacity - used;
+
+    if (length > size - position - used) {
+      length = size - position - used;
+    }
+
+    ssize_t bytes =
+        pread(follow->descriptor, buffer + used, length, position + used);
+
+    /* -- The file shrank while it was read, the next refresh sees it */
+    if (bytes <= 0) {
+      if (bytes < 0) {
+        fprintf(stderr, "%s: Unable to read %s.\n", __func__,
+                follow->csv_file);
+        status = -1;
+      }
+
+      break;
+    }
+
+    used += bytes;
+
+    if (csv_parse_block(&parser, buffer, used) != 0) {
+      status = -1;
+      break;
+    }
+
+    unsigned fields = 0;
+    size_t stored = 0;
+
+    /* -- Only rows ended by a newline are complete */
+    while (csv_parse_row(&parser, false, &fields)) {
+      if (header) {
+        if (csv_util_follow_header(csv_list, metadata, buffer, &parser,
+                                   fields) != 0) {
+          status = -1;
+          break;
+        }
+
+        header = false;
+      } else if (csv_util_add_line(csv_list, metadata, buffer, parser.fields,
+                                   fields) != 0) {
+        status = -1;
+        break;
+      }
+
+      stored = parser.row;
+    }
+
+    /* -- Keep the partial row, or the one that failed, for the next block or
+     * refresh */
+    memmove(buffer, buffer + stored, used - stored);
+
+    position += stored;
+    used -= stored;
+  }
+
+  csv_parse_free(&parser);
+  free(buffer);
+
+  follow->offset = position;
+
+  /* -- The header resolves the layout, keep it for the next refresh */
+  follow->projection = csv_list->projection;
+  follow->source_fields = csv_list->source_fields;
+  follow->filter = csv_list->filter;
+
+  csv_util_end_import(csv_list);
+
+  return status;
+}
+
+/************************************************/
+/*             CSV_UTIL_FOLLOW_UPDATE           */
+/************************************************/
+
+static int csv_util_follow_update(CSV_LIST *csv_list, CSV_METADATA *metadata) {
+  CSV_FOLLOW *follow = csv_list->follow;
+  struct stat follow_stat;
+
+  if (fstat(follow->descriptor, &follow_stat) != 0) {
+    fprintf(stderr, "%s: Unable to stat %s.\n", __func__, follow->csv_file);
+    return -1;
+  }
+
+  if (csv_util_follow_rewritten(follow, follow_stat.st_size)) {
+    follow->offset = 0;
+  }
+
+  if (csv_util_follow_read(csv_list, metadata, follow_stat.st_size) != 0) {
+    return -1;
+  }
+
+  /* -- The old file was read to its end, switch to the one now named */
+  struct stat file_stat;
+
+  if (stat(follow->csv_file, &file_stat) != 0 ||
+      (file_stat.st_dev == follow_stat.st_dev &&
+       file_stat.st_ino == follow_stat.st_ino)) {
+    return 0;
+  }
+
+  int csv_fd = open(follow->csv_file, O_RDONLY);
+
+  if (csv_fd < 0) {
+    return 0;
+  }
+
+  close(follow->descriptor);
+
+  follow->descriptor = csv_fd;
+  follow->offset = 0;
+
+  if (fstat(csv_fd, &follow_stat) != 0) {
+    fprintf(stderr, "%s: Unable to stat %s.\n", __func__, follow->csv_file);
+    return -1;
+  }
+
+  return csv_util_follow_read(csv_list, metadata, follow_stat.st_size);
+}
+
+/************************************************/
+/*             CSV_UTIL_IMPORT_FOLLOW           */
+/************************************************/
+
+CSV_LIST *csv_util_import_follow(char *csv_file, CSV_METADATA **metadata,
+                                 CSV_OPTIONS *options) {
+  int csv_fd = open(csv_file, O_RDONLY);
+
+  if (csv_fd < 0) {
+    return NULL;
+  }
+
+  CSV_LIST *csv_list = csv_arena_list(options->allocator, metadata);
+
+  if (csv_list == NULL) {
+    close(csv_fd);
+    return NULL;
+  }
+
+  csv_util_prepare(csv_list, options);
+
+  CSV_FOLLOW *follow = csv_arena_alloc(&csv_list->arena, sizeof(CSV_FOLLOW));
+  char *follow_file = csv_arena_string(&csv_list->arena, csv_file);
+
+  if (follow == NULL || follow_file == NULL) {
+    close(csv_fd);
+    csv_clear(csv_list, *metadata);
+    return NULL;
+  }
+
+  follow->csv_file = follow_file;
+  follow->descriptor = csv_fd;
+
+  /* -- Held back until the header is read, which may be later */
+  follow->columns = csv_list->columns;
+  follow->predicate = csv_list->predicate;
+  follow->schema = options->schema;
+
+  csv_list->columns = NULL;
+  csv_list->predicate = NULL;
+  csv_list->follow = follow;
+
+  csv_util_follow_update(csv_list, *metadata);
+
+  return csv_list;
+}
+
+/************************************************/
+/*             CSV_REFRESH                      */
+/************************************************/
+
+size_t csv_refresh(CSV_LIST *csv_list, CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL) {
+    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+    return 0;
+  }
+
+  if (csv_list->follow == NULL) {
+    fprintf(stderr, "%s: csv_list was not imported with follow.\n", __func__);
+    return 0;
+  }
+
+  size_t items = metadata->items;
+
+  csv_util_follow_update(csv_list, metadata);
+
+  return metadata->items - items;
+}
@@ -0,0 +1,852 @@
+/**
+ * @file group.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Hash group by for libcsv
+ *
+ * Every row is turned into a key of one 8 byte word per key column (the
+ * integer, the bits of the double, the dictionary code or, for plain strings,
+ * the row holding the string) plus a word of null flags. Keys of all groups
+ * sit side by side in one array and an open addressing table maps a hash tag
+ * and the group number to them. With threads, each thread groups a range of
+ * rows into a table of its own and the partial groups are merged in row
+ * order, so groups come out in the same order as with one thread.
+ *
+ * @version 0.1
+ * @date 2025-01-18
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csv-arena.h>
+#include <csv-utils.h>
+#include <libcsv.h>
+#include <util.h>
+
+/************ GROUP TABLE ************/
+
+typedef struct csv_group_state {
+  size_t count;
+
+  /* -- Integer sums count the times they wrap, a sum left with a carry is
+   * written from the double one */
+  int64_t int_data;
+  int64_t int_carry;
+
+  /* -- Sums carry their rounding error, partial sums merge the same way
+   * whatever the number of threads */
+  double double_data;
+  double double_error;
+} CSV_GROUP_STATE;
+
+typedef struct csv_group_table {
+  /* -- key_words words per group, then the hash of the key */
+  uint64_t *keys;
+  uint64_t *hashes;
+
+  /* -- aggregates states per group */
+  CSV_GROUP_STATE *states;
+
+  size_t groups;
+  size_t capacity;
+
+  /* -- Hash tag in the high half, group + 1 in the low half, 0 is empty */
+  uint64_t *slots;
+  size_t slot_count;
+} CSV_GROUP_TABLE;
+
+typedef struct csv_group_context {
+  CSV_GROUP_BY *group_by;
+
+  CSV_FIELD_LIST **key_field;
+  CSV_FIELD_LIST **aggregate_field;
+
+  unsigned key_words;
+
+  const CSV_TOMBSTONES *tombstones;
+} CSV_GROUP_CONTEXT;
+
+typedef struct csv_group_chunk {
+  CSV_GROUP_CONTEXT *context;
+
+  size_t begin;
+  size_t end;
+
+  CSV_GROUP_TABLE table;
+  bool failed;
+} CSV_GROUP_CHUNK;
+
+/************************************************/
+/*             CSV_GROUP_ADD                    */
+/************************************************/
+
+static void csv_group_add(CSV_GROUP_STATE *state, double value) {
+  double total = state->double_data + value;
+
+  /* -- Neumaier, the bits lost by the larger operand are kept */
+  if (fabs(state->double_data) >= fabs(value)) {
+    state->double_error += (state->double_data - total) + value;
+  } else {
+    state->double_error += (value - total) + state->double_data;
+  }
+
+  state->double_data = total;
+}
+
+/************************************************/
+/*             CSV_GROUP_MIX                    */
+/************************************************/
+
+static uint64_t csv_group_mix(uint64_t hash, uint64_t word) {
+  hash ^= word;
+  hash *= 0x9E3779B97F4A7C15ULL;
+
+  return hash ^ (hash >> 29);
+}
+
+/************************************************/
+/*             CSV_GROUP_KEY                    */
+/************************************************/
+
+static uint64_t csv_group_key(const CSV_GROUP_CONTEXT *context, size_t row,
+                              uint64_t *key) {
+  unsigned keys = context->group_by->keys;
+
+  uint64_t nulls = 0;
+  uint64_t hash = 0;
+
+  for (unsigned k = 0; k < keys; k++) {
+    CSV_FIELD_LIST *field_list = context->key_field[k];
+    uint64_t word = 0;
+    uint64_t hash_word = 0;
+
+    if (csv_util_is_null(field_list, row)) {
+      nulls |= 1ULL << k;
+    } else if (field_list->field_type == INT_TYPE) {
+      word = (uint64_t)field_list->int_data[row];
+      hash_word = word;
+    } else if (field_list->field_type == DOUBLE_TYPE) {
+      /* -- 0.0 and -0.0 are the same key */
+      double data = field_list->double_data[row];
+
+      if (data == 0) {
+        data = 0;
+      }
+
+      memcpy(&word, &data, sizeof(word));
+      hash_word = word;
+    } else if (field_list->dictionary != NULL) {
+      word = csv_code(field_list, row);
+      hash_word = word;
+    } else {
+      size_t length = 0;
+      char *string = csv_util_char(field_list, row, &length);
+
+      word = row;
+      hash_word = util_hash(string, length);
+    }
+
+    key[k] = word;
+    hash = csv_group_mix(hash, hash_word);
+  }
+
+  key[keys] = nulls;
+
+  return csv_group_mix(hash, nulls);
+}
+
+/************************************************/
+/*             CSV_GROUP_EQUAL                  */
+/************************************************/
+
+static bool csv_group_equal(const CSV_GROUP_CONTEXT *context,
+                            const uint64_t *key, const uint64_t *other) {
+  unsigned keys = context->group_by->keys;
+
+  if (key[keys] != other[keys]) {
+    return false;
+  }
+
+  for (unsigned k = 0; k < keys; k++) {
+    CSV_FIELD_LIST *field_list = context->key_field[k];
+
+    if ((key[keys] >> k) & 1) {
+      continue;
+    }
+
+    /* -- Plain strings are compared through the rows holding them */
+    if (field_list->field_type == CHAR_TYPE &&
+        field_list->dictionary == NULL) {
+      if (key[k] == other[k]) {
+        continue;
+      }
+
+      size_t length = 0;
+      size_t other_length = 0;
+      char *string = csv_util_char(field_list, key[k], &length);
+      char *other_string = csv_util_char(field_list, other[k], &other_length);
+
+      if (length != other_length || memcmp(string, other_string, length) != 0) {
+        return false;
+      }
+
+      continue;
+    }
+
+    if (key[k] != other[k]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/************************************************/
+/*             CSV_GROUP_REHASH                 */
+/************************************************/
+
+static int csv_group_rehash(CSV_GROUP_TABLE *table) {
+  size_t slot_count = table->slot_count ? table->slot_count * 2 : 64;
+  uint64_t *slots = calloc(slot_count, sizeof(uint64_t));
+
+  if (slots == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
+
+  for (size_t group = 0; group < table->groups; group++) {
+    uint64_t hash = table->hashes[group];
+    size_t slot = hash & (slot_count - 1);
+
+    while (slots[slot] != 0) {
+      slot = (slot + 1) & (slot_count - 1);
+    }
+
+    slots[slot] = (hash & 0xFFFFFFFF00000000ULL) | (group + 1);
+  }
+
+  free(table->slots);
+
+  table->slots = slots;
+  table->slot_count = slot_count;
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_GROUP_FIND                   */
+/************************************************/
+
+/* -- Group of the key, a new one is added when it is not there yet */
+static size_t csv_group_find(const CSV_GROUP_CONTEXT *context,
+                             CSV_GROUP_TABLE *table, const uint64_t *key,
+                             uint64_t hash) {
+  unsigned key_words = context->key_words;
+  unsigned aggregates = context->group_by->aggregates;
+
+  /* -- Keep the table at most half full */
+  if ((table->groups + 1) * 2 > table->slot_count &&
+      csv_group_rehash(table) != 0) {
+    return SIZE_MAX;
+  }
+
+  uint64_t tag = hash & 0xFFFFFFFF00000000ULL;
+  size_t slot = hash & (table->slot_count - 1);
+
+  while (table->slots[slot] != 0) {
+    uint64_t entry = table->slots[slot];
+    size_t group = (entry & 0xFFFFFFFFULL) - 1;
+
+    if ((entry & 0xFFFFFFFF00000000ULL) == tag &&
+        csv_group_equal(context, table->keys + group * key_words, key)) {
+      return group;
+    }
+
+    slot = (slot + 1) & (table->slot_count - 1);
+  }
+
+  if (table->groups >= UINT32_MAX - 1) {
+    fprintf(stderr, "%s: Too many groups.\n", __func__);
+    return SIZE_MAX;
+  }
+
+  if (table->groups == table->capacity) {
+    size_t capacity = table->capacity ? table->capacity * 2 : 64;
+
+    uint64_t *keys =
+        realloc(table->keys, capacity * key_words * sizeof(uint64_t));
+
+    if (keys != NULL) {
+      table->keys = keys;
+    }
+
+    uint64_t *hashes = realloc(table->hashes, capacity * sizeof(uint64_t));
+
+    if (hashes != NULL) {
+      table->hashes = hashes;
+    }
+
+    CSV_GROUP_STATE *states = table->states;
+
+    if (aggregates > 0) {
+      states = realloc(table->states,
+                       capacity * aggregates * sizeof(CSV_GROUP_STATE));
+    }
+
+    if (states != NULL) {
+      table->states = states;
+    }
+
+    if (keys == NULL || hashes == NULL || (aggregates > 0 && states == NULL)) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return SIZE_MAX;
+    }
+
+    table->capacity = capacity;
+  }
+
+  size_t group = table->groups++;
+
+  memcpy(table->keys + group * key_words, key, key_words * sizeof(uint64_t));
+  table->hashes[group] = hash;
+
+  if (aggregates > 0) {
+    memset(table->states + group * aggregates, 0,
+           aggregates * sizeof(CSV_GROUP_STATE));
+  }
+
+  table->slots[slot] = tag | (group + 1);
+
+  return group;
+}
+
+/************************************************/
+/*             CSV_GROUP_UPDATE                 */
+/************************************************/
+
+static void csv_group_update(const CSV_GROUP_CONTEXT *context,
+                             CSV_GROUP_STATE *states, size_t row) {
+  for (unsigned a = 0; a < context->group_by->aggregates; a++) {
+    CSV_FIELD_LIST *field_list = context->aggregate_field[a];
+    CSV_GROUP_STATE *state = &states[a];
+
+    if (csv_util_is_null(field_list, row)) {
+      continue;
+    }
+
+    CSV_AGG_FUNCTION function = context->group_by->aggregate[a].function;
+
+    if (function == CSV_AGG_COUNT) {
+      state->count += 1;
+      continue;
+    }
+
+    bool is_int = field_list->field_type == INT_TYPE;
+
+    int64_t int_data = is_int ? field_list->int_data[row] : 0;
+    double double_data =
+        is_int ? (double)int_data : field_list->double_data[row];
+
+    switch (function) {
+    case CSV_AGG_SUM:
+    case CSV_AGG_MEAN:
+      if (__builtin_add_overflow(state->int_data, int_data,
+                                 &state->int_data)) {
+        state->int_carry += int_data < 0 ? -1 : 1;
+      }
+
+      csv_group_add(state, double_data);
+      break;
+    case CSV_AGG_MIN:
+      if (state->count == 0 || (is_int ? int_data < state->int_data
+                                       : double_data < state->double_data)) {
+        state->int_data = int_data;
+        state->double_data = double_data;
+      }
+      break;
+    case CSV_AGG_MAX:
+      if (state->count == 0 || (is_int ? int_data > state->int_data
+                                       : double_data > state->double_data)) {
+        state->int_data = int_data;
+        state->double_data = double_data;
+      }
+      break;
+    default:
+      break;
+    }
+
+    state->count += 1;
+  }
+}
+
+/************************************************/
+/*             CSV_GROUP_MERGE_STATE            */
+/************************************************/
+
+static void csv_group_merge_state(const CSV_GROUP_CONTEXT *context,
+                                  CSV_GROUP_STATE *states,
+                                  const CSV_GROUP_STATE *other) {
+  for (unsigned a = 0; a < context->group_by->aggregates; a++) {
+    CSV_GROUP_STATE *state = &states[a];
+    const CSV_GROUP_STATE *part = &other[a];
+
+    if (part->count == 0) {
+      continue;
+    }
+
+    bool is_int = context->aggregate_field[a]->field_type == INT_TYPE;
+    bool first = state->count == 0;
+
+    switch (context->group_by->aggregate[a].function) {
+    case CSV_AGG_SUM:
+    case CSV_AGG_MEAN:
+      state->int_carry += part->int_carry;
+
+      if (__builtin_add_overflow(state->int_data, part->int_data,
+                                 &state->int_data)) {
+        state->int_carry += part->int_data < 0 ? -1 : 1;
+      }
+
+      csv_group_add(state, part->double_data);
+      state->double_error += part->double_error;
+      break;
+    case CSV_AGG_MIN:
+      if (first || (is_int ? part->int_data < state->int_data
+                           : part->double_data < state->double_data)) {
+        state->int_data = part->int_data;
+        state->double_data = part->double_data;
+      }
+      break;
+    case CSV_AGG_MAX:
+      if (first || (is_int ? part->int_data > state->int_data
+                           : part->double_data > state->double_data)) {
+        state->int_data = part->int_data;
+        state->double_data = part->double_data;
+      }
+      break;
+    default:
+      break;
+    }
+
+    state->count += part->count;
+  }
+}
+
+/************************************************/
+/*             CSV_GROUP_CHUNK                  */
+/************************************************/
+
+static void *csv_group_chunk(void *argument) {
+  CSV_GROUP_CHUNK *chunk = argument;
+  CSV_GROUP_CONTEXT *context = chunk->context;
+  CSV_GROUP_TABLE *table = &chunk->table;
+
+  unsigned aggregates = context->group_by->aggregates;
+  uint64_t key[65];
+
+  for (size_t row = chunk->begin; row < chunk->end; row++) {
+    if (csv_util_row_dead(context->tombstones, row)) {
+      continue;
+    }
+
+    uint64_t hash = csv_group_key(context, row, key);
+    size_t group = csv_group_find(context, table, key, hash);
+
+    if (group == SIZE_MAX) {
+      chunk->failed = true;
+      return NULL;
+    }
+
+    csv_group_update(context, table->states + group * aggregates, row);
+  }
+
+  return NULL;
+}
+
+/************************************************/
+/*             CSV_GROUP_FREE                   */
+/************************************************/
+
+static void csv_group_free(CSV_GROUP_TABLE *table) {
+  free(table->keys);
+  free(table->hashes);
+  free(table->states);
+  free(table->slots);
+
+  memset(table, 0, sizeof(CSV_GROUP_TABLE));
+}
+
+/************************************************/
+/*             CSV_GROUP_RUN                    */
+/************************************************/
+
+static int csv_group_run(CSV_GROUP_CONTEXT *context, size_t rows,
+                         unsigned threads, CSV_GROUP_TABLE *table) {
+  unsigned total_chunks = threads ? threads : 1;
+
+  if (rows / CSV_GROUP_ROWS < total_chunks) {
+    total_chunks = rows / CSV_GROUP_ROWS ? rows / CSV_GROUP_ROWS : 1;
+  }
+
+  CSV_GROUP_CHUNK *chunks = calloc(total_chunks, sizeof(CSV_GROUP_CHUNK));
+  pthread_t *thread = calloc(total_chunks, sizeof(pthread_t));
+  bool *started = calloc(total_chunks, sizeof(bool));
+
+  if (chunks == NULL || thread == NULL || started == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    free(chunks);
+    free(thread);
+    free(started);
+    return -1;
+  }
+
+  for (unsigned c = 0; c < total_chunks; c++) {
+    chunks[c].context = context;
+    chunks[c].begin = rows / total_chunks * c;
+    chunks[c].end = c + 1 < total_chunks ? rows / total_chunks * (c + 1) : rows;
+  }
+
+  /* -- The first chunk is grouped on this thread */
+  for (unsigned c = 1; c < total_chunks; c++) {
+    started[c] =
+        pthread_create(&thread[c], NULL, csv_group_chunk, &chunks[c]) == 0;
+  }
+
+  for (unsigned c = 0; c < total_chunks; c++) {
+    if (!started[c]) {
+      csv_group_chunk(&chunks[c]);
+    }
+  }
+
+  for (unsigned c = 1; c < total_chunks; c++) {
+    if (started[c]) {
+      pthread_join(thread[c], NULL);
+    }
+  }
+
+  int status = 0;
+  unsigned aggregates = context->group_by->aggregates;
+
+  *table = chunks[0].table;
+  status = chunks[0].failed ? -1 : 0;
+
+  /* -- Partial groups are merged in row order */
+  for (unsigned c = 1; c < total_chunks; c++) {
+    CSV_GROUP_TABLE *part = &chunks[c].table;
+
+    if (chunks[c].failed) {
+      status = -1;
+    }
+
+    for (size_t group = 0; status == 0 && group < part->groups; group++) {
+      size_t merged = csv_group_find(context, table,
+                                     part->keys + group * context->key_words,
+                                     part->hashes[group]);
+
+      if (merged == SIZE_MAX) {
+        status = -1;
+        break;
+      }
+
+      csv_group_merge_state(context, table->states + merged * aggregates,
+                            part->states + group * aggregates);
+    }
+
+    csv_group_free(part);
+  }
+
+  free(chunks);
+  free(thread);
+  free(started);
+
+  return status;
+}
+
+/************************************************/
+/*             CSV_GROUP_FIELDS                 */
+/************************************************/
+
+static int csv_group_fields(CSV_GROUP_CONTEXT *context,
+                            const CSV_GROUP_TABLE *table,
+                            CSV_LIST *group_list,
+                            CSV_METADATA *group_metadata) {
+  CSV_GROUP_BY *group_by = context->group_by;
+  static const char *names[] = {"count", "sum", "min", "max", "mean"};
+
+  if (csv_util_reserve_fields(group_list, group_metadata,
+                              group_by->keys + group_by->aggregates) != 0) {
+    return -1;
+  }
+
+  for (unsigned k = 0; k < group_by->keys; k++) {
+    CSV_FIELD_LIST *field_list = context->key_field[k];
+
+    if (csv_util_add_field(group_list, group_metadata, field_list->field) !=
+        0) {
+      return -1;
+    }
+
+    csv_util_promote(group_list->field_list[k], field_list->field_type);
+  }
+
+  for (unsigned a = 0; a < group_by->aggregates; a++) {
+    CSV_FIELD_LIST *field_list = context->aggregate_field[a];
+    CSV_AGG_FUNCTION function = group_by->aggregate[a].function;
+    CSV_FIELD_TYPE field_type = field_list->field_type;
+
+    size_t length = strlen(field_list->field) + 8;
+    char *name = malloc(length);
+
+    if (name == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
+
+    snprintf(name, length, "%s(%s)", names[function], field_list->field);
+
+    int status = csv_util_add_field(group_list, group_metadata, name);
+
+    free(name);
+
+    if (status != 0) {
+      return -1;
+    }
+
+    if (function == CSV_AGG_COUNT) {
+      field_type = INT_TYPE;
+    } else if (function == CSV_AGG_MEAN) {
+      field_type = DOUBLE_TYPE;
+    } else if (function == CSV_AGG_SUM && field_type == INT_TYPE) {
+      /* -- A sum past the range of int64_t makes the column a double one */
+      for (size_t group = 0; group < table->groups; group++) {
+        if (table->states[group * group_by->aggregates + a].int_carry != 0) {
+          field_type = DOUBLE_TYPE;
+          break;
+        }
+      }
+    }
+
+    csv_util_promote(group_list->field_list[group_by->keys + a], field_type);
+  }
+
+  for (unsigned i = 0; i < group_metadata->fields; i++) {
+    group_list->field_list[i]->type_source = CSV_TYPE_DECLARED;
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_GROUP_ADD_ROW                */
+/************************************************/
+
+static void csv_group_add_row(CSV_GROUP_CONTEXT *context,
+                              CSV_LIST *group_list, const uint64_t *key,
+                              const CSV_GROUP_STATE *states) {
+  CSV_GROUP_BY *group_by = context->group_by;
+  unsigned keys = group_by->keys;
+
+  for (unsigned k = 0; k < keys; k++) {
+    CSV_FIELD_LIST *field_list = context->key_field[k];
+
+    if ((key[keys] >> k) & 1) {
+      csv_util_add_null(group_list, k);
+      continue;
+    }
+
+    switch (field_list->field_type) {
+    case INT_TYPE:
+    case DOUBLE_TYPE: {
+      uint64_t word = key[k];
+
+      csv_util_add_cell(group_list, k, &word, 0, field_list->field_type);
+      break;
+    }
+    case CHAR_TYPE: {
+      size_t length = 0;
+      char *string = NULL;
+
+      if (field_list->dictionary != NULL) {
+        string = csv_code_string(field_list, (uint32_t)key[k], &length);
+      } else {
+        string = csv_util_char(field_list, key[k], &length);
+      }
+
+      csv_util_add_cell(group_list, k, string, length, CHAR_TYPE);
+      break;
+    }
+    }
+  }
+
+  for (unsigned a = 0; a < group_by->aggregates; a++) {
+    const CSV_GROUP_STATE *state = &states[a];
+    CSV_AGG_FUNCTION function = group_by->aggregate[a].function;
+    unsigned column = keys + a;
+
+    if (function == CSV_AGG_COUNT) {
+      int64_t count = state->count;
+
+      csv_util_add_cell(group_list, column, &count, 0, INT_TYPE);
+      continue;
+    }
+
+    if (state->count == 0) {
+      csv_util_add_null(group_list, column);
+      continue;
+    }
+
+    if (function == CSV_AGG_MEAN) {
+      double mean =
+          (state->double_data + state->double_error) / (double)state->count;
+
+      csv_util_add_cell(group_list, column, &mean, 0, DOUBLE_TYPE);
+    } else if (group_list->field_list[column]->field_type == INT_TYPE) {
+      int64_t data = state->int_data;
+
+      csv_util_add_cell(group_list, column, &data, 0, INT_TYPE);
+    } else if (function == CSV_AGG_SUM) {
+      double data = state->double_data + state->double_error;
+
+      csv_util_add_cell(group_list, column, &data, 0, DOUBLE_TYPE);
+    } else {
+      double data = state->double_data;
+
+      csv_util_add_cell(group_list, column, &data, 0, DOUBLE_TYPE);
+    }
+  }
+}
+
+/************************************************/
+/*             CSV_GROUP_RESOLVE                */
+/************************************************/
+
+static int csv_group_resolve(CSV_GROUP_CONTEXT *context, CSV_LIST *csv_list,
+                             CSV_METADATA *metadata) {
+  CSV_GROUP_BY *group_by = context->group_by;
+
+  if (context->key_field == NULL || context->aggregate_field == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
+
+  for (unsigned k = 0; k < group_by->keys; k++) {
+    context->key_field[k] =
+        csv_column(group_by->key_column[k], csv_list, metadata);
+
+    if (context->key_field[k] == NULL) {
+      fprintf(stderr, "%s: No column %u.\n", __func__,
+              group_by->key_column[k]);
+      return -1;
+    }
+  }
+
+  for (unsigned a = 0; a < group_by->aggregates; a++) {
+    const CSV_GROUP_AGG *aggregate = &group_by->aggregate[a];
+    CSV_FIELD_LIST *field_list =
+        csv_column(aggregate->column, csv_list, metadata);
+
+    if (field_list == NULL) {
+      fprintf(stderr, "%s: No column %u.\n", __func__, aggregate->column);
+      return -1;
+    }
+
+    /* -- Columns of nulls have no storage to read yet */
+    if (field_list->field_type == CHAR_TYPE &&
+        aggregate->function != CSV_AGG_COUNT && field_list->capacity > 0) {
+      fprintf(stderr, "%s: %s is not a number column.\n", __func__,
+              field_list->field);
+      return -1;
+    }
+
+    context->aggregate_field[a] = field_list;
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_GROUP_BUILD                  */
+/************************************************/
+
+static CSV_LIST *csv_group_build(CSV_GROUP_CONTEXT *context,
+                                 CSV_GROUP_TABLE *table,
+                                 CSV_METADATA **group_metadata,
+                                 CSV_ALLOCATOR *allocator) {
+  CSV_LIST *group_list = csv_arena_list(allocator, group_metadata);
+
+  if (group_list == NULL) {
+    return NULL;
+  }
+
+  if (csv_group_fields(context, table, group_list, *group_metadata) != 0) {
+    csv_clear(group_list, *group_metadata);
+    return NULL;
+  }
+
+  unsigned aggregates = context->group_by->aggregates;
+
+  for (size_t group = 0; group < table->groups; group++) {
+    csv_group_add_row(context, group_list,
+                      table->keys + group * context->key_words,
+                      table->states + group * aggregates);
+  }
+
+  (*group_metadata)->items = table->groups;
+
+  return group_list;
+}
+
+/************************************************/
+/*             CSV_GROUP_BY                     */
+/************************************************/
+
+CSV_LIST *csv_group_by(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                       CSV_GROUP_BY *group_by, CSV_METADATA **group_metadata,
+                       CSV_OPTIONS *options) {
+  if (csv_list == NULL || metadata == NULL || group_by == NULL ||
+      group_metadata == NULL) {
+    return NULL;
+  }
+
+  CSV_OPTIONS defaults = {0};
+
+  if (options == NULL) {
+    options = &defaults;
+  }
+
+  if (group_by->keys > 64) {
+    fprintf(stderr, "%s: At most 64 key columns.\n", __func__);
+    return NULL;
+  }
+
+  CSV_GROUP_CONTEXT context = {0};
+
+  context.group_by = group_by;
+  context.key_words = group_by->keys + 1;
+  context.tombstones = &csv_list->tombstones;
+  context.key_field = calloc(group_by->keys + 1, sizeof(CSV_FIELD_LIST *));
+  context.aggregate_field =
+      calloc(group_by->aggregates + 1, sizeof(CSV_FIELD_LIST *));
+
+  CSV_LIST *group_list = NULL;
+  CSV_GROUP_TABLE table = {0};
+
+  if (csv_group_resolve(&context, csv_list, metadata) == 0 &&
+      csv_group_run(&context, metadata->items, options->threads, &table) ==
+          0) {
+    group_list = csv_group_build(&context, &table, group_metadata,
+                                 options->allocator);
+  }
+
+  csv_group_free(&table);
+  free(context.key_field);
+  free(context.aggregate_field);
+
+  return group_list;
+}
@@ -0,0 +1,719 @@
+/**
+ * @file join.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Hash join of two lists for libcsv
+ *
+ * The side with fewer live rows is built into hash tables and the other side
+ * probes them. Every key is reduced to a 64 bit hash first; numbers go
+ * through a bijective mix so equal hashes are equal numbers, strings are
+ * compared in full when their hashes match. Large builds are split into
+ * partitions on the high bits of the hash, both sides alike, so the table of
+ * a partition stays in cache while it is probed, and partitions are joined
+ * on several threads. Matches are then ordered by the left row, the result
+ * keeps the order of the left list whichever side was built.
+ *
+ * @version 0.1
+ * @date 2025-01-22
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csv-arena.h>
+#include <csv-utils.h>
+#include <libcsv.h>
+#include <util.h>
+
+/* -- At most 1 << CSV_JOIN_PARTITION_BITS partitions */
+#define CSV_JOIN_PARTITION_BITS 12
+
+/************ JOIN BUFFERS ************/
+
+typedef enum { CSV_JOIN_INT, CSV_JOIN_DOUBLE, CSV_JOIN_STRING } CSV_JOIN_MODE;
+
+typedef struct csv_join_entry {
+  uint64_t hash;
+  size_t row;
+} CSV_JOIN_ENTRY;
+
+typedef struct csv_join_side {
+  CSV_LIST *csv_list;
+  CSV_METADATA *metadata;
+  CSV_FIELD_LIST *key_field;
+
+  /* -- Hash of every dictionary value, strings are hashed once */
+  uint64_t *value_hash;
+
+  /* -- Live rows with a key, grouped by partition */
+  CSV_JOIN_ENTRY *entries;
+  size_t total_entries;
+  size_t *bounds;
+} CSV_JOIN_SIDE;
+
+typedef struct csv_join_context {
+  CSV_JOIN_MODE mode;
+
+  CSV_JOIN_SIDE *build;
+  CSV_JOIN_SIDE *probe;
+
+  /* -- The left list is built, pairs are flipped back when emitted */
+  bool build_left;
+
+  unsigned partition_bits;
+  size_t partitions;
+} CSV_JOIN_CONTEXT;
+
+typedef struct csv_join_task {
+  CSV_JOIN_CONTEXT *context;
+
+  /* -- Partitions first, first + stride, ... are joined by this task */
+  size_t first;
+  size_t stride;
+
+  /* -- Matches as left row, right row pairs */
+  size_t *pairs;
+  size_t total_pairs;
+  size_t capacity;
+
+  bool failed;
+} CSV_JOIN_TASK;
+
+/************************************************/
+/*             CSV_JOIN_MIX                     */
+/************************************************/
+
+/* -- Bijective, two numbers share a hash only when they are equal. Spreads
+ * string hashes over the high bits the partitions are taken from. */
+static uint64_t csv_join_mix(uint64_t word) {
+  word ^= word >> 33;
+  word *= 0xFF51AFD7ED558CCDULL;
+  word ^= word >> 33;
+  word *= 0xC4CEB9FE1A85EC53ULL;
+
+  return word ^ (word >> 33);
+}
+
+/************************************************/
+/*             CSV_JOIN_HASH                    */
+/************************************************/
+
+static uint64_t csv_join_hash(const CSV_JOIN_CONTEXT *context,
+                              const CSV_JOIN_SIDE *side, size_t row) {
+  CSV_FIELD_LIST *field_list = side->key_field;
+
+  switch (context->mode) {
+  case CSV_JOIN_INT:
+    return csv_join_mix((uint64_t)field_list->int_data[row]);
+  case CSV_JOIN_DOUBLE: {
+    double data = field_list->field_type == INT_TYPE
+                      ? (double)field_list->int_data[row]
+                      : field_list->double_data[row];
+    uint64_t word = 0;
+
+    /* -- 0.0 and -0.0 are the same key */
+    if (data == 0) {
+      data = 0;
+    }
+
+    memcpy(&word, &data, sizeof(word));
+
+    return csv_join_mix(word);
+  }
+  case CSV_JOIN_STRING:
+    break;
+  }
+
+  if (side->value_hash != NULL) {
+    return side->value_hash[csv_code(field_list, row)];
+  }
+
+  size_t length = 0;
+  char *string = csv_util_char(field_list, row, &length);
+
+  return csv_join_mix(util_hash(string, length));
+}
+
+/************************************************/
+/*             CSV_JOIN_EQUAL                   */
+/************************************************/
+
+static bool csv_join_equal(const CSV_JOIN_CONTEXT *context,
+                           const CSV_JOIN_ENTRY *build,
+                           const CSV_JOIN_ENTRY *probe) {
+  if (build->hash != probe->hash) {
+    return false;
+  }
+
+  if (context->mode != CSV_JOIN_STRING) {
+    return true;
+  }
+
+  size_t length = 0;
+  size_t other_length = 0;
+  char *string =
+      csv_util_char(context->build->key_field, build->row, &length);
+  char *other_string =
+      csv_util_char(context->probe->key_field, probe->row, &other_length);
+
+  return length == other_length && memcmp(string, other_string, length) == 0;
+}
+
+/************************************************/
+/*             CSV_JOIN_ENTRIES                 */
+/************************************************/
+
+/* -- Hashes the keys of a side and scatters them into partitions */
+static int csv_join_entries(CSV_JOIN_CONTEXT *context, CSV_JOIN_SIDE *side) {
+  CSV_FIELD_LIST *field_list = side->key_field;
+  size_t items = side->metadata->items;
+
+  if (context->mode == CSV_JOIN_STRING && field_list->dictionary != NULL) {
+    uint32_t values = field_list->dictionary->values;
+
+    side->value_hash = malloc((values + 1) * sizeof(uint64_t));
+
+    if (side->value_hash == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
+
+    for (uint32_t code = 0; code < values; code++) {
+      size_t length = 0;
+      char *string = csv_code_string(field_list, code, &length);
+
+      side->value_hash[code] = csv_join_mix(util_hash(string, length));
+    }
+  }
+
+  CSV_JOIN_ENTRY *entries = malloc((items + 1) * sizeof(CSV_JOIN_ENTRY));
+  side->bounds = calloc(context->partitions + 1, sizeof(size_t));
+
+  if (entries == NULL || side->bounds == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    free(entries);
+    return -1;
+  }
+
+  /* -- Nulls never match, nothing matches a column of nulls */
+  size_t total_entries = 0;
+
+  bool empty = context->build->key_field->capacity == 0 ||
+               context->probe->key_field->capacity == 0;
+
+  for (size_t row = 0; !empty && row < items; row++) {
+    if (csv_util_row_dead(&side->csv_list->tombstones, row) ||
+        csv_util_is_null(field_list, row)) {
+      continue;
+    }
+
+    entries[total_entries].hash = csv_join_hash(context, side, row);
+    entries[total_entries].row = row;
+    total_entries++;
+  }
+
+  side->total_entries = total_entries;
+
+  if (context->partition_bits == 0) {
+    side->entries = entries;
+    side->bounds[1] = total_entries;
+    return 0;
+  }
+
+  /* -- Stable scatter on the high bits, rows stay in order per partition */
+  unsigned shift = 64 - context->partition_bits;
+  size_t *count = calloc(context->partitions, sizeof(size_t));
+
+  side->entries = malloc((total_entries + 1) * sizeof(CSV_JOIN_ENTRY));
+
+  if (count == NULL || side->entries == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    free(count);
+    free(entries);
+    return -1;
+  }
+
+  for (size_t i = 0; i < total_entries; i++) {
+    count[entries[i].hash >> shift]++;
+  }
+
+  for (size_t partition = 0; partition < context->partitions; partition++) {
+    side->bounds[partition + 1] = side->bounds[partition] + count[partition];
+    count[partition] = side->bounds[partition];
+  }
+
+  for (size_t i = 0; i < total_entries; i++) {
+    side->entries[count[entries[i].hash >> shift]++] = entries[i];
+  }
+
+  free(count);
+  free(entries);
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_JOIN_EMIT                    */
+/************************************************/
+
+static bool csv_join_emit(CSV_JOIN_TASK *task, size_t build_row,
+                          size_t probe_row) {
+  if (task->total_pairs == task->capacity) {
+    size_t capacity = task->capacity ? task->capacity * 2 : 1024;
+    size_t *pairs = realloc(task->pairs, capacity * 2 * sizeof(size_t));
+
+    if (pairs == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return false;
+    }
+
+    task->pairs = pairs;
+    task->capacity = capacity;
+  }
+
+  size_t *pair = task->pairs + task->total_pairs * 2;
+
+  pair[0] = task->context->build_left ? build_row : probe_row;
+  pair[1] = task->context->build_left ? probe_row : build_row;
+
+  task->total_pairs++;
+
+  return true;
+}
+
+/************************************************/
+/*             CSV_JOIN_PARTITION               */
+/************************************************/
+
+static bool csv_join_partition(CSV_JOIN_TASK *task, size_t partition,
+                               uint32_t *heads, uint32_t *next) {
+  CSV_JOIN_CONTEXT *context = task->context;
+
+  const CSV_JOIN_ENTRY *build =
+      context->build->entries + context->build->bounds[partition];
+  size_t total_build = context->build->bounds[partition + 1] -
+                       context->build->bounds[partition];
+
+  const CSV_JOIN_ENTRY *probe =
+      context->probe->entries + context->probe->bounds[partition];
+  size_t total_probe = context->probe->bounds[partition + 1] -
+                       context->probe->bounds[partition];
+
+  if (total_build == 0 || total_probe == 0) {
+    return true;
+  }
+
+  size_t slot_count = 16;
+
+  while (slot_count < total_build) {
+    slot_count *= 2;
+  }
+
+  /* -- Chains of entry + 1, built backwards so they run in row order */
+  memset(heads, 0, slot_count * sizeof(uint32_t));
+
+  for (size_t i = total_build; i > 0; i--) {
+    size_t slot = build[i - 1].hash & (slot_count - 1);
+
+    next[i - 1] = heads[slot];
+    heads[slot] = (uint32_t)i;
+  }
+
+  for (size_t i = 0; i < total_probe; i++) {
+    uint32_t entry = heads[probe[i].hash & (slot_count - 1)];
+
+    while (entry != 0) {
+      if (csv_join_equal(context, &build[entry - 1], &probe[i]) &&
+          !csv_join_emit(task, build[entry - 1].row, probe[i].row)) {
+        return false;
+      }
+
+      entry = next[entry - 1];
+    }
+  }
+
+  return true;
+}
+
+/************************************************/
+/*             CSV_JOIN_TASK                    */
+/************************************************/
+
+static void *csv_join_task(void *argument) {
+  CSV_JOIN_TASK *task = argument;
+  CSV_JOIN_CONTEXT *context = task->context;
+
+  /* -- One table sized for the largest partition, reused for every one */
+  size_t largest = 0;
+
+  for (size_t p = task->first; p < context->partitions; p += task->stride) {
+    size_t total = context->build->bounds[p + 1] - context->build->bounds[p];
+
+    if (total > largest) {
+      largest = total;
+    }
+  }
+
+  size_t slot_count = 16;
+
+  while (slot_count < largest) {
+    slot_count *= 2;
+  }
+
+  uint32_t *heads = malloc(slot_count * sizeof(uint32_t));
+  uint32_t *next = malloc((largest + 1) * sizeof(uint32_t));
+
+  if (heads == NULL || next == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    task->failed = true;
+  }
+
+  for (size_t p = task->first; !task->failed && p < context->partitions;
+       p += task->stride) {
+    task->failed = !csv_join_partition(task, p, heads, next);
+  }
+
+  free(heads);
+  free(next);
+
+  return NULL;
+}
+
+/************************************************/
+/*             CSV_JOIN_RUN                     */
+/************************************************/
+
+static CSV_JOIN_TASK *csv_join_run(CSV_JOIN_CONTEXT *context,
+                                   unsigned threads, unsigned *total_tasks) {
+  unsigned tasks = threads ? threads : 1;
+
+  if (context->partitions < tasks) {
+    tasks = (unsigned)context->partitions;
+  }
+
+  CSV_JOIN_TASK *task = calloc(tasks, sizeof(CSV_JOIN_TASK));
+  pthread_t *thread = calloc(tasks, sizeof(pthread_t));
+  bool *started = calloc(tasks, sizeof(bool));
+
+  if (task == NULL || thread == NULL || started == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    free(task);
+    free(thread);
+    free(started);
+    return NULL;
+  }
+
+  for (unsigned t = 0; t < tasks; t++) {
+    task[t].context = context;
+    task[t].first = t;
+    task[t].stride = tasks;
+  }
+
+  /* -- The first task runs on this thread */
+  for (unsigned t = 1; t < tasks; t++) {
+    started[t] = pthread_create(&thread[t], NULL, csv_join_task, &task[t]) == 0;
+  }
+
+  for (unsigned t = 0; t < tasks; t++) {
+    if (!started[t]) {
+      csv_join_task(&task[t]);
+    }
+  }
+
+  for (unsigned t = 1; t < tasks; t++) {
+    if (started[t]) {
+      pthread_join(thread[t], NULL);
+    }
+  }
+
+  free(thread);
+  free(started);
+
+  *total_tasks = tasks;
+
+  return task;
+}
+
+/************************************************/
+/*             CSV_JOIN_FIELDS                  */
+/************************************************/
+
+static int csv_join_fields(CSV_LIST *join_list, CSV_METADATA *join_metadata,
+                           CSV_JOIN_SIDE *side, const char *prefix) {
+  size_t prefix_length = strlen(prefix);
+
+  for (unsigned i = 0; i < side->metadata->fields; i++) {
+    CSV_FIELD_LIST *field_list = side->csv_list->field_list[i];
+
+    size_t length = prefix_length + strlen(field_list->field) + 1;
+    char *name = malloc(length);
+
+    if (name == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
+
+    snprintf(name, length, "%s%s", prefix, field_list->field);
+
+    int status = csv_util_add_field(join_list, join_metadata, name);
+
+    free(name);
+
+    if (status != 0) {
+      return -1;
+    }
+
+    CSV_FIELD_LIST *join_field =
+        join_list->field_list[join_metadata->fields - 1];
+
+    csv_util_promote(join_field, field_list->field_type);
+    join_field->type_source = CSV_TYPE_DECLARED;
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_JOIN_COPY                    */
+/************************************************/
+
+/* -- Copies the cells of a row, or nulls for a missing row, from column on */
+static void csv_join_copy(CSV_LIST *join_list, unsigned column,
+                          CSV_JOIN_SIDE *side, size_t row, bool missing) {
+  for (unsigned i = 0; i < side->metadata->fields; i++) {
+    CSV_FIELD_LIST *field_list = side->csv_list->field_list[i];
+
+    if (missing || csv_util_is_null(field_list, row)) {
+      csv_util_add_null(join_list, column + i);
+      continue;
+    }
+
+    switch (field_list->field_type) {
+    case CHAR_TYPE: {
+      size_t length = 0;
+      char *string = csv_util_char(field_list, row, &length);
+
+      csv_util_add_cell(join_list, column + i, string, length, CHAR_TYPE);
+      break;
+    }
+    case INT_TYPE:
+    case DOUBLE_TYPE:
+      csv_util_add_cell(join_list, column + i, &field_list->int_data[row], 0,
+                        field_list->field_type);
+      break;
+    }
+  }
+}
+
+/************************************************/
+/*             CSV_JOIN_BUILD                   */
+/************************************************/
+
+static CSV_LIST *csv_join_build(CSV_JOIN_SIDE *left, CSV_JOIN_SIDE *right,
+                                CSV_JOIN *join, CSV_JOIN_TASK *task,
+                                unsigned total_tasks,
+                                CSV_METADATA **join_metadata,
+                                CSV_ALLOCATOR *allocator) {
+  size_t items = left->metadata->items;
+  size_t total_pairs = 0;
+
+  for (unsigned t = 0; t < total_tasks; t++) {
+    total_pairs += task[t].total_pairs;
+  }
+
+  /* -- Matches counted by left row, right rows placed in the same order */
+  size_t *first = calloc(items + 2, sizeof(size_t));
+  size_t *match = malloc((total_pairs + 1) * sizeof(size_t));
+
+  if (first == NULL || match == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    free(first);
+    free(match);
+    return NULL;
+  }
+
+  for (unsigned t = 0; t < total_tasks; t++) {
+    for (size_t i = 0; i < task[t].total_pairs; i++) {
+      first[task[t].pairs[i * 2] + 2]++;
+    }
+  }
+
+  for (size_t row = 2; row <= items + 1; row++) {
+    first[row] += first[row - 1];
+  }
+
+  for (unsigned t = 0; t < total_tasks; t++) {
+    for (size_t i = 0; i < task[t].total_pairs; i++) {
+      match[first[task[t].pairs[i * 2] + 1]++] = task[t].pairs[i * 2 + 1];
+    }
+  }
+
+  CSV_LIST *join_list = csv_arena_list(allocator, join_metadata);
+
+  if (join_list == NULL ||
+      csv_util_reserve_fields(join_list, *join_metadata,
+                              left->metadata->fields +
+                                  right->metadata->fields) != 0 ||
+      csv_join_fields(join_list, *join_metadata, left,
+                      join->left_prefix ? join->left_prefix : "left.") != 0 ||
+      csv_join_fields(join_list, *join_metadata, right,
+                      join->right_prefix ? join->right_prefix : "right.") !=
+          0) {
+    if (join_list != NULL) {
+      csv_clear(join_list, *join_metadata);
+    }
+
+    free(first);
+    free(match);
+    return NULL;
+  }
+
+  unsigned right_column = left->metadata->fields;
+  size_t rows = 0;
+
+  for (size_t row = 0; row < items; row++) {
+    if (csv_util_row_dead(&left->csv_list->tombstones, row)) {
+      continue;
+    }
+
+    for (size_t i = first[row]; i < first[row + 1]; i++) {
+      csv_join_copy(join_list, 0, left, row, false);
+      csv_join_copy(join_list, right_column, right, match[i], false);
+      rows++;
+    }
+
+    if (first[row] == first[row + 1] && join->kind == CSV_JOIN_LEFT) {
+      csv_join_copy(join_list, 0, left, row, false);
+      csv_join_copy(join_list, right_column, right, 0, true);
+      rows++;
+    }
+  }
+
+  (*join_metadata)->items = rows;
+
+  free(first);
+  free(match);
+
+  return join_list;
+}
+
+/************************************************/
+/*             CSV_JOIN_RESOLVE                 */
+/************************************************/
+
+static int csv_join_resolve(CSV_JOIN_CONTEXT *context, CSV_JOIN_SIDE *left,
+                            CSV_JOIN_SIDE *right, CSV_JOIN *join) {
+  left->key_field = csv_column(join->left_key, left->csv_list, left->metadata);
+  right->key_field =
+      csv_column(join->right_key, right->csv_list, right->metadata);
+
+  if (left->key_field == NULL || right->key_field == NULL) {
+    fprintf(stderr, "%s: No column %u.\n", __func__,
+            left->key_field == NULL ? join->left_key : join->right_key);
+    return -1;
+  }
+
+  CSV_FIELD_TYPE left_type = left->key_field->field_type;
+  CSV_FIELD_TYPE right_type = right->key_field->field_type;
+
+  /* -- Columns of nulls match nothing, whatever their type */
+  if (left->key_field->capacity == 0 || right->key_field->capacity == 0) {
+    context->mode = CSV_JOIN_INT;
+  } else if (left_type == CHAR_TYPE && right_type == CHAR_TYPE) {
+    context->mode = CSV_JOIN_STRING;
+  } else if (left_type == CHAR_TYPE || right_type == CHAR_TYPE) {
+    fprintf(stderr, "%s: %s and %s are not both strings or numbers.\n",
+            __func__, left->key_field->field, right->key_field->field);
+    return -1;
+  } else if (left_type == INT_TYPE && right_type == INT_TYPE) {
+    context->mode = CSV_JOIN_INT;
+  } else {
+    context->mode = CSV_JOIN_DOUBLE;
+  }
+
+  size_t left_live = left->metadata->items - left->csv_list->tombstones.dead;
+  size_t right_live =
+      right->metadata->items - right->csv_list->tombstones.dead;
+
+  /* -- The smaller side is built, the left one on a tie */
+  context->build_left = left_live <= right_live;
+  context->build = context->build_left ? left : right;
+  context->probe = context->build_left ? right : left;
+
+  size_t build_live = context->build_left ? left_live : right_live;
+
+  /* -- Partitions small enough for their table to stay in cache */
+  while (context->partition_bits < CSV_JOIN_PARTITION_BITS &&
+         (build_live >> context->partition_bits) > CSV_JOIN_PARTITION_ROWS) {
+    context->partition_bits++;
+  }
+
+  context->partitions = (size_t)1 << context->partition_bits;
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_JOIN                         */
+/************************************************/
+
+CSV_LIST *csv_join(CSV_LIST *left_list, CSV_METADATA *left_metadata,
+                   CSV_LIST *right_list, CSV_METADATA *right_metadata,
+                   CSV_JOIN *join, CSV_METADATA **join_metadata,
+                   CSV_OPTIONS *options) {
+  if (left_list == NULL || left_metadata == NULL || right_list == NULL ||
+      right_metadata == NULL || join == NULL || join_metadata == NULL) {
+    return NULL;
+  }
+
+  CSV_OPTIONS defaults = {0};
+
+  if (options == NULL) {
+    options = &defaults;
+  }
+
+  CSV_JOIN_SIDE left = {left_list, left_metadata};
+  CSV_JOIN_SIDE right = {right_list, right_metadata};
+  CSV_JOIN_CONTEXT context = {0};
+
+  CSV_LIST *join_list = NULL;
+  CSV_JOIN_TASK *task = NULL;
+  unsigned total_tasks = 0;
+
+  if (csv_join_resolve(&context, &left, &right, join) == 0 &&
+      csv_join_entries(&context, context.build) == 0 &&
+      csv_join_entries(&context, context.probe) == 0) {
+    task = csv_join_run(&context, options->threads, &total_tasks);
+  }
+
+  bool failed = task == NULL;
+
+  for (unsigned t = 0; t < total_tasks; t++) {
+    failed = failed || task[t].failed;
+  }
+
+  if (!failed) {
+    join_list = csv_join_build(&left, &right, join, task, total_tasks,
+                               join_metadata, options->allocator);
+  }
+
+  for (unsigned t = 0; t < total_tasks; t++) {
+    free(task[t].pairs);
+  }
+
+  free(task);
+
+  CSV_JOIN_SIDE *sides[] = {&left, &right};
+
+  for (unsigned i = 0; i < 2; i++) {
+    free(sides[i]->value_hash);
+    free(sides[i]->entries);
+    free(sides[i]->bounds);
+  }
+
+  return join_list;
+}
@@ -13,608 +13,2419 @@
  * @copyright Copyright (c) 2025
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <float.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <csv-arena.h>
+#include <csv-parser.h>
+#include <csv-utils.h>
 #include <libcsv.h>
 #include <util.h>
 
 /************************************************/
-/*             CSV_UTIL_ADD_NODE                */
+/*             CSV_UTIL_POOL_RESERVE            */
 /************************************************/
 
-/* TODO: Refactor code */
-void csv_util_add_node(CSV_LIST *csv_list, unsigned field, void *data,
-                       CSV_FIELD_TYPE csv_field_type) {
+int csv_util_pool_reserve(CSV_STRING_POOL *string_pool, size_t length) {
+  if (string_pool->size + length <= string_pool->capacity) {
+    return 0;
+  }
 
-  switch (csv_field_type) {
-  case CHAR_TYPE: {
-    CSV_CHAR_BLOCK *block = calloc(1, sizeof(CSV_CHAR_BLOCK));
+  size_t capacity = string_pool->capacity ? string_pool->capacity
+                                          : CSV_INITIAL_POOL;
 
-    if (block == NULL) {
-      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
-      return;
-    }
+  while (capacity < string_pool->size + length) {
+    capacity *= 2;
+  }
 
-    block->next_block = NULL;
-    block->data = (char *)data;
+  char *data = csv_alloc_resize(string_pool->allocator, string_pool->data,
+                                string_pool->capacity, capacity);
 
-    /* -- Add node */
+  if (data == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
 
-    CSV_CHAR_BLOCK **head = &csv_list->field_list[field]->char_block_head;
-    CSV_CHAR_BLOCK **tail = &csv_list->field_list[field]->char_block_tail;
+  string_pool->data = data;
+  string_pool->capacity = capacity;
 
-    if (*head == NULL) {
-      *head = block;
-      *tail = block;
-    } else {
-      (*tail)->next_block = block;
-      *tail = block;
-    }
+  return 0;
+}
 
-    break;
+/************************************************/
+/*             CSV_UTIL_POOL_ADD                */
+/************************************************/
+
+size_t csv_util_pool_add(CSV_STRING_POOL *string_pool, const char *string,
+                         size_t length) {
+  if (csv_util_pool_reserve(string_pool, length + 1) != 0) {
+    return SIZE_MAX;
   }
-  case INT_TYPE: {
-    CSV_INT_BLOCK *block = (CSV_INT_BLOCK *)calloc(1, sizeof(CSV_INT_BLOCK));
 
-    if (block == NULL) {
-      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
-      return;
-    }
+  size_t offset = string_pool->size;
 
-    block->next_block = NULL;
-    block->data = *((int *)data);
+  memcpy(string_pool->data + offset, string, length);
+  string_pool->data[offset + length] = '\0';
 
-    /* -- Add node */
+  string_pool->size += length + 1;
 
-    CSV_INT_BLOCK **head = &csv_list->field_list[field]->int_block_head;
-    CSV_INT_BLOCK **tail = &csv_list->field_list[field]->int_block_tail;
+  /* -- Heap strings are addressed after the mapped bytes */
+  return string_pool->mapped_size + offset;
+}
 
-    if (*head == NULL) {
-      *head = block;
-      *tail = block;
-    } else {
-      (*tail)->next_block = block;
-      *tail = block;
-    }
+/************************************************/
+/*             CSV_UTIL_POOL_STORE              */
+/************************************************/
 
-    break;
+size_t csv_util_pool_store(CSV_STRING_POOL *string_pool, const char *string,
+                           size_t length) {
+  /* -- Tokens inside the file mapping are kept as views, not copied */
+  if (string_pool->mapped_data != NULL &&
+      (uintptr_t)string >= (uintptr_t)string_pool->mapped_data &&
+      (uintptr_t)string + length <=
+          (uintptr_t)string_pool->mapped_data + string_pool->mapped_size) {
+    return string - string_pool->mapped_data;
   }
-  case DOUBLE_TYPE: {
-    CSV_DOUBLE_BLOCK *block =
-        (CSV_DOUBLE_BLOCK *)calloc(1, sizeof(CSV_DOUBLE_BLOCK));
 
-    if (block == NULL) {
+  return csv_util_pool_add(string_pool, string, length);
+}
+
+/************************************************/
+/*             CSV_UTIL_STRING                  */
+/************************************************/
+
+char *csv_util_string(CSV_STRING_POOL *string_pool, size_t offset) {
+  if (offset < string_pool->mapped_size) {
+    return (char *)string_pool->mapped_data + offset;
+  }
+
+  return string_pool->data + (offset - string_pool->mapped_size);
+}
+
+/************************************************/
+/*             CSV_UTIL_RESERVE                 */
+/************************************************/
+
+int csv_util_reserve(CSV_FIELD_LIST *field_list, size_t rows) {
+  if (rows <= field_list->capacity) {
+    return 0;
+  }
+
+  size_t capacity = field_list->capacity ? field_list->capacity
+                                         : CSV_INITIAL_ROWS;
+
+  while (capacity < rows) {
+    capacity *= 2;
+  }
+
+  CSV_ALLOCATOR *allocator = field_list->allocator;
+  size_t old_capacity = field_list->capacity;
+
+  /* -- A new string column starts out dictionary encoded */
+  if (field_list->field_type == CHAR_TYPE && old_capacity == 0 &&
+      field_list->dictionary == NULL &&
+      field_list->dictionary_mode != CSV_DICTIONARY_OFF &&
+      csv_util_dictionary_create(field_list) != 0) {
+    return -1;
+  }
+
+  if (field_list->dictionary != NULL) {
+    if (csv_util_dictionary_reserve(field_list, capacity) != 0) {
+      return -1;
+    }
+  } else if (field_list->field_type == CHAR_TYPE) {
+    size_t *char_offset = csv_alloc_resize(
+        allocator, field_list->char_offset, old_capacity * sizeof(size_t),
+        capacity * sizeof(size_t));
+
+    if (char_offset == NULL) {
       fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
-      return;
+      return -1;
     }
 
-    block->next_block = NULL;
-    block->data = *((double *)data);
+    field_list->char_offset = char_offset;
 
-    /* -- Add node */
+    uint32_t *char_length = csv_alloc_resize(
+        allocator, field_list->char_length, old_capacity * sizeof(uint32_t),
+        capacity * sizeof(uint32_t));
+
+    if (char_length == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
 
-    CSV_DOUBLE_BLOCK **head = &csv_list->field_list[field]->double_block_head;
-    CSV_DOUBLE_BLOCK **tail = &csv_list->field_list[field]->double_block_tail;
+    field_list->char_length = char_length;
+  } else {
+    int64_t *int_data = csv_alloc_resize(allocator, field_list->int_data,
+                                         old_capacity * 8, capacity * 8);
 
-    if (*head == NULL) {
-      *head = block;
-      *tail = block;
-    } else {
-      (*tail)->next_block = block;
-      *tail = block;
+    if (int_data == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
     }
 
-    break;
+    field_list->int_data = int_data;
   }
-  }
-}
 
-/************************************************/
-/*             CSV_UTIL_SHOW                    */
-/************************************************/
+  /* -- The null map only exists once a column has seen an empty cell */
+  if (field_list->null_data != NULL) {
+    uint8_t *null_data = csv_alloc_resize(allocator, field_list->null_data,
+                                          old_capacity, capacity);
 
-void csv_util_show(CSV_LIST *csv_list, FILE *csv_stream,
-                   CSV_METADATA *metadata) {
+    if (null_data == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
 
-  if (csv_list == NULL || metadata == NULL) {
-    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
-    return;
-  }
+    memset(null_data + old_capacity, 0, capacity - old_capacity);
 
-  /* -- First print fields */
-  for (int i = 0; i < metadata->fields; i++) {
-    fprintf(csv_stream, "%s%s", csv_list->field_list[i]->field,
-            (i != metadata->fields - 1) ? "," : "");
+    field_list->null_data = null_data;
   }
 
-  fprintf(csv_stream, "\n");
+  field_list->capacity = capacity;
 
-  /* -- Print remaining data */
-  unsigned int row = 0;
+  /* -- Rows counted before the column had storage are all nulls */
+  if (old_capacity == 0 && field_list->rows > 0) {
+    return csv_util_fill_nulls(field_list);
+  }
 
-  for (int i = 0; i < metadata->items; i++) {
-    for (int j = 0; j < metadata->fields; j++) {
-      unsigned current_row = 0;
+  return 0;
+}
 
-      CSV_FIELD_TYPE field_type = csv_list->field_list[j]->field_type;
+/************************************************/
+/*             CSV_UTIL_FILL_NULLS              */
+/************************************************/
 
-      switch (field_type) {
-      case CHAR_TYPE: {
-        CSV_CHAR_BLOCK *block = csv_list->field_list[j]->char_block_head;
+int csv_util_fill_nulls(CSV_FIELD_LIST *field_list) {
+  size_t capacity = field_list->capacity;
 
-        for (int k = 0; k < metadata->items; k++) {
-          if (current_row == row) {
-            fprintf(csv_stream, "%s%s", block->data,
-                    (j != metadata->fields - 1) ? "," : "");
-            break;
-          }
-          current_row += 1;
+  field_list->null_data =
+      csv_alloc_resize(field_list->allocator, NULL, 0, capacity);
 
-          block = block->next_block;
-        }
-        break;
-      }
-      case INT_TYPE: {
-        CSV_INT_BLOCK *block = csv_list->field_list[j]->int_block_head;
+  if (field_list->null_data == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
 
-        for (int k = 0; k < metadata->items; k++) {
-          if (current_row == row) {
-            fprintf(csv_stream, "%d%s", block->data,
-                    (j != metadata->fields - 1) ? "," : "");
-            break;
-          }
-          current_row += 1;
+  memset(field_list->null_data, 1, field_list->rows);
+  memset(field_list->null_data + field_list->rows, 0,
+         capacity - field_list->rows);
 
-          block = block->next_block;
-        }
-        break;
+  /* -- Same placeholders csv_util_add_null() keeps */
+  if (field_list->field_type == CHAR_TYPE) {
+    for (size_t row = 0; row < field_list->rows; row++) {
+      if (csv_util_set_string(field_list, row, "", 0) != 0) {
+        return -1;
       }
-      case DOUBLE_TYPE: {
-        CSV_DOUBLE_BLOCK *block = csv_list->field_list[j]->double_block_head;
+    }
+  } else {
+    memset(field_list->int_data, 0, field_list->rows * 8);
+  }
 
-        for (int k = 0; k < metadata->items; k++) {
-          if (current_row == row) {
-            fprintf(csv_stream, "%.2lf%s", block->data,
-                    (j != metadata->fields - 1) ? "," : "");
-            break;
-          }
-          current_row += 1;
+  return 0;
+}
 
-          block = block->next_block;
-        }
-        break;
-      }
-      }
-    }
+/************************************************/
+/*             CSV_UTIL_IS_NULL                 */
+/************************************************/
 
-    row += 1;
-    fprintf(csv_stream, "\n");
+bool csv_util_is_null(const CSV_FIELD_LIST *field_list, size_t row) {
+  /* -- A column without a null map is either all nulls or has none */
+  if (field_list->null_data == NULL) {
+    return field_list->nulls > 0;
   }
+
+  return field_list->null_data[row];
 }
 
 /************************************************/
-/*             CSV_IMPORT                       */
+/*             CSV_UTIL_PROMOTE                 */
 /************************************************/
 
-CSV_LIST *csv_import(char *csv_file, CSV_METADATA **metadata) {
-  FILE *csv_stream = fopen(csv_file, "r");
-
-  if (csv_stream == NULL) {
-    return NULL;
+int csv_util_promote(CSV_FIELD_LIST *field_list, CSV_FIELD_TYPE field_type) {
+  if (field_list->field_type == field_type) {
+    return 0;
   }
 
-  bool fields_extracted = false;
+  CSV_ALLOCATOR *allocator = field_list->allocator;
+  size_t capacity = field_list->capacity;
 
-  int total_fields = 0;
-  int total_items = 0;
+  /* -- Empty column or only nulls without storage, just switch storage */
+  if (field_list->rows == 0 || capacity == 0) {
+    csv_util_dictionary_free(field_list);
+    csv_alloc_release(allocator, field_list->int_data, capacity * 8);
+    csv_alloc_release(allocator, field_list->char_offset,
+                      capacity * sizeof(size_t));
+    csv_alloc_release(allocator, field_list->char_length,
+                      capacity * sizeof(uint32_t));
 
-  /* -- Prepare for metadata extraction */
-  if (metadata == NULL) {
-    return NULL;
-  }
+    field_list->int_data = NULL;
+    field_list->char_offset = NULL;
+    field_list->char_length = NULL;
+    field_list->capacity = 0;
 
-  CSV_LIST *csv_list = calloc(1, sizeof(CSV_LIST));
-  *metadata = calloc(1, sizeof(CSV_METADATA));
+    csv_alloc_release(allocator, field_list->null_data, capacity);
+    field_list->null_data = NULL;
 
-  char csv_buffer[CSV_BUFFER_SIZE];
-  memset(csv_buffer, 0, CSV_BUFFER_SIZE);
+    field_list->field_type = field_type;
 
-  while (fgets(csv_buffer, CSV_BUFFER_SIZE, csv_stream) != NULL) {
-    /* -- Check for correct number of fields */
-    if (fields_extracted == true &&
-        (util_total_fields(csv_buffer) != (*metadata)->fields)) {
-      continue;
+    return 0;
+  }
+
+  bool only_nulls = field_list->nulls == field_list->rows;
+
+  /* -- INT_TYPE widens to DOUBLE_TYPE in place */
+  if (field_list->field_type == INT_TYPE && field_type == DOUBLE_TYPE) {
+    for (size_t i = 0; i < field_list->rows; i++) {
+      field_list->double_data[i] = (double)field_list->int_data[i];
     }
 
-    /* -- First extract all fields */
-    char *token = strtok(csv_buffer, CSV_DELIMETER);
+    field_list->field_type = DOUBLE_TYPE;
 
-    unsigned field = 0;
+    return 0;
+  }
 
-    while (token != NULL) {
-      token = util_trim_string(token);
+  /* -- A column of empty cells may take any type, placeholders are zero */
+  if (field_type != CHAR_TYPE && only_nulls) {
+    int64_t *int_data = csv_alloc_resize(allocator, NULL, 0, capacity * 8);
 
-      /* -- Extract fields */
-      if (fields_extracted == false) {
-        csv_list->field_list[field] = calloc(1, sizeof(CSV_FIELD_LIST));
-        csv_list->field_list[field]->field = token;
+    if (int_data == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
 
-        token = strtok(NULL, CSV_DELIMETER);
-        field += 1;
-        total_fields += 1;
+    memset(int_data, 0, capacity * 8);
 
-        continue;
-      }
+    csv_util_dictionary_free(field_list);
+    csv_alloc_release(allocator, field_list->int_data, capacity * 8);
+    csv_alloc_release(allocator, field_list->char_offset,
+                      capacity * sizeof(size_t));
+    csv_alloc_release(allocator, field_list->char_length,
+                      capacity * sizeof(uint32_t));
 
-      int int_type = 0;
-      double double_type = 0;
+    field_list->int_data = int_data;
+    field_list->char_offset = NULL;
+    field_list->char_length = NULL;
+    field_list->field_type = field_type;
 
-      /* -- Extract double data */
-      if (util_string_to_double(token, &double_type) == 0) {
-        csv_list->field_list[field]->field_type = DOUBLE_TYPE;
-        csv_util_add_node(csv_list, field, &double_type, DOUBLE_TYPE);
-      }
-      /* -- Extract integer data */
-      else if (util_string_to_number(token, &int_type) == 0) {
-        csv_list->field_list[field]->field_type = INT_TYPE;
-        csv_util_add_node(csv_list, field, &int_type, INT_TYPE);
-      }
-      /* -- Extract string data */
-      else {
-        csv_list->field_list[field]->field_type = CHAR_TYPE;
-        csv_util_add_node(csv_list, field, token, CHAR_TYPE);
-      }
+    return 0;
+  }
+
+  if (field_type != CHAR_TYPE) {
+    return -1;
+  }
 
-      field += 1;
+  /* -- Numbers are rendered into the string pool */
+  int64_t *int_data = field_list->int_data;
+  CSV_FIELD_TYPE number_type = field_list->field_type;
 
-      token = strtok(NULL, CSV_DELIMETER);
+  if (field_list->dictionary_mode != CSV_DICTIONARY_OFF) {
+    if (csv_util_dictionary_create(field_list) != 0) {
+      return -1;
     }
+  } else {
+    field_list->char_offset =
+        csv_alloc_resize(allocator, NULL, 0, capacity * sizeof(size_t));
+    field_list->char_length =
+        csv_alloc_resize(allocator, NULL, 0, capacity * sizeof(uint32_t));
 
-    total_items += 1;
+    if (field_list->char_offset == NULL || field_list->char_length == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      csv_alloc_release(allocator, field_list->char_offset,
+                        capacity * sizeof(size_t));
+      csv_alloc_release(allocator, field_list->char_length,
+                        capacity * sizeof(uint32_t));
+      field_list->char_offset = NULL;
+      field_list->char_length = NULL;
+      return -1;
+    }
+  }
 
-    fields_extracted = true;
+  field_list->int_data = NULL;
+  field_list->field_type = CHAR_TYPE;
 
-    (*metadata)->fields = total_fields;
-  }
+  char buffer[32];
 
-  (*metadata)->items = total_items - 1;
+  for (size_t i = 0; i < field_list->rows; i++) {
+    int length = 0;
 
-  fclose(csv_stream);
+    if (field_list->null_data != NULL && field_list->null_data[i]) {
+      length = 0;
+    } else if (number_type == INT_TYPE) {
+      length = util_number_to_string(int_data[i], buffer);
+    } else {
+      length = util_double_to_string(((double *)int_data)[i], buffer,
+                                     sizeof(buffer));
+    }
 
-  return csv_list;
+    csv_util_set_string(field_list, i, buffer, length);
+  }
+
+  csv_alloc_release(allocator, int_data, capacity * 8);
+
+  return 0;
 }
 
 /************************************************/
-/*             CSV_EXPORT                       */
+/*             CSV_UTIL_SET_STRING              */
 /************************************************/
 
-void csv_export(CSV_LIST *csv_list, CSV_METADATA *metadata, char *output) {
-  if (csv_list == NULL || metadata == NULL) {
-    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
-    return;
-  }
+int csv_util_set_string(CSV_FIELD_LIST *field_list, size_t row,
+                        const char *string, size_t length) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
 
-  FILE *csv_stream;
+  if (dictionary == NULL) {
+    size_t offset =
+        csv_util_pool_store(field_list->string_pool, string, length);
 
-  /* -- Get CSV file name */
-  csv_stream = fopen(output, "w");
+    if (offset == SIZE_MAX) {
+      return -1;
+    }
 
-  /* -- Save data to a file */
-  csv_util_show(csv_list, csv_stream, metadata);
+    field_list->char_offset[row] = offset;
+    field_list->char_length[row] = length;
 
-  fclose(csv_stream);
-}
+    return 0;
+  }
 
-/************************************************/
-/*             CSV_FIELD                       */
-/************************************************/
+  uint32_t code = csv_util_dictionary_intern(field_list, string, length);
 
-void *csv_field(char *field, CSV_LIST *csv_list, CSV_METADATA *metadata) {
-  if (csv_list == NULL || metadata == NULL) {
-    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
-    return NULL;
+  if (code == CSV_NO_CODE) {
+    return -1;
   }
 
-  for (int i = 0; i < metadata->fields; i++) {
-    if (strcmp(field, csv_list->field_list[i]->field) == 0) {
-      CSV_FIELD_TYPE field_type = csv_list->field_list[i]->field_type;
+  csv_util_dictionary_set(dictionary, row, code);
 
-      switch (field_type) {
-      case CHAR_TYPE: {
-        return csv_list->field_list[i]->char_block_head;
-      }
-      case INT_TYPE: {
-        return csv_list->field_list[i]->int_block_head;
-      }
-      case DOUBLE_TYPE: {
-        return csv_list->field_list[i]->double_block_head;
-      }
-      }
+  /* -- Too many distinct values to pay off, go back to plain offsets */
+  if (field_list->dictionary_mode == CSV_DICTIONARY_AUTO &&
+      code + 1 == dictionary->values &&
+      (dictionary->values > CSV_DICTIONARY_LIMIT ||
+       (row + 1 >= CSV_DICTIONARY_SAMPLE &&
+        (size_t)dictionary->values * 2 > row + 1))) {
+    size_t offset = dictionary->value_offset[code];
+
+    if (csv_util_dictionary_decode(field_list) != 0) {
+      return -1;
     }
+
+    /* -- The row may be past the rows decoded so far */
+    field_list->char_offset[row] = offset;
+    field_list->char_length[row] = length;
   }
 
-  return NULL;
+  return 0;
 }
 
 /************************************************/
-/*             CSV_COLUMN                       */
+/*             CSV_UTIL_CHAR                    */
 /************************************************/
 
-void *csv_column(unsigned int column, CSV_LIST *csv_list,
-                 CSV_METADATA *metadata) {
-  if (csv_list == NULL || metadata == NULL) {
-    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
-    return NULL;
+char *csv_util_char(CSV_FIELD_LIST *field_list, size_t row, size_t *length) {
+  size_t offset = 0;
+
+  /* -- Only nulls so far, nothing is stored */
+  if (field_list->capacity == 0) {
+    *length = 0;
+    return "";
   }
 
-  for (int i = 0; i < metadata->fields; i++) {
-    if (i == column) {
-      CSV_FIELD_TYPE field_type = csv_list->field_list[i]->field_type;
+  if (field_list->dictionary != NULL) {
+    CSV_DICTIONARY *dictionary = field_list->dictionary;
+    uint32_t code = csv_util_dictionary_code(dictionary, row);
 
-      switch (field_type) {
-      case CHAR_TYPE: {
-        return csv_list->field_list[i]->char_block_head;
-      }
-      case INT_TYPE: {
-        return csv_list->field_list[i]->int_block_head;
-      }
-      case DOUBLE_TYPE: {
-        return csv_list->field_list[i]->double_block_head;
-      }
-      }
-    }
+    offset = dictionary->value_offset[code];
+    *length = dictionary->value_length[code];
+  } else {
+    offset = field_list->char_offset[row];
+    *length = field_list->char_length[row];
   }
 
-  return NULL;
+  return csv_util_string(field_list->string_pool, offset);
 }
 
 /************************************************/
-/*             CSV_ADD_ROW                      */
+/*             CSV_UTIL_ADD_CELL                */
 /************************************************/
 
-void csv_add_row(char *data, CSV_LIST *csv_list, CSV_METADATA *metadata) {
-  if (csv_list == NULL || metadata == NULL) {
-    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
-    return;
+void csv_util_add_cell(CSV_LIST *csv_list, unsigned field, void *data,
+                       size_t length, CSV_FIELD_TYPE csv_field_type) {
+  CSV_FIELD_LIST *field_list = csv_list->field_list[field];
+
+  /* -- Column type only ever widens: INT -> DOUBLE -> CHAR */
+  if (field_list->rows == field_list->nulls) {
+    csv_util_promote(field_list, csv_field_type);
+  } else if (field_list->field_type == INT_TYPE &&
+             csv_field_type != INT_TYPE) {
+    csv_util_promote(field_list, csv_field_type);
+  } else if (field_list->field_type == DOUBLE_TYPE &&
+             csv_field_type == CHAR_TYPE) {
+    csv_util_promote(field_list, CHAR_TYPE);
   }
 
-  if (util_total_fields(data) != metadata->fields) {
+  if (csv_util_reserve(field_list, field_list->rows + 1) != 0) {
     return;
   }
 
-  char *token = strtok(data, CSV_DELIMETER);
-
-  unsigned field = 0;
-
-  while (token != NULL) {
-    token = util_trim_string(token);
-
-    int int_type = 0;
-    double double_type = 0;
+  size_t row = field_list->rows;
 
-    /* -- Extract double data */
-    if (util_string_to_double(token, &double_type) == 0) {
-      csv_list->field_list[field]->field_type = DOUBLE_TYPE;
-      csv_util_add_node(csv_list, field, &double_type, DOUBLE_TYPE);
-    }
-    /* -- Extract integer data */
-    else if (util_string_to_number(token, &int_type) == 0) {
-      csv_list->field_list[field]->field_type = INT_TYPE;
-      csv_util_add_node(csv_list, field, &int_type, INT_TYPE);
-    }
-    /* -- Extract string data */
-    else {
-      csv_list->field_list[field]->field_type = CHAR_TYPE;
-      csv_util_add_node(csv_list, field, token, CHAR_TYPE);
+  switch (field_list->field_type) {
+  case CHAR_TYPE: {
+    char buffer[32];
+    char *string = data;
+
+    if (csv_field_type == INT_TYPE) {
+      length = util_number_to_string(*(int64_t *)data, buffer);
+      string = buffer;
+    } else if (csv_field_type == DOUBLE_TYPE) {
+      length = util_double_to_string(*(double *)data, buffer, sizeof(buffer));
+      string = buffer;
     }
 
-    field += 1;
+    if (csv_util_set_string(field_list, row, string, length) != 0) {
+      return;
+    }
 
-    token = strtok(NULL, CSV_DELIMETER);
+    break;
+  }
+  case INT_TYPE: {
+    field_list->int_data[row] = *(int64_t *)data;
+    break;
+  }
+  case DOUBLE_TYPE: {
+    field_list->double_data[row] = csv_field_type == INT_TYPE
+                                       ? (double)*(int64_t *)data
+                                       : *(double *)data;
+    break;
+  }
   }
 
-  metadata->items += 1;
+  field_list->rows += 1;
 }
 
 /************************************************/
-/*             CSV_REMOVE_ROW                   */
+/*             CSV_UTIL_ADD_NULL                */
 /************************************************/
 
-void csv_remove_row(unsigned int row, CSV_LIST *csv_list,
-                    CSV_METADATA *metadata) {
-  if (csv_list == NULL || metadata == NULL) {
-    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+void csv_util_add_null(CSV_LIST *csv_list, unsigned field) {
+  CSV_FIELD_LIST *field_list = csv_list->field_list[field];
+
+  /* -- Storage waits for the first value, wide files have many empty
+   * columns */
+  if (field_list->capacity == 0) {
+    field_list->nulls += 1;
+    field_list->rows += 1;
     return;
   }
 
-  for (int i = 0; i < metadata->fields; i++) {
-    unsigned current_row = 0;
+  if (csv_util_reserve(field_list, field_list->rows + 1) != 0) {
+    return;
+  }
 
-    CSV_FIELD_TYPE field_type = csv_list->field_list[i]->field_type;
+  if (field_list->null_data == NULL) {
+    field_list->null_data =
+        csv_alloc_resize(field_list->allocator, NULL, 0, field_list->capacity);
 
-    switch (field_type) {
-    case CHAR_TYPE: {
-      CSV_CHAR_BLOCK *block = csv_list->field_list[i]->char_block_head;
-      CSV_CHAR_BLOCK *previous_block = block;
+    if (field_list->null_data == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return;
+    }
 
-      /* -- Remove first row */
-      if (row == 0) {
-        csv_list->field_list[i]->char_block_head = block->next_block;
+    memset(field_list->null_data, 0, field_list->capacity);
+  }
 
-        free(block->data);
-        free(block);
-        continue;
-      }
+  size_t row = field_list->rows;
 
-      while (block != NULL) {
-        if (current_row == row) {
-          previous_block->next_block = block->next_block;
+  /* -- Keep a zero or empty string placeholder in the column */
+  if (field_list->field_type == CHAR_TYPE) {
+    if (csv_util_set_string(field_list, row, "", 0) != 0) {
+      return;
+    }
+  } else {
+    field_list->int_data[row] = 0;
+  }
 
-          block->next_block = NULL;
-          free(block->data);
-          free(block);
+  field_list->null_data[row] = 1;
+  field_list->nulls += 1;
+  field_list->rows += 1;
+}
 
-          break;
-        }
+/************************************************/
+/*             CSV_UTIL_TOMBSTONE               */
+/************************************************/
 
-        previous_block = block;
-        block = block->next_block;
+int csv_util_tombstone(CSV_TOMBSTONES *tombstones, size_t row) {
+  size_t word = row / 64;
 
-        current_row += 1;
-      }
+  if (word >= tombstones->words) {
+    size_t words = tombstones->words ? tombstones->words : 16;
 
-      break;
+    while (words <= word) {
+      words *= 2;
     }
 
-    case INT_TYPE: {
-      CSV_INT_BLOCK *block = csv_list->field_list[i]->int_block_head;
-      CSV_INT_BLOCK *previous_block = block;
+    uint64_t *bits =
+        csv_alloc_resize(tombstones->allocator, tombstones->bits,
+                         tombstones->words * sizeof(uint64_t),
+                         words * sizeof(uint64_t));
 
-      /* -- Remove first row */
-      if (row == 0) {
-        csv_list->field_list[i]->int_block_head = block->next_block;
+    if (bits == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
 
-        free(block);
-        continue;
-      }
+    memset(bits + tombstones->words, 0,
+           (words - tombstones->words) * sizeof(uint64_t));
 
-      while (block != NULL) {
-        if (current_row == row) {
-          previous_block->next_block = block->next_block;
+    tombstones->bits = bits;
+    tombstones->words = words;
+  }
 
-          block->next_block = NULL;
-          free(block);
+  uint64_t bit = 1ULL << (row % 64);
 
-          break;
-        }
+  if (!(tombstones->bits[word] & bit)) {
+    tombstones->bits[word] |= bit;
+    tombstones->dead += 1;
+  }
 
-        previous_block = block;
-        block = block->next_block;
+  return 0;
+}
 
-        current_row += 1;
-      }
+/************************************************/
+/*             CSV_UTIL_ROW_DEAD                */
+/************************************************/
 
-      break;
-    }
+bool csv_util_row_dead(const CSV_TOMBSTONES *tombstones, size_t row) {
+  if (tombstones->dead == 0 || row / 64 >= tombstones->words) {
+    return false;
+  }
 
-    case DOUBLE_TYPE: {
-      CSV_DOUBLE_BLOCK *block = csv_list->field_list[i]->double_block_head;
-      CSV_DOUBLE_BLOCK *previous_block = block;
+  return (tombstones->bits[row / 64] >> (row % 64)) & 1;
+}
 
-      /* -- Remove first row */
-      if (row == 0) {
-        csv_list->field_list[i]->double_block_head = block->next_block;
+/************************************************/
+/*             CSV_UTIL_COMPACT_FIELD           */
+/************************************************/
 
-        free(block);
-        continue;
-      }
+void csv_util_compact_field(CSV_FIELD_LIST *field_list) {
+  const CSV_TOMBSTONES *tombstones = field_list->tombstones;
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+  size_t live = 0;
 
-      while (block != NULL) {
-        if (current_row == row) {
-          previous_block->next_block = block->next_block;
+  /* -- Nothing stored, only the count of nulls changes */
+  if (field_list->capacity == 0) {
+    for (size_t row = 0; row < field_list->rows; row++) {
+      live += !csv_util_row_dead(tombstones, row);
+    }
 
-          block->next_block = NULL;
-          free(block);
+    field_list->rows = live;
+    field_list->nulls = live;
 
-          break;
-        }
+    return;
+  }
 
-        previous_block = block;
-        block = block->next_block;
+  /* -- Live rows slide down in order */
+  for (size_t row = 0; row < field_list->rows; row++) {
+    if (csv_util_row_dead(tombstones, row)) {
+      continue;
+    }
 
-        current_row += 1;
+    if (live != row) {
+      if (dictionary != NULL) {
+        csv_util_dictionary_set(dictionary, live,
+                                csv_util_dictionary_code(dictionary, row));
+      } else if (field_list->field_type == CHAR_TYPE) {
+        field_list->char_offset[live] = field_list->char_offset[row];
+        field_list->char_length[live] = field_list->char_length[row];
+      } else {
+        field_list->int_data[live] = field_list->int_data[row];
       }
 
-      break;
-    }
+      if (field_list->null_data != NULL) {
+        field_list->null_data[live] = field_list->null_data[row];
+      }
     }
+
+    live++;
   }
 
-  metadata->items -= 1;
-}
+  if (field_list->null_data != NULL) {
+    memset(field_list->null_data + live, 0, field_list->rows - live);
+
+    field_list->nulls = 0;
+
+    for (size_t row = 0; row < live; row++) {
+      field_list->nulls += field_list->null_data[row];
+    }
+  }
+
+  field_list->rows = live;
+}
 
 /************************************************/
-/*             CSV_SHOW                         */
+/*             CSV_UTIL_PERMUTE_FIELD           */
 /************************************************/
 
-/* TODO: Refactor code */
-void csv_show(CSV_LIST *csv_list, CSV_METADATA *metadata) {
-  /* -- Print data to terminal */
-  csv_util_show(csv_list, stdout, metadata);
+void csv_util_permute_field(CSV_FIELD_LIST *field_list, const size_t *order,
+                            size_t total_rows, uint64_t *scratch) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+
+  /* -- Nothing stored, only the count of nulls changes */
+  if (field_list->capacity == 0) {
+    field_list->rows = total_rows;
+    field_list->nulls = total_rows;
+
+    return;
+  }
+
+  /* -- Rows are gathered into scratch, then copied back over the column */
+  if (dictionary != NULL) {
+    for (size_t i = 0; i < total_rows; i++) {
+      scratch[i] = csv_util_dictionary_code(dictionary, order[i]);
+    }
+
+    for (size_t i = 0; i < total_rows; i++) {
+      csv_util_dictionary_set(dictionary, i, (uint32_t)scratch[i]);
+    }
+  } else if (field_list->field_type == CHAR_TYPE) {
+    for (size_t i = 0; i < total_rows; i++) {
+      scratch[i] = field_list->char_offset[order[i]];
+    }
+
+    for (size_t i = 0; i < total_rows; i++) {
+      field_list->char_offset[i] = scratch[i];
+    }
+
+    for (size_t i = 0; i < total_rows; i++) {
+      scratch[i] = field_list->char_length[order[i]];
+    }
+
+    for (size_t i = 0; i < total_rows; i++) {
+      field_list->char_length[i] = (uint32_t)scratch[i];
+    }
+  } else {
+    for (size_t i = 0; i < total_rows; i++) {
+      scratch[i] = (uint64_t)field_list->int_data[order[i]];
+    }
+
+    memcpy(field_list->int_data, scratch, total_rows * sizeof(uint64_t));
+  }
+
+  if (field_list->null_data != NULL) {
+    uint8_t *null_data = (uint8_t *)scratch;
+
+    for (size_t i = 0; i < total_rows; i++) {
+      null_data[i] = field_list->null_data[order[i]];
+    }
+
+    memcpy(field_list->null_data, null_data, total_rows);
+    memset(field_list->null_data + total_rows, 0,
+           field_list->rows > total_rows ? field_list->rows - total_rows : 0);
+
+    field_list->nulls = 0;
+
+    for (size_t row = 0; row < total_rows; row++) {
+      field_list->nulls += field_list->null_data[row];
+    }
+  }
+
+  field_list->rows = total_rows;
 }
 
 /************************************************/
-/*             CSV_CLEAR                        */
+/*             CSV_UTIL_FILL_CELL               */
 /************************************************/
 
-void csv_clear(CSV_LIST *csv_list, CSV_METADATA *metadata) {
-  if (csv_list == NULL || metadata == NULL) {
-    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+void csv_util_fill_cell(CSV_FIELD_LIST *field_list, size_t row,
+                        CSV_CELL *cell) {
+  cell->field_type = field_list->field_type;
+  cell->is_null = csv_util_is_null(field_list, row);
+
+  cell->char_data = NULL;
+  cell->char_length = 0;
+  cell->int_data = 0;
+  cell->double_data = 0;
+
+  if (field_list->capacity == 0) {
+    cell->char_data = "";
     return;
   }
 
-  for (int i = 0; i < metadata->fields; i++) {
-    CSV_FIELD_TYPE field_type = csv_list->field_list[i]->field_type;
+  switch (field_list->field_type) {
+  case CHAR_TYPE: {
+    cell->char_data = csv_util_char(field_list, row, &cell->char_length);
+    break;
+  }
+  case INT_TYPE: {
+    cell->int_data = field_list->int_data[row];
+    break;
+  }
+  case DOUBLE_TYPE: {
+    cell->double_data = field_list->double_data[row];
+    break;
+  }
+  }
+}
 
-    switch (field_type) {
-    case CHAR_TYPE: {
-      CSV_CHAR_BLOCK *next_block = csv_list->field_list[i]->char_block_head;
-      CSV_CHAR_BLOCK *current_block = next_block;
+/************************************************/
+/*             CSV_UTIL_CONVERT                 */
+/************************************************/
+
+void csv_util_convert(const char *token, size_t length, unsigned flags,
+                      CSV_CELL *cell) {
+  /* -- Spaces inside quotes are data */
+  if (!(flags & CSV_SPAN_QUOTED)) {
+    token = util_trim_span(token, &length);
+  }
+
+  cell->char_data = (char *)token;
+  cell->char_length = length;
+
+  /* -- An unquoted empty field is a null, "" is an empty string */
+  cell->is_null = length == 0 && !(flags & CSV_SPAN_QUOTED);
+
+  /* -- Extract integer data */
+  if (util_string_to_number(token, length, &cell->int_data) == 0) {
+    cell->field_type = INT_TYPE;
+  }
+  /* -- Extract double data, guessed doubles need a decimal point */
+  else if (util_string_to_double(token, length, &cell->double_data) == 0 &&
+           memchr(token, '.', length) != NULL) {
+    cell->field_type = DOUBLE_TYPE;
+  }
+  /* -- Extract string data */
+  else {
+    cell->field_type = CHAR_TYPE;
+  }
+}
+
+/************************************************/
+/*             CSV_UTIL_CONVERT_INT             */
+/************************************************/
+
+int csv_util_convert_int(const char *token, size_t length, int64_t *data) {
+  return util_string_to_number(token, length, data);
+}
+
+/************************************************/
+/*             CSV_UTIL_CONVERT_DOUBLE          */
+/************************************************/
+
+/* -- Integers and exponents are fine once the column holds doubles */
+int csv_util_convert_double(const char *token, size_t length, double *data) {
+  return util_string_to_double(token, length, data);
+}
+
+/************************************************/
+/*             CSV_UTIL_PARSE_CELL              */
+/************************************************/
 
-      for (int j = 0; j < metadata->items; j++) {
-        next_block = current_block->next_block;
+void csv_util_parse_cell(CSV_LIST *csv_list, unsigned field,
+                         const char *token, size_t length, unsigned flags) {
+  CSV_FIELD_LIST *field_list = csv_list->field_list[field];
 
-        free(current_block->data);
-        free(current_block);
+  /* -- Settled columns call exactly one converter */
+  if (field_list->type_source != CSV_TYPE_GUESSED) {
+    if (!(flags & CSV_SPAN_QUOTED)) {
+      token = util_trim_span(token, &length);
 
-        current_block = next_block;
+      if (length == 0) {
+        csv_util_add_null(csv_list, field);
+        return;
       }
+    }
+
+    switch (field_list->field_type) {
+    case CHAR_TYPE: {
+      csv_util_add_cell(csv_list, field, (char *)token, length, CHAR_TYPE);
+      return;
+    }
+    case INT_TYPE: {
+      int64_t data = 0;
 
-      csv_list->field_list[i]->char_block_head = NULL;
+      if (csv_util_convert_int(token, length, &data) == 0) {
+        csv_util_add_cell(csv_list, field, &data, 0, INT_TYPE);
+        return;
+      }
 
       break;
     }
-    case INT_TYPE: {
-      CSV_INT_BLOCK *next_block = csv_list->field_list[i]->int_block_head;
-      CSV_INT_BLOCK *current_block = next_block;
+    case DOUBLE_TYPE: {
+      double data = 0;
+
+      if (csv_util_convert_double(token, length, &data) == 0) {
+        csv_util_add_cell(csv_list, field, &data, 0, DOUBLE_TYPE);
+        return;
+      }
+
+      break;
+    }
+    }
+
+    /* -- Declared types are kept, the cell is dropped */
+    if (field_list->type_source == CSV_TYPE_DECLARED) {
+      csv_util_add_null(csv_list, field);
+      return;
+    }
+  }
+
+  CSV_CELL cell;
+
+  csv_util_convert(token, length, flags, &cell);
+
+  if (cell.is_null) {
+    csv_util_add_null(csv_list, field);
+    return;
+  }
+
+  /* -- Numbers keep their text once the column holds strings */
+  if (field_list->field_type == CHAR_TYPE &&
+      field_list->rows > field_list->nulls) {
+    cell.field_type = CHAR_TYPE;
+  }
+
+  switch (cell.field_type) {
+  case CHAR_TYPE: {
+    csv_util_add_cell(csv_list, field, cell.char_data, cell.char_length,
+                      CHAR_TYPE);
+    break;
+  }
+  case INT_TYPE: {
+    csv_util_add_cell(csv_list, field, &cell.int_data, 0, INT_TYPE);
+    break;
+  }
+  case DOUBLE_TYPE: {
+    csv_util_add_cell(csv_list, field, &cell.double_data, 0, DOUBLE_TYPE);
+    break;
+  }
+  }
+}
+
+/************************************************/
+/*             CSV_UTIL_FIELD_NAME              */
+/************************************************/
+
+char *csv_util_field_name(const char *data, CSV_SPAN *span) {
+  size_t length = span->length;
+  const char *name = data + span->begin;
+
+  if (!(span->flags & CSV_SPAN_QUOTED)) {
+    name = util_trim_span(name, &length);
+  }
+
+  char *field = calloc(1, length + 1);
+
+  if (field == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return NULL;
+  }
 
-      for (int j = 0; j < metadata->items; j++) {
-        next_block = current_block->next_block;
+  if (span->flags & CSV_SPAN_ESCAPED) {
+    length = csv_parse_unescape(name, length, field);
+    field[length] = '\0';
+  } else {
+    memcpy(field, name, length);
+  }
+
+  return field;
+}
+
+/************************************************/
+/*             CSV_UTIL_FIELD_SLOT              */
+/************************************************/
+
+static uint32_t *csv_util_field_slot(CSV_LIST *csv_list, const char *field,
+                                     uint64_t hash) {
+  uint32_t mask = csv_list->field_slot_count - 1;
+
+  for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    uint32_t entry = csv_list->field_slots[slot];
+
+    if (entry == 0 ||
+        strcmp(csv_list->field_list[entry - 1]->field, field) == 0) {
+      return &csv_list->field_slots[slot];
+    }
+  }
+}
+
+/************************************************/
+/*             CSV_UTIL_FIELD_REHASH            */
+/************************************************/
+
+static int csv_util_field_rehash(CSV_LIST *csv_list, unsigned fields) {
+  CSV_ALLOCATOR *allocator = &csv_list->arena.allocator;
+
+  uint32_t slot_count =
+      csv_list->field_slot_count ? csv_list->field_slot_count * 2 : 32;
+  uint32_t *slots =
+      csv_alloc_resize(allocator, NULL, 0, slot_count * sizeof(uint32_t));
+
+  if (slots == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
+
+  memset(slots, 0, slot_count * sizeof(uint32_t));
+
+  csv_alloc_release(allocator, csv_list->field_slots,
+                    csv_list->field_slot_count * sizeof(uint32_t));
+
+  csv_list->field_slots = slots;
+  csv_list->field_slot_count = slot_count;
+
+  /* -- Duplicate names keep pointing at their first column */
+  for (unsigned i = 0; i < fields; i++) {
+    const char *field = csv_list->field_list[i]->field;
+    uint32_t *slot = csv_util_field_slot(csv_list, field,
+                                         util_hash(field, strlen(field)));
+
+    if (*slot == 0) {
+      *slot = i + 1;
+    }
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_FIELD_FIND              */
+/************************************************/
+
+int csv_util_field_find(CSV_LIST *csv_list, const char *field) {
+  if (csv_list->field_slot_count == 0) {
+    return -1;
+  }
+
+  uint32_t entry = *csv_util_field_slot(csv_list, field,
+                                        util_hash(field, strlen(field)));
+
+  return (int)entry - 1;
+}
+
+/************************************************/
+/*             CSV_UTIL_RESERVE_FIELDS          */
+/************************************************/
+
+int csv_util_reserve_fields(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                            unsigned fields) {
+  if (fields > csv_list->field_capacity) {
+    unsigned field_capacity = csv_list->field_capacity
+                                  ? csv_list->field_capacity * 2
+                                  : CSV_INITIAL_FIELDS;
+
+    if (field_capacity < fields) {
+      field_capacity = fields;
+    }
+
+    CSV_FIELD_LIST **field_list = csv_alloc_resize(
+        &csv_list->arena.allocator, csv_list->field_list,
+        csv_list->field_capacity * sizeof(CSV_FIELD_LIST *),
+        field_capacity * sizeof(CSV_FIELD_LIST *));
+
+    if (field_list == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
+
+    csv_list->field_list = field_list;
+    csv_list->field_capacity = field_capacity;
+  }
+
+  /* -- The descriptors of a header sit side by side in one block */
+  if (csv_list->field_spares == 0 && fields > metadata->fields + 1) {
+    unsigned spares = fields - metadata->fields;
+
+    csv_list->field_spare =
+        csv_arena_alloc(&csv_list->arena, spares * sizeof(CSV_FIELD_LIST));
+
+    if (csv_list->field_spare == NULL) {
+      return -1;
+    }
+
+    csv_list->field_spares = spares;
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_ADD_FIELD               */
+/************************************************/
+
+int csv_util_add_field(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                       const char *field) {
+  if (csv_util_reserve_fields(csv_list, metadata, metadata->fields + 1) != 0) {
+    return -1;
+  }
+
+  /* -- Descriptors and names die with the list, keep them in its arena */
+  CSV_FIELD_LIST *field_list = NULL;
+
+  if (csv_list->field_spares > 0) {
+    field_list = csv_list->field_spare++;
+    csv_list->field_spares -= 1;
+  } else {
+    field_list = csv_arena_alloc(&csv_list->arena, sizeof(CSV_FIELD_LIST));
+  }
 
-        free(current_block);
+  if (field_list == NULL) {
+    return -1;
+  }
+
+  field_list->field = csv_arena_string(&csv_list->arena, field);
+
+  if (field_list->field == NULL) {
+    return -1;
+  }
+
+  field_list->string_pool = &csv_list->string_pool;
+  field_list->tombstones = &csv_list->tombstones;
+  field_list->allocator = &csv_list->arena.allocator;
+  field_list->dictionary_mode = csv_list->dictionary_mode;
+
+  /* -- Keep the name index at most half full */
+  if ((metadata->fields + 1) * 2 > csv_list->field_slot_count &&
+      csv_util_field_rehash(csv_list, metadata->fields) != 0) {
+    return -1;
+  }
+
+  unsigned index = metadata->fields;
+  uint32_t *slot = csv_util_field_slot(csv_list, field_list->field,
+                                       util_hash(field, strlen(field)));
+
+  csv_list->field_list[index] = field_list;
+  metadata->fields += 1;
+
+  if (*slot == 0) {
+    *slot = index + 1;
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_ADD_FIELDS              */
+/************************************************/
 
-        current_block = next_block;
+int csv_util_add_fields(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                        char **names, unsigned total_fields) {
+  /* -- Predicates may test fields that are not projected */
+  if (csv_list->predicate != NULL) {
+    csv_list->filter = csv_util_filter_compile(csv_list, csv_list->predicate,
+                                               names, total_fields);
+    csv_list->predicate = NULL;
+
+    if (csv_list->filter == NULL) {
+      return -1;
+    }
+  }
+
+  CSV_PROJECTION *projection = csv_list->columns;
+
+  if (projection == NULL) {
+    if (csv_util_reserve_fields(csv_list, metadata,
+                                metadata->fields + total_fields) != 0) {
+      return -1;
+    }
+
+    for (unsigned field = 0; field < total_fields; field++) {
+      if (csv_util_add_field(csv_list, metadata, names[field]) != 0) {
+        return -1;
       }
+    }
 
-      csv_list->field_list[i]->int_block_head = NULL;
+    return 0;
+  }
 
-      break;
+  /* -- Only the first header is projected */
+  csv_list->columns = NULL;
+
+  unsigned *source_column =
+      csv_arena_alloc(&csv_list->arena, total_fields * sizeof(unsigned));
+
+  if (source_column == NULL ||
+      csv_util_reserve_fields(csv_list, metadata,
+                              metadata->fields + projection->fields) != 0) {
+    return -1;
+  }
+
+  /* -- Open addressing table of source field + 1, names resolve in O(1) */
+  uint32_t *slots = NULL;
+  uint32_t slot_count = CSV_INITIAL_FIELDS;
+
+  if (projection->field != NULL) {
+    while (slot_count < total_fields * 2) {
+      slot_count *= 2;
     }
-    case DOUBLE_TYPE: {
-      CSV_DOUBLE_BLOCK *next_block = csv_list->field_list[i]->double_block_head;
-      CSV_DOUBLE_BLOCK *current_block = next_block;
 
-      for (int j = 0; j < metadata->items; j++) {
-        next_block = current_block->next_block;
+    slots = calloc(slot_count, sizeof(uint32_t));
 
-        free(current_block);
+    if (slots == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
+
+    for (unsigned field = 0; field < total_fields; field++) {
+      uint32_t slot = util_hash(names[field], strlen(names[field]));
+
+      /* -- Duplicate names keep their first field */
+      while (slots[slot &= slot_count - 1] != 0 &&
+             strcmp(names[slots[slot] - 1], names[field]) != 0) {
+        slot++;
+      }
 
-        current_block = next_block;
+      if (slots[slot] == 0) {
+        slots[slot] = field + 1;
       }
+    }
+  }
 
-      csv_list->field_list[i]->double_block_head = NULL;
+  int status = 0;
 
-      break;
+  for (unsigned i = 0; i < projection->fields; i++) {
+    unsigned source = total_fields;
+
+    if (slots != NULL) {
+      const char *name = projection->field[i];
+      uint32_t slot = util_hash(name, strlen(name));
+
+      while (slots[slot &= slot_count - 1] != 0) {
+        if (strcmp(names[slots[slot] - 1], name) == 0) {
+          source = slots[slot] - 1;
+          break;
+        }
+
+        slot++;
+      }
+    } else {
+      source = projection->column[i];
+    }
+
+    if (source >= total_fields) {
+      if (slots != NULL) {
+        fprintf(stderr, "%s: No field %s.\n", __func__, projection->field[i]);
+      } else {
+        fprintf(stderr, "%s: No column %u.\n", __func__,
+                projection->column[i]);
+      }
+
+      continue;
     }
+
+    /* -- A field asked for twice is imported once */
+    if (source_column[source] != 0) {
+      continue;
+    }
+
+    if (csv_util_add_field(csv_list, metadata, names[source]) != 0) {
+      status = -1;
+      break;
     }
 
-    free(csv_list->field_list[i]->field);
-    free(csv_list->field_list[i]);
+    source_column[source] = metadata->fields;
   }
 
-  free(csv_list);
-  free(metadata);
+  free(slots);
+
+  csv_list->projection = source_column;
+  csv_list->source_fields = total_fields;
+
+  return status;
+}
+
+/************************************************/
+/*             CSV_UTIL_ADD_HEADER              */
+/************************************************/
+
+void csv_util_add_header(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                         const char *data, CSV_SPAN *fields,
+                         unsigned total_fields) {
+  char **names = calloc(total_fields ? total_fields : 1, sizeof(char *));
+
+  if (names == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return;
+  }
+
+  unsigned field = 0;
+
+  for (; field < total_fields; field++) {
+    names[field] = csv_util_field_name(data, &fields[field]);
+
+    if (names[field] == NULL) {
+      break;
+    }
+  }
+
+  if (field == total_fields) {
+    csv_util_add_fields(csv_list, metadata, names, total_fields);
+  }
+
+  for (unsigned i = 0; i < field; i++) {
+    free(names[i]);
+  }
+
+  free(names);
+}
+
+/************************************************/
+/*             CSV_UTIL_APPLY_SCHEMA            */
+/************************************************/
+
+void csv_util_apply_schema(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                           CSV_SCHEMA *schema) {
+  if (schema == NULL) {
+    return;
+  }
+
+  for (unsigned i = 0; i < schema->fields; i++) {
+    CSV_FIELD_LIST *field_list = NULL;
+
+    if (schema->field != NULL) {
+      field_list = csv_field((char *)schema->field[i], csv_list, metadata);
+    } else {
+      field_list = csv_column(i, csv_list, metadata);
+    }
+
+    if (field_list == NULL) {
+      continue;
+    }
+
+    if (csv_util_promote(field_list, schema->field_type[i]) != 0) {
+      fprintf(stderr, "%s: Unable to change the type of %s.\n", __func__,
+              field_list->field);
+      continue;
+    }
+
+    field_list->type_source = CSV_TYPE_DECLARED;
+  }
+}
+
+/************************************************/
+/*             CSV_UTIL_INFER_SCHEMA            */
+/************************************************/
+
+void csv_util_infer_schema(CSV_LIST *csv_list, CSV_METADATA *metadata) {
+  for (unsigned i = 0; i < metadata->fields; i++) {
+    CSV_FIELD_LIST *field_list = csv_list->field_list[i];
+
+    /* -- A column of nulls has nothing to go by yet */
+    if (field_list->type_source == CSV_TYPE_GUESSED &&
+        field_list->rows > field_list->nulls) {
+      field_list->type_source = CSV_TYPE_INFERRED;
+    }
+  }
+}
+
+/************************************************/
+/*             CSV_UTIL_RESERVE_SCRATCH         */
+/************************************************/
+
+static int csv_util_reserve_scratch(CSV_LIST *csv_list, size_t length) {
+  if (length <= csv_list->scratch_size) {
+    return 0;
+  }
+
+  char *scratch = csv_alloc_resize(&csv_list->arena.allocator,
+                                   csv_list->scratch, csv_list->scratch_size,
+                                   length);
+
+  if (scratch == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
+
+  csv_list->scratch = scratch;
+  csv_list->scratch_size = length;
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_UNESCAPE                */
+/************************************************/
+
+int csv_util_unescape(CSV_LIST *csv_list, const char **token, size_t *length) {
+  /* -- Doubled quotes are collapsed into the list scratch buffer */
+  if (csv_util_reserve_scratch(csv_list, *length) != 0) {
+    return -1;
+  }
+
+  *length = csv_parse_unescape(*token, *length, csv_list->scratch);
+  *token = csv_list->scratch;
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_ADD_LINE                */
+/************************************************/
+
+int csv_util_add_line(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                      const char *data, CSV_SPAN *fields,
+                      unsigned total_fields) {
+  unsigned *projection = csv_list->projection;
+
+  /* -- Check for correct number of fields */
+  if (total_fields !=
+          (projection ? csv_list->source_fields : metadata->fields) ||
+      total_fields == 0) {
+    return 0;
+  }
+
+  /* -- Room to unescape any field of the row, once it is there no cell of
+   * the row can fail to unescape and leave the row short */
+  size_t escaped = 0;
+
+  for (unsigned field = 0; field < total_fields; field++) {
+    if ((fields[field].flags & CSV_SPAN_ESCAPED) &&
+        fields[field].length > escaped) {
+      escaped = fields[field].length;
+    }
+  }
+
+  if (csv_util_reserve_scratch(csv_list, escaped) != 0) {
+    return -1;
+  }
+
+  if (csv_list->filter != NULL &&
+      !csv_util_filter_row(csv_list, csv_list->filter, data, fields,
+                           total_fields)) {
+    return 0;
+  }
+
+  for (unsigned field = 0; field < total_fields; field++) {
+    unsigned column = field;
+
+    /* -- Fields left out are only delimited, never trimmed or converted */
+    if (projection != NULL) {
+      if (projection[field] == 0) {
+        continue;
+      }
+
+      column = projection[field] - 1;
+    }
+
+    CSV_SPAN *span = &fields[field];
+
+    const char *token = data + span->begin;
+    size_t length = span->length;
+
+    if (span->flags & CSV_SPAN_ESCAPED) {
+      csv_util_unescape(csv_list, &token, &length);
+    }
+
+    csv_util_parse_cell(csv_list, column, token, length, span->flags);
+  }
+
+  metadata->items += 1;
+
+  /* -- The sample is in, settle the column types */
+  if (metadata->items == csv_list->sample_rows) {
+    csv_util_infer_schema(csv_list, metadata);
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_WRITE                   */
+/************************************************/
+
+int csv_util_flush(CSV_WRITER *csv_writer) {
+  if (csv_writer->used == 0) {
+    return 0;
+  }
+
+  size_t written =
+      fwrite(csv_writer->buffer, 1, csv_writer->used, csv_writer->stream);
+
+  if (written != csv_writer->used) {
+    csv_writer->error = true;
+  }
+
+  csv_writer->used = 0;
+
+  return csv_writer->error ? -1 : 0;
+}
+
+void csv_util_write(CSV_WRITER *csv_writer, const char *data, size_t length) {
+  if (csv_writer->used + length > csv_writer->size) {
+    csv_util_flush(csv_writer);
+
+    /* -- Too large for the buffer, hand it straight to the stream */
+    if (length > csv_writer->size) {
+      if (fwrite(data, 1, length, csv_writer->stream) != length) {
+        csv_writer->error = true;
+      }
+
+      return;
+    }
+  }
+
+  memcpy(csv_writer->buffer + csv_writer->used, data, length);
+  csv_writer->used += length;
+}
+
+/************************************************/
+/*             CSV_UTIL_WRITE_STRING            */
+/************************************************/
+
+void csv_util_write_string(CSV_WRITER *csv_writer, const char *data,
+                           size_t length) {
+  bool quote = length == 0 || isspace((unsigned char)data[0]) ||
+               isspace((unsigned char)data[length - 1]);
+
+  for (size_t i = 0; i < length && !quote; i++) {
+    char character = data[i];
+
+    quote = character == CSV_DELIMETER[0] || character == '"' ||
+            character == '\n' || character == '\r';
+  }
+
+  if (!quote) {
+    csv_util_write(csv_writer, data, length);
+    return;
+  }
+
+  /* -- Quote the field and double embedded quotes */
+  csv_util_write(csv_writer, "\"", 1);
+
+  const char *end = data + length;
+
+  while (data < end) {
+    const char *quote_mark = memchr(data, '"', end - data);
+
+    if (quote_mark == NULL) {
+      csv_util_write(csv_writer, data, end - data);
+      break;
+    }
+
+    csv_util_write(csv_writer, data, quote_mark - data + 1);
+    csv_util_write(csv_writer, "\"", 1);
+
+    data = quote_mark + 1;
+  }
+
+  csv_util_write(csv_writer, "\"", 1);
+}
+
+/************************************************/
+/*             CSV_UTIL_SHOW                    */
+/************************************************/
+
+void csv_util_show(CSV_LIST *csv_list, FILE *csv_stream,
+                   CSV_METADATA *metadata, size_t buffer_size,
+                   const size_t *order, size_t total_rows) {
+
+  if (csv_list == NULL || metadata == NULL) {
+    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+    return;
+  }
+
+  /* -- Every cell must fit in the buffer, so keep a sane minimum */
+  if (buffer_size < CSV_BUFFER_SIZE) {
+    buffer_size = CSV_BUFFER_SIZE;
+  }
+
+  CSV_WRITER csv_writer = {0};
+
+  csv_writer.stream = csv_stream;
+  csv_writer.size = buffer_size;
+  csv_writer.buffer = malloc(buffer_size);
+
+  if (csv_writer.buffer == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return;
+  }
+
+  /* -- First print fields */
+  for (int i = 0; i < metadata->fields; i++) {
+    const char *field = csv_list->field_list[i]->field;
+
+    csv_util_write_string(&csv_writer, field, strlen(field));
+    csv_util_write(&csv_writer, (i != metadata->fields - 1) ? "," : "\n", 1);
+  }
+
+  /* -- Row cursor, every column is read front to back exactly once. Room
+   * for "%.2lf" of -DBL_MAX: sign, digits, point, 2 decimals and NUL. */
+  char number[DBL_MAX_10_EXP + 8];
+
+  if (order == NULL) {
+    total_rows = metadata->items;
+  }
+
+  for (size_t i = 0; i < total_rows; i++) {
+    size_t row = order != NULL ? order[i] : i;
+
+    if (row >= metadata->items ||
+        csv_util_row_dead(&csv_list->tombstones, row)) {
+      continue;
+    }
+
+    for (int j = 0; j < metadata->fields; j++) {
+      CSV_FIELD_LIST *field_list = csv_list->field_list[j];
+
+      /* -- Nulls are written as empty fields */
+      if (csv_util_is_null(field_list, row)) {
+        csv_util_write(&csv_writer, (j != metadata->fields - 1) ? "," : "\n",
+                       1);
+        continue;
+      }
+
+      switch (field_list->field_type) {
+      case CHAR_TYPE: {
+        size_t length = 0;
+        char *string = csv_util_char(field_list, row, &length);
+
+        csv_util_write_string(&csv_writer, string, length);
+        break;
+      }
+      case INT_TYPE: {
+        int length = util_number_to_string(field_list->int_data[row], number);
+        csv_util_write(&csv_writer, number, length);
+        break;
+      }
+      case DOUBLE_TYPE: {
+        int length = snprintf(number, sizeof(number), "%.2lf",
+                              field_list->double_data[row]);
+        csv_util_write(&csv_writer, number, length);
+        break;
+      }
+      }
+
+      csv_util_write(&csv_writer, (j != metadata->fields - 1) ? "," : "\n",
+                     1);
+    }
+  }
+
+  csv_util_flush(&csv_writer);
+
+  if (csv_writer.error) {
+    fprintf(stderr, "%s: Failed to write CSV data.\n", __func__);
+  }
+
+  free(csv_writer.buffer);
+}
+
+/************************************************/
+/*             CSV_IMPORT                       */
+/************************************************/
+
+CSV_LIST *csv_import(char *csv_file, CSV_METADATA **metadata) {
+  return csv_import_ex(csv_file, metadata, NULL);
+}
+
+/************************************************/
+/*             CSV_UTIL_PREPARE                 */
+/************************************************/
+
+void csv_util_prepare(CSV_LIST *csv_list, CSV_OPTIONS *options) {
+  csv_list->dictionary_mode = options->dictionary;
+  csv_list->sample_rows =
+      options->sample_rows ? options->sample_rows : CSV_SCHEMA_SAMPLE;
+  csv_list->columns = options->projection;
+  csv_list->predicate = options->predicate;
+
+  if (options->compact_ratio > 0) {
+    csv_list->tombstones.ratio = options->compact_ratio;
+  }
+}
+
+/************************************************/
+/*             CSV_UTIL_END_IMPORT              */
+/************************************************/
+
+void csv_util_end_import(CSV_LIST *csv_list) {
+  csv_list->columns = NULL;
+  csv_list->projection = NULL;
+  csv_list->predicate = NULL;
+  csv_list->filter = NULL;
+}
+
+/************************************************/
+/*             CSV_IMPORT_EX                    */
+/************************************************/
+
+CSV_LIST *csv_import_ex(char *csv_file, CSV_METADATA **metadata,
+                        CSV_OPTIONS *options) {
+  /* -- Prepare for metadata extraction */
+  if (metadata == NULL) {
+    return NULL;
+  }
+
+  CSV_OPTIONS defaults = {0};
+
+  if (options == NULL) {
+    options = &defaults;
+  }
+
+  if (options->follow) {
+    return csv_util_import_follow(csv_file, metadata, options);
+  }
+
+  if (options->snapshot != NULL) {
+    return csv_util_import_cached(csv_file, metadata, options);
+  }
+
+  if (options->threads > 1) {
+    return csv_util_import_parallel(csv_file, metadata, options);
+  }
+
+  if (options->mmap) {
+    return csv_util_import_mmap(csv_file, metadata, options);
+  }
+
+  /* -- Rows are parsed from the same block buffer the reader uses */
+  return csv_util_import_reader(csv_reader_open(csv_file, 0), metadata,
+                                options);
+}
+
+/************************************************/
+/*             CSV_IMPORT_SOURCE                */
+/************************************************/
+
+CSV_LIST *csv_import_source(CSV_SOURCE *source, CSV_METADATA **metadata,
+                            CSV_OPTIONS *options) {
+  if (metadata == NULL) {
+    csv_source_close(source);
+    return NULL;
+  }
+
+  CSV_OPTIONS defaults = {0};
+
+  if (options == NULL) {
+    options = &defaults;
+  }
+
+  return csv_util_import_reader(csv_reader_source(source, 0), metadata,
+                                options);
+}
+
+/************************************************/
+/*             CSV_UTIL_IMPORT_READER           */
+/************************************************/
+
+CSV_LIST *csv_util_import_reader(CSV_READER *csv_reader,
+                                 CSV_METADATA **metadata,
+                                 CSV_OPTIONS *options) {
+  if (csv_reader == NULL) {
+    return NULL;
+  }
+
+  CSV_LIST *csv_list = csv_arena_list(options->allocator, metadata);
+
+  if (csv_list == NULL) {
+    csv_reader_close(csv_reader);
+    return NULL;
+  }
+
+  csv_util_prepare(csv_list, options);
+
+  /* -- Copy the field names read by the reader */
+  csv_util_add_fields(csv_list, *metadata, csv_reader->field,
+                      csv_reader->fields);
+
+  csv_util_apply_schema(csv_list, *metadata, options->schema);
+
+  unsigned fields = 0;
+  bool error = false;
+
+  while (!error && csv_util_read_line(csv_reader, &fields)) {
+    error = csv_util_add_line(csv_list, *metadata, csv_reader->buffer,
+                              csv_reader->parser->fields, fields) != 0;
+  }
+
+  error = error || csv_reader->error;
+
+  csv_reader_close(csv_reader);
+
+  csv_util_end_import(csv_list);
+
+  if (error) {
+    fprintf(stderr, "%s: Unable to import the input.\n", __func__);
+    csv_clear(csv_list, *metadata);
+    return NULL;
+  }
+
+  return csv_list;
+}
+
+/************************************************/
+/*             CSV_IMPORT_MMAP                  */
+/************************************************/
+
+CSV_LIST *csv_import_mmap(char *csv_file, CSV_METADATA **metadata) {
+  CSV_OPTIONS options = {0};
+
+  options.mmap = true;
+
+  return csv_import_ex(csv_file, metadata, &options);
+}
+
+/************************************************/
+/*             CSV_UTIL_MAP_FILE                */
+/************************************************/
+
+int csv_util_map_file(const char *csv_file, const char **data, size_t *size) {
+  int csv_fd = open(csv_file, O_RDONLY);
+
+  if (csv_fd < 0) {
+    return -1;
+  }
+
+  struct stat csv_stat;
+
+  if (fstat(csv_fd, &csv_stat) != 0) {
+    close(csv_fd);
+    return -1;
+  }
+
+  size_t mapped_size = csv_stat.st_size;
+  const char *mapped_data = NULL;
+
+  if (mapped_size > 0) {
+    void *mapping =
+        mmap(NULL, mapped_size, PROT_READ, MAP_PRIVATE, csv_fd, 0);
+
+    if (mapping == MAP_FAILED) {
+      fprintf(stderr, "%s: Unable to map %s.\n", __func__, csv_file);
+      close(csv_fd);
+      return -1;
+    }
+
+    posix_madvise(mapping, mapped_size, POSIX_MADV_SEQUENTIAL);
+
+    mapped_data = mapping;
+  }
+
+  /* -- The mapping outlives the descriptor */
+  close(csv_fd);
+
+  *data = mapped_data;
+  *size = mapped_size;
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_IMPORT_MMAP             */
+/************************************************/
+
+CSV_LIST *csv_util_import_mmap(char *csv_file, CSV_METADATA **metadata,
+                               CSV_OPTIONS *options) {
+  const char *mapped_data = NULL;
+  size_t mapped_size = 0;
+
+  if (csv_util_map_file(csv_file, &mapped_data, &mapped_size) != 0) {
+    return NULL;
+  }
+
+  CSV_LIST *csv_list = csv_arena_list(options->allocator, metadata);
+
+  if (csv_list == NULL) {
+    if (mapped_data != NULL) {
+      munmap((void *)mapped_data, mapped_size);
+    }
+
+    return NULL;
+  }
+
+  csv_util_prepare(csv_list, options);
+
+  csv_list->string_pool.mapped_data = mapped_data;
+  csv_list->string_pool.mapped_size = mapped_size;
+
+  ptrdiff_t body = csv_util_parse_range(csv_list, *metadata, mapped_data,
+                                        mapped_size, true, 0);
+
+  csv_util_apply_schema(csv_list, *metadata, options->schema);
+
+  if (body < 0 ||
+      csv_util_parse_range(csv_list, *metadata, mapped_data + body,
+                           mapped_size - body, false, SIZE_MAX) < 0) {
+    fprintf(stderr, "%s: Unable to import %s.\n", __func__, csv_file);
+    csv_clear(csv_list, *metadata);
+    return NULL;
+  }
+
+  csv_util_end_import(csv_list);
+
+  return csv_list;
+}
+
+/************************************************/
+/*             CSV_UTIL_PARSE_RANGE             */
+/************************************************/
+
+ptrdiff_t csv_util_parse_range(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                               const char *data, size_t size, bool header,
+                               size_t max_rows) {
+  CSV_PARSER parser = {0};
+
+  size_t position = 0;
+  size_t block_size = CSV_SCAN_BLOCK_SIZE;
+  size_t total_rows = 0;
+  int status = 0;
+
+  while (status == 0 && position < size) {
+    size_t length = size - position;
+    bool last = true;
+
+    if (length > block_size) {
+      length = block_size;
+      last = false;
+    }
+
+    const char *block = data + position;
+
+    if (csv_parse_block(&parser, block, length) != 0) {
+      status = -1;
+      break;
+    }
+
+    unsigned fields = 0;
+    bool rows = false;
+
+    while (status == 0 && (header || total_rows < max_rows) &&
+           csv_parse_row(&parser, last, &fields)) {
+      rows = true;
+
+      /* -- First extract all fields */
+      if (header) {
+        csv_util_add_header(csv_list, metadata, block, parser.fields, fields);
+        header = false;
+        continue;
+      }
+
+      status = csv_util_add_line(csv_list, metadata, block, parser.fields,
+                                 fields);
+      total_rows += 1;
+    }
+
+    if (status != 0) {
+      break;
+    }
+
+    if (last || (rows && total_rows == max_rows)) {
+      position += parser.row;
+      break;
+    }
+
+    /* -- A single row is longer than the block, widen it */
+    if (rows == false) {
+      block_size *= 2;
+      continue;
+    }
+
+    position += parser.row;
+  }
+
+  csv_parse_free(&parser);
+
+  return status == 0 ? (ptrdiff_t)position : -1;
+}
+
+/************************************************/
+/*             CSV_EXPORT                       */
+/************************************************/
+
+void csv_export(CSV_LIST *csv_list, CSV_METADATA *metadata, char *output) {
+  csv_export_buffered(csv_list, metadata, output, CSV_OUTPUT_BUFFER_SIZE);
+}
+
+/************************************************/
+/*             CSV_EXPORT_BUFFERED              */
+/************************************************/
+
+void csv_export_buffered(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                         char *output, size_t buffer_size) {
+  if (csv_list == NULL || metadata == NULL) {
+    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+    return;
+  }
+
+  FILE *csv_stream;
+
+  /* -- Get CSV file name */
+  csv_stream = fopen(output ? output : CSV_DEFAULT_FILE_NAME, "w");
+
+  if (csv_stream == NULL) {
+    fprintf(stderr, "%s: Unable to open %s.\n", __func__,
+            output ? output : CSV_DEFAULT_FILE_NAME);
+    return;
+  }
+
+  /* -- Save data to a file */
+  csv_util_show(csv_list, csv_stream, metadata, buffer_size, NULL, 0);
+
+  fclose(csv_stream);
+}
+
+/************************************************/
+/*             CSV_EXPORT_ORDERED               */
+/************************************************/
+
+void csv_export_ordered(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                        char *output, const size_t *order, size_t total_rows) {
+  if (csv_list == NULL || metadata == NULL || order == NULL) {
+    fprintf(stderr, "%s: csv_list, metadata or order is NULL.\n", __func__);
+    return;
+  }
+
+  FILE *csv_stream = fopen(output ? output : CSV_DEFAULT_FILE_NAME, "w");
+
+  if (csv_stream == NULL) {
+    fprintf(stderr, "%s: Unable to open %s.\n", __func__,
+            output ? output : CSV_DEFAULT_FILE_NAME);
+    return;
+  }
+
+  csv_util_show(csv_list, csv_stream, metadata, CSV_OUTPUT_BUFFER_SIZE, order,
+                total_rows);
+
+  fclose(csv_stream);
+}
+
+/************************************************/
+/*             CSV_FIELD                       */
+/************************************************/
+
+CSV_FIELD_LIST *csv_field(char *field, CSV_LIST *csv_list,
+                          CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL) {
+    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+    return NULL;
+  }
+
+  int index = csv_util_field_find(csv_list, field);
+
+  return index < 0 ? NULL : csv_list->field_list[index];
+}
+
+/************************************************/
+/*             CSV_FIELD_INDEX                  */
+/************************************************/
+
+int csv_field_index(char *field, CSV_LIST *csv_list, CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL) {
+    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+    return -1;
+  }
+
+  return csv_util_field_find(csv_list, field);
+}
+
+/************************************************/
+/*             CSV_COLUMN                       */
+/************************************************/
+
+CSV_FIELD_LIST *csv_column(unsigned int column, CSV_LIST *csv_list,
+                           CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL) {
+    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+    return NULL;
+  }
+
+  if (column >= metadata->fields) {
+    return NULL;
+  }
+
+  return csv_list->field_list[column];
+}
+
+/************************************************/
+/*             CSV_STRING                       */
+/************************************************/
+
+char *csv_string(CSV_FIELD_LIST *field_list, size_t row, size_t *length) {
+  if (field_list == NULL || field_list->field_type != CHAR_TYPE ||
+      row >= field_list->rows) {
+    return NULL;
+  }
+
+  size_t char_length = 0;
+  char *string = csv_util_char(field_list, row, &char_length);
+
+  if (length != NULL) {
+    *length = char_length;
+  }
+
+  return string;
+}
+
+/************************************************/
+/*             CSV_CELL                         */
+/************************************************/
+
+bool csv_cell(size_t row, unsigned column, CSV_CELL *cell, CSV_LIST *csv_list,
+              CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL || cell == NULL) {
+    fprintf(stderr, "%s: csv_list, metadata or cell is NULL.\n", __func__);
+    return false;
+  }
+
+  if (row >= metadata->items || column >= metadata->fields ||
+      csv_util_row_dead(&csv_list->tombstones, row)) {
+    return false;
+  }
+
+  csv_util_fill_cell(csv_list->field_list[column], row, cell);
+
+  return true;
+}
+
+/************************************************/
+/*             CSV_ROW                          */
+/************************************************/
+
+bool csv_row(size_t row, CSV_ROW *row_data, CSV_LIST *csv_list,
+             CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL || row_data == NULL ||
+      row_data->cells == NULL) {
+    fprintf(stderr, "%s: csv_list, metadata or cells is NULL.\n", __func__);
+    return false;
+  }
+
+  if (row >= metadata->items ||
+      csv_util_row_dead(&csv_list->tombstones, row)) {
+    return false;
+  }
+
+  /* -- Columns are arrays, one indexed read per field */
+  for (unsigned i = 0; i < metadata->fields; i++) {
+    csv_util_fill_cell(csv_list->field_list[i], row, &row_data->cells[i]);
+  }
+
+  row_data->fields = metadata->fields;
+
+  return true;
+}
+
+/************************************************/
+/*             CSV_ITERATOR                     */
+/************************************************/
+
+CSV_ITERATOR csv_iterator(CSV_FIELD_LIST *field_list) {
+  CSV_ITERATOR iterator = {0};
+
+  iterator.field_list = field_list;
+  iterator.row = SIZE_MAX;
+
+  return iterator;
+}
+
+bool csv_iterator_next(CSV_ITERATOR *iterator) {
+  CSV_FIELD_LIST *field_list = iterator->field_list;
+
+  if (field_list == NULL) {
+    return false;
+  }
+
+  size_t row = iterator->row + 1;
+
+  /* -- Removed rows are skipped */
+  while (row < field_list->rows &&
+         csv_util_row_dead(field_list->tombstones, row)) {
+    row++;
+  }
+
+  if (row >= field_list->rows) {
+    return false;
+  }
+
+  iterator->row = row;
+  iterator->is_null = csv_util_is_null(field_list, row);
+
+  if (field_list->capacity == 0) {
+    iterator->char_data = "";
+    iterator->char_length = 0;
+    iterator->int_data = 0;
+    return true;
+  }
+
+  switch (field_list->field_type) {
+  case CHAR_TYPE: {
+    iterator->char_data =
+        csv_util_char(field_list, row, &iterator->char_length);
+    break;
+  }
+  case INT_TYPE: {
+    iterator->int_data = field_list->int_data[row];
+    break;
+  }
+  case DOUBLE_TYPE: {
+    iterator->double_data = field_list->double_data[row];
+    break;
+  }
+  }
+
+  return true;
+}
+
+/************************************************/
+/*             CSV_ADD_ROW                      */
+/************************************************/
+
+void csv_add_row(char *data, CSV_LIST *csv_list, CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL) {
+    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+    return;
+  }
+
+  csv_append_buffer(data, strlen(data), csv_list, metadata);
+}
+
+/************************************************/
+/*             CSV_APPEND_BUFFER                */
+/************************************************/
+
+size_t csv_append_buffer(const char *buffer, size_t length, CSV_LIST *csv_list,
+                         CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL || buffer == NULL) {
+    fprintf(stderr, "%s: csv_list, metadata or buffer is NULL.\n", __func__);
+    return 0;
+  }
+
+  /* -- Rows end in a newline but the last one, so this bounds the batch */
+  size_t rows = 1;
+  const char *end = buffer + length;
+
+  for (const char *line = buffer;
+       (line = memchr(line, '\n', end - line)) != NULL; line++) {
+    rows++;
+  }
+
+  /* -- Columns that have not seen a value yet do not know their type */
+  for (unsigned i = 0; i < metadata->fields; i++) {
+    CSV_FIELD_LIST *field_list = csv_list->field_list[i];
+
+    if ((field_list->rows > field_list->nulls ||
+         field_list->type_source != CSV_TYPE_GUESSED) &&
+        csv_util_reserve(field_list, field_list->rows + rows) != 0) {
+      return 0;
+    }
+  }
+
+  /* -- Strings are copied, never more than the buffer holds */
+  if (csv_util_pool_reserve(&csv_list->string_pool, length + rows) != 0) {
+    return 0;
+  }
+
+  size_t items = metadata->items;
+
+  csv_util_parse_range(csv_list, metadata, buffer, length, false, SIZE_MAX);
+
+  return metadata->items - items;
+}
+
+/************************************************/
+/*             CSV_REMOVE_ROW                   */
+/************************************************/
+
+void csv_remove_row(unsigned int row, CSV_LIST *csv_list,
+                    CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL) {
+    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+    return;
+  }
+
+  if (row >= metadata->items) {
+    return;
+  }
+
+  /* -- Rows after it move down right away, as they always have */
+  if (csv_util_tombstone(&csv_list->tombstones, row) == 0) {
+    csv_compact(csv_list, metadata);
+  }
+}
+
+/************************************************/
+/*             CSV_REMOVE_ROWS                  */
+/************************************************/
+
+void csv_remove_rows(const size_t *rows, size_t total_rows, CSV_LIST *csv_list,
+                     CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL) {
+    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+    return;
+  }
+
+  CSV_TOMBSTONES *tombstones = &csv_list->tombstones;
+
+  for (size_t i = 0; i < total_rows; i++) {
+    if (rows[i] < metadata->items &&
+        csv_util_tombstone(tombstones, rows[i]) != 0) {
+      return;
+    }
+  }
+
+  /* -- One linear pass pays for many removals */
+  if (tombstones->ratio < 1 &&
+      (double)tombstones->dead > tombstones->ratio * (double)metadata->items) {
+    csv_compact(csv_list, metadata);
+  }
+}
+
+/************************************************/
+/*             CSV_ROW_REMOVED                  */
+/************************************************/
+
+bool csv_row_removed(size_t row, CSV_LIST *csv_list) {
+  if (csv_list == NULL) {
+    fprintf(stderr, "%s: csv_list is NULL.\n", __func__);
+    return false;
+  }
+
+  return csv_util_row_dead(&csv_list->tombstones, row);
+}
+
+/************************************************/
+/*             CSV_COMPACT                      */
+/************************************************/
+
+void csv_compact(CSV_LIST *csv_list, CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL) {
+    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+    return;
+  }
+
+  CSV_TOMBSTONES *tombstones = &csv_list->tombstones;
+
+  if (tombstones->dead == 0) {
+    return;
+  }
+
+  for (unsigned i = 0; i < metadata->fields; i++) {
+    csv_util_compact_field(csv_list->field_list[i]);
+  }
+
+  /* -- Pool bytes of removed strings are reclaimed on clear */
+  metadata->items -= tombstones->dead;
+
+  memset(tombstones->bits, 0, tombstones->words * sizeof(uint64_t));
+  tombstones->dead = 0;
+}
+
+/************************************************/
+/*             CSV_PERMUTE                      */
+/************************************************/
+
+int csv_permute(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                const size_t *order, size_t total_rows) {
+  if (csv_list == NULL || metadata == NULL || order == NULL) {
+    fprintf(stderr, "%s: csv_list, metadata or order is NULL.\n", __func__);
+    return -1;
+  }
+
+  /* -- Columns are rewritten in place, they hold items rows */
+  if (total_rows > metadata->items) {
+    fprintf(stderr, "%s: More rows than the list holds.\n", __func__);
+    return -1;
+  }
+
+  for (size_t i = 0; i < total_rows; i++) {
+    if (order[i] >= metadata->items) {
+      fprintf(stderr, "%s: Row %zu is out of range.\n", __func__, order[i]);
+      return -1;
+    }
+  }
+
+  uint64_t *scratch = malloc((total_rows ? total_rows : 1) * sizeof(uint64_t));
+
+  if (scratch == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
+
+  for (unsigned i = 0; i < metadata->fields; i++) {
+    csv_util_permute_field(csv_list->field_list[i], order, total_rows, scratch);
+  }
+
+  free(scratch);
+
+  /* -- Rows not listed are gone like compacted ones */
+  CSV_TOMBSTONES *tombstones = &csv_list->tombstones;
+
+  metadata->items = total_rows;
+
+  if (tombstones->bits != NULL) {
+    memset(tombstones->bits, 0, tombstones->words * sizeof(uint64_t));
+  }
+
+  tombstones->dead = 0;
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_SHOW                         */
+/************************************************/
+
+/* TODO: Refactor code */
+void csv_show(CSV_LIST *csv_list, CSV_METADATA *metadata) {
+  /* -- Print data to terminal */
+  csv_util_show(csv_list, stdout, metadata, CSV_OUTPUT_BUFFER_SIZE, NULL, 0);
+
+  fflush(stdout);
+}
+
+/************************************************/
+/*             CSV_CLEAR                        */
+/************************************************/
+
+void csv_clear(CSV_LIST *csv_list, CSV_METADATA *metadata) {
+  if (csv_list == NULL || metadata == NULL) {
+    fprintf(stderr, "%s: csv_list or metadata is NULL.\n", __func__);
+    return;
+  }
+
+  CSV_ALLOCATOR *allocator = &csv_list->arena.allocator;
+
+  /* -- Column storage grows in place, everything else is in the arena */
+  for (int i = 0; i < metadata->fields; i++) {
+    CSV_FIELD_LIST *field_list = csv_list->field_list[i];
+    size_t capacity = field_list->capacity;
+
+    csv_util_dictionary_free(field_list);
+    csv_alloc_release(allocator, field_list->int_data, capacity * 8);
+    csv_alloc_release(allocator, field_list->char_offset,
+                      capacity * sizeof(size_t));
+    csv_alloc_release(allocator, field_list->char_length,
+                      capacity * sizeof(uint32_t));
+    csv_alloc_release(allocator, field_list->null_data, capacity);
+  }
+
+  if (csv_list->string_pool.mapped_data != NULL) {
+    munmap((void *)csv_list->string_pool.mapped_data,
+           csv_list->string_pool.mapped_size);
+  }
+
+  if (csv_list->follow != NULL) {
+    close(csv_list->follow->descriptor);
+  }
+
+  csv_alloc_release(allocator, csv_list->string_pool.data,
+                    csv_list->string_pool.capacity);
+  csv_alloc_release(allocator, csv_list->scratch, csv_list->scratch_size);
+  csv_alloc_release(allocator, csv_list->field_slots,
+                    csv_list->field_slot_count * sizeof(uint32_t));
+  csv_alloc_release(allocator, csv_list->tombstones.bits,
+                    csv_list->tombstones.words * sizeof(uint64_t));
+  csv_alloc_release(allocator, csv_list->field_list,
+                    csv_list->field_capacity * sizeof(CSV_FIELD_LIST *));
+
+  /* -- The list and metadata live in the arena, release from a copy */
+  CSV_ARENA arena = csv_list->arena;
+
+  csv_arena_release(&arena);
 }
@@ -0,0 +1,650 @@
+/**
+ * @file parallel.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Multi-threaded import for libcsv
+ *
+ * The mapped file is cut into one chunk per thread. Every chunk first runs
+ * the quoting rules of the row parser from each state a field can be in when
+ * the chunk starts, a quote only opens a field at its start. Chaining the
+ * states the chunks end in gives the state at every cut, and each cut is
+ * moved to the next newline that ends a row. Every thread then parses its
+ * rows into a segment of its own and the segments are stitched into the list
+ * in file order.
+ *
+ * @version 0.1
+ * @date 2025-01-13
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <csv-arena.h>
+#include <csv-utils.h>
+#include <libcsv.h>
+
+/************************************************/
+/*             CSV_CUT_TABLE                    */
+/************************************************/
+
+/* -- Where a field is, as far as csv_parse_row() tells rows apart */
+typedef enum {
+  /* -- Start of a field, only spaces so far, a quote opens it */
+  CSV_CUT_START,
+  /* -- Unquoted field, quotes are plain characters */
+  CSV_CUT_FIELD,
+  CSV_CUT_QUOTED,
+  /* -- Right after a quote inside a quoted field, closing or doubled */
+  CSV_CUT_QUOTE,
+  /* -- Past the closing quote, the rest of the field is junk */
+  CSV_CUT_AFTER_QUOTE,
+  CSV_CUT_STATES
+} CSV_CUT_STATE;
+
+typedef enum {
+  CSV_CUT_DELIMITER,
+  CSV_CUT_NEWLINE,
+  CSV_CUT_QUOTE_MARK,
+  CSV_CUT_SPACE,
+  CSV_CUT_OTHER,
+  CSV_CUT_CLASSES
+} CSV_CUT_CLASS;
+
+/* -- Indexed by [class][state], a newline outside quotes ends a row */
+static const uint8_t csv_cut_table[CSV_CUT_CLASSES][CSV_CUT_STATES] = {
+    [CSV_CUT_DELIMITER] = {CSV_CUT_START, CSV_CUT_START, CSV_CUT_QUOTED,
+                           CSV_CUT_START, CSV_CUT_START},
+    [CSV_CUT_NEWLINE] = {CSV_CUT_START, CSV_CUT_START, CSV_CUT_QUOTED,
+                         CSV_CUT_START, CSV_CUT_START},
+    [CSV_CUT_QUOTE_MARK] = {CSV_CUT_QUOTED, CSV_CUT_FIELD, CSV_CUT_QUOTE,
+                            CSV_CUT_QUOTED, CSV_CUT_AFTER_QUOTE},
+    [CSV_CUT_SPACE] = {CSV_CUT_START, CSV_CUT_FIELD, CSV_CUT_QUOTED,
+                       CSV_CUT_AFTER_QUOTE, CSV_CUT_AFTER_QUOTE},
+    [CSV_CUT_OTHER] = {CSV_CUT_FIELD, CSV_CUT_FIELD, CSV_CUT_QUOTED,
+                       CSV_CUT_AFTER_QUOTE, CSV_CUT_AFTER_QUOTE},
+};
+
+static inline CSV_CUT_CLASS csv_util_cut_class(char character) {
+  return character == CSV_DELIMETER[0] ? CSV_CUT_DELIMITER
+         : character == '\n'          ? CSV_CUT_NEWLINE
+         : character == '"'            ? CSV_CUT_QUOTE_MARK
+         : isspace((unsigned char)character) ? CSV_CUT_SPACE
+                                             : CSV_CUT_OTHER;
+}
+
+/************************************************/
+/*             CSV_CHUNK                        */
+/************************************************/
+
+typedef struct csv_chunk {
+  /* -- Only read while the workers run */
+  CSV_LIST *csv_list;
+  CSV_METADATA *metadata;
+  CSV_ALLOCATOR *allocator;
+
+  size_t begin;
+  size_t end;
+
+  /* -- Cut state the chunk ends in, for every state it may start in */
+  uint8_t states[CSV_CUT_STATES];
+
+  CSV_LIST *segment;
+  CSV_METADATA *segment_metadata;
+} CSV_CHUNK;
+
+static void *csv_util_chunk_states(void *argument) {
+  CSV_CHUNK *chunk = argument;
+  const char *data = chunk->csv_list->string_pool.mapped_data;
+
+  uint8_t states[CSV_CUT_STATES];
+
+  for (unsigned state = 0; state < CSV_CUT_STATES; state++) {
+    states[state] = state;
+  }
+
+  for (size_t i = chunk->begin; i < chunk->end; i++) {
+    const uint8_t *next = csv_cut_table[csv_util_cut_class(data[i])];
+
+    for (unsigned state = 0; state < CSV_CUT_STATES; state++) {
+      states[state] = next[states[state]];
+    }
+  }
+
+  memcpy(chunk->states, states, sizeof(states));
+
+  return NULL;
+}
+
+static void *csv_util_parse_chunk(void *argument) {
+  CSV_CHUNK *chunk = argument;
+  CSV_LIST *csv_list = chunk->csv_list;
+
+  CSV_LIST *segment =
+      csv_arena_list(chunk->allocator, &chunk->segment_metadata);
+
+  if (segment == NULL) {
+    return NULL;
+  }
+
+  segment->dictionary_mode = csv_list->dictionary_mode;
+  segment->projection = csv_list->projection;
+  segment->source_fields = csv_list->source_fields;
+  segment->filter = csv_list->filter;
+
+  if (csv_util_reserve_fields(segment, chunk->segment_metadata,
+                              chunk->metadata->fields) != 0) {
+    csv_clear(segment, chunk->segment_metadata);
+    return NULL;
+  }
+
+  for (unsigned i = 0; i < chunk->metadata->fields; i++) {
+    CSV_FIELD_LIST *field_list = csv_list->field_list[i];
+
+    /* -- A segment short of a field can not be stitched */
+    if (csv_util_add_field(segment, chunk->segment_metadata,
+                           field_list->field) != 0) {
+      csv_clear(segment, chunk->segment_metadata);
+      return NULL;
+    }
+
+    if (field_list->type_source != CSV_TYPE_GUESSED) {
+      CSV_FIELD_LIST *part = segment->field_list[i];
+
+      csv_util_promote(part, field_list->field_type);
+      part->type_source = field_list->type_source;
+    }
+  }
+
+  /* -- Strings stay views into the mapping of the list */
+  segment->string_pool.mapped_data = csv_list->string_pool.mapped_data;
+  segment->string_pool.mapped_size = csv_list->string_pool.mapped_size;
+
+  if (csv_util_parse_range(segment, chunk->segment_metadata,
+                           segment->string_pool.mapped_data + chunk->begin,
+                           chunk->end - chunk->begin, false, SIZE_MAX) < 0) {
+    /* -- The mapping belongs to the list */
+    segment->string_pool.mapped_data = NULL;
+
+    csv_clear(segment, chunk->segment_metadata);
+    return NULL;
+  }
+
+  chunk->segment = segment;
+
+  return NULL;
+}
+
+/************************************************/
+/*             CSV_UTIL_RUN_CHUNKS              */
+/************************************************/
+
+static void csv_util_run_chunks(CSV_CHUNK *chunks, unsigned total_chunks,
+                                void *(*worker)(void *)) {
+  pthread_t *threads = calloc(total_chunks, sizeof(pthread_t));
+  bool *started = calloc(total_chunks, sizeof(bool));
+
+  for (unsigned i = 0; i < total_chunks; i++) {
+    started[i] = threads != NULL && started != NULL &&
+                 pthread_create(&threads[i], NULL, worker, &chunks[i]) == 0;
+
+    /* -- No thread to spare, do the work here */
+    if (!started[i]) {
+      worker(&chunks[i]);
+    }
+  }
+
+  for (unsigned i = 0; i < total_chunks; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+
+  free(threads);
+  free(started);
+}
+
+/************************************************/
+/*             CSV_UTIL_STITCH_CHAR             */
+/************************************************/
+
+static int csv_util_stitch_char(CSV_LIST *csv_list, unsigned field,
+                                CSV_CHUNK *chunks, unsigned total_chunks,
+                                size_t *shift) {
+  CSV_FIELD_LIST *field_list = csv_list->field_list[field];
+  size_t mapped_size = csv_list->string_pool.mapped_size;
+
+  /* -- Codes can be remapped only if every segment kept its dictionary */
+  bool encode = field_list->dictionary != NULL;
+
+  for (unsigned c = 0; c < total_chunks && encode; c++) {
+    CSV_FIELD_LIST *part = chunks[c].segment->field_list[field];
+
+    encode = part->rows == 0 || part->dictionary != NULL;
+  }
+
+  if (!encode && field_list->dictionary != NULL &&
+      csv_util_dictionary_decode(field_list) != 0) {
+    return -1;
+  }
+
+  /* -- Rows of the sample stay in front */
+  size_t base = field_list->rows;
+
+  for (unsigned c = 0; c < total_chunks; c++) {
+    CSV_FIELD_LIST *part = chunks[c].segment->field_list[field];
+    CSV_DICTIONARY *dictionary = part->dictionary;
+
+    if (encode && part->rows > 0) {
+      uint32_t *codes = malloc(dictionary->values * sizeof(uint32_t));
+
+      if (codes == NULL) {
+        fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+        return -1;
+      }
+
+      /* -- Interning may widen the codes of the rows stitched so far */
+      field_list->rows = base;
+
+      for (uint32_t code = 0; code < dictionary->values; code++) {
+        const char *value =
+            csv_util_string(part->string_pool, dictionary->value_offset[code]);
+
+        codes[code] = csv_util_dictionary_intern(
+            field_list, value, dictionary->value_length[code]);
+      }
+
+      for (size_t row = 0; row < part->rows; row++) {
+        csv_util_dictionary_set(
+            field_list->dictionary, base + row,
+            codes[csv_util_dictionary_code(dictionary, row)]);
+      }
+
+      free(codes);
+    } else {
+      for (size_t row = 0; row < part->rows; row++) {
+        size_t offset = 0;
+        size_t length = 0;
+
+        if (dictionary != NULL) {
+          uint32_t code = csv_util_dictionary_code(dictionary, row);
+
+          offset = dictionary->value_offset[code];
+          length = dictionary->value_length[code];
+        } else {
+          offset = part->char_offset[row];
+          length = part->char_length[row];
+        }
+
+        /* -- Heap strings moved along with the segment pool */
+        if (offset >= mapped_size) {
+          offset += shift[c];
+        }
+
+        field_list->char_offset[base + row] = offset;
+        field_list->char_length[base + row] = length;
+      }
+    }
+
+    base += part->rows;
+  }
+
+  field_list->rows = base;
+
+  /* -- Same rule as a column that grew one row at a time */
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+
+  if (dictionary != NULL &&
+      field_list->dictionary_mode == CSV_DICTIONARY_AUTO &&
+      (dictionary->values > CSV_DICTIONARY_LIMIT ||
+       (base >= CSV_DICTIONARY_SAMPLE &&
+        (size_t)dictionary->values * 2 > base))) {
+    return csv_util_dictionary_decode(field_list);
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_STITCH                  */
+/************************************************/
+
+static int csv_util_type_rank(CSV_FIELD_TYPE field_type) {
+  return field_type == INT_TYPE ? 0 : field_type == DOUBLE_TYPE ? 1 : 2;
+}
+
+static int csv_util_stitch(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                           CSV_CHUNK *chunks, unsigned total_chunks) {
+  size_t rows = 0;
+
+  for (unsigned c = 0; c < total_chunks; c++) {
+    rows += chunks[c].segment_metadata->items;
+  }
+
+  CSV_FIELD_TYPE *field_types =
+      calloc(metadata->fields, sizeof(CSV_FIELD_TYPE));
+  size_t *shift = calloc(total_chunks, sizeof(size_t));
+
+  if (field_types == NULL || shift == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    free(field_types);
+    free(shift);
+    return -1;
+  }
+
+  /* -- Bring every segment to the widest type first, numbers rendered as
+   * strings land in the segment pools */
+  for (unsigned field = 0; field < metadata->fields; field++) {
+    CSV_FIELD_LIST *field_list = csv_list->field_list[field];
+    CSV_FIELD_TYPE field_type = field_list->field_type;
+    bool typed = field_list->rows > field_list->nulls;
+
+    for (unsigned c = 0; c < total_chunks; c++) {
+      CSV_FIELD_LIST *part = chunks[c].segment->field_list[field];
+
+      /* -- All null segments take any type */
+      if (part->rows == part->nulls) {
+        continue;
+      }
+
+      if (!typed || csv_util_type_rank(part->field_type) >
+                        csv_util_type_rank(field_type)) {
+        field_type = part->field_type;
+
+        /* -- Widen what came before right away, numbers go through the
+         * same types as they would in a single threaded import */
+        if (typed) {
+          csv_util_promote(field_list, field_type);
+
+          for (unsigned d = 0; d < c; d++) {
+            csv_util_promote(chunks[d].segment->field_list[field], field_type);
+          }
+        }
+
+        typed = true;
+      }
+    }
+
+    bool stored = field_list->capacity > 0;
+
+    for (unsigned c = 0; c < total_chunks; c++) {
+      CSV_FIELD_LIST *part = chunks[c].segment->field_list[field];
+
+      csv_util_promote(part, field_type);
+      stored = stored || part->capacity > 0;
+    }
+
+    /* -- Null only segments get storage while their pool can still grow,
+     * unless the whole column is nulls */
+    for (unsigned c = 0; c < total_chunks && stored; c++) {
+      CSV_FIELD_LIST *part = chunks[c].segment->field_list[field];
+
+      if (part->capacity == 0 && part->rows > 0 &&
+          csv_util_reserve(part, part->rows) != 0) {
+        free(field_types);
+        free(shift);
+        return -1;
+      }
+    }
+
+    field_types[field] = field_type;
+  }
+
+  /* -- Segment pools are appended whole, their offsets shift by what came
+   * before. Every string ends in a NUL, so the last byte is the one that
+   * csv_util_pool_add() puts back. */
+  for (unsigned c = 0; c < total_chunks; c++) {
+    CSV_STRING_POOL *string_pool = &chunks[c].segment->string_pool;
+
+    shift[c] = csv_list->string_pool.size;
+
+    if (string_pool->size > 0 &&
+        csv_util_pool_add(&csv_list->string_pool, string_pool->data,
+                          string_pool->size - 1) == SIZE_MAX) {
+      free(field_types);
+      free(shift);
+      return -1;
+    }
+  }
+
+  int status = 0;
+
+  for (unsigned field = 0; field < metadata->fields && status == 0; field++) {
+    CSV_FIELD_LIST *field_list = csv_list->field_list[field];
+    CSV_FIELD_TYPE field_type = field_types[field];
+    size_t sample = field_list->rows;
+    bool stored = field_list->capacity > 0;
+
+    for (unsigned c = 0; c < total_chunks && !stored; c++) {
+      stored = chunks[c].segment->field_list[field]->capacity > 0;
+    }
+
+    /* -- Still only nulls, keep counting */
+    if (!stored) {
+      field_list->rows += rows;
+      field_list->nulls += rows;
+      continue;
+    }
+
+    if (csv_util_promote(field_list, field_type) != 0 ||
+        csv_util_reserve(field_list, sample + rows) != 0) {
+      status = -1;
+      break;
+    }
+
+    if (field_type == CHAR_TYPE) {
+      status = csv_util_stitch_char(csv_list, field, chunks, total_chunks,
+                                    shift);
+    } else {
+      size_t base = sample;
+
+      for (unsigned c = 0; c < total_chunks; c++) {
+        CSV_FIELD_LIST *part = chunks[c].segment->field_list[field];
+
+        memcpy(field_list->int_data + base, part->int_data, part->rows * 8);
+        base += part->rows;
+      }
+
+      field_list->rows = base;
+    }
+
+    /* -- Null maps follow the rows */
+    size_t base = sample;
+
+    for (unsigned c = 0; c < total_chunks; c++) {
+      CSV_FIELD_LIST *part = chunks[c].segment->field_list[field];
+
+      if (part->null_data != NULL && part->nulls > 0) {
+        if (field_list->null_data == NULL) {
+          field_list->null_data = csv_alloc_resize(field_list->allocator, NULL,
+                                                   0, field_list->capacity);
+
+          if (field_list->null_data == NULL) {
+            fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+            status = -1;
+            break;
+          }
+
+          memset(field_list->null_data, 0, field_list->capacity);
+        }
+
+        memcpy(field_list->null_data + base, part->null_data, part->rows);
+        field_list->nulls += part->nulls;
+      }
+
+      base += part->rows;
+    }
+  }
+
+  if (status == 0) {
+    metadata->items += rows;
+  }
+
+  free(field_types);
+  free(shift);
+
+  return status;
+}
+
+/************************************************/
+/*             CSV_UTIL_IMPORT_PARALLEL         */
+/************************************************/
+
+CSV_LIST *csv_util_import_parallel(char *csv_file, CSV_METADATA **metadata,
+                                   CSV_OPTIONS *options) {
+  const char *mapped_data = NULL;
+  size_t mapped_size = 0;
+
+  if (csv_util_map_file(csv_file, &mapped_data, &mapped_size) != 0) {
+    return NULL;
+  }
+
+  CSV_LIST *csv_list = csv_arena_list(options->allocator, metadata);
+
+  if (csv_list == NULL) {
+    if (mapped_data != NULL) {
+      munmap((void *)mapped_data, mapped_size);
+    }
+
+    return NULL;
+  }
+
+  csv_util_prepare(csv_list, options);
+
+  csv_list->string_pool.mapped_data = mapped_data;
+  csv_list->string_pool.mapped_size = mapped_size;
+
+  /* -- The header and the sample are parsed up front, workers copy the
+   * fields and their settled types */
+  ptrdiff_t header = csv_util_parse_range(csv_list, *metadata, mapped_data,
+                                          mapped_size, true, 0);
+
+  csv_util_apply_schema(csv_list, *metadata, options->schema);
+
+  ptrdiff_t sample =
+      header < 0 ? -1
+                 : csv_util_parse_range(csv_list, *metadata,
+                                        mapped_data + header,
+                                        mapped_size - header, false,
+                                        csv_list->sample_rows);
+
+  if (sample < 0) {
+    fprintf(stderr, "%s: Unable to import %s.\n", __func__, csv_file);
+    csv_clear(csv_list, *metadata);
+    return NULL;
+  }
+
+  size_t body = header + sample;
+  size_t body_size = mapped_size - body;
+
+  unsigned total_chunks = options->threads;
+
+  if (body_size / CSV_PARALLEL_CHUNK < total_chunks) {
+    total_chunks = body_size / CSV_PARALLEL_CHUNK;
+  }
+
+  CSV_CHUNK *chunks = NULL;
+
+  if (total_chunks > 1 && (*metadata)->fields > 0) {
+    chunks = calloc(total_chunks, sizeof(CSV_CHUNK));
+  }
+
+  /* -- Not worth the threads or no room to split the work, parse the rest
+   * here */
+  if (chunks == NULL) {
+    ptrdiff_t rest = csv_util_parse_range(csv_list, *metadata,
+                                          mapped_data + body, body_size,
+                                          false, SIZE_MAX);
+
+    csv_util_end_import(csv_list);
+
+    if (rest < 0) {
+      fprintf(stderr, "%s: Unable to import %s.\n", __func__, csv_file);
+      csv_clear(csv_list, *metadata);
+      return NULL;
+    }
+
+    return csv_list;
+  }
+
+  for (unsigned c = 0; c < total_chunks; c++) {
+    chunks[c].csv_list = csv_list;
+    chunks[c].metadata = *metadata;
+    chunks[c].allocator = options->allocator;
+    chunks[c].begin = body + body_size / total_chunks * c;
+    chunks[c].end = c + 1 < total_chunks
+                        ? body + body_size / total_chunks * (c + 1)
+                        : mapped_size;
+  }
+
+  csv_util_run_chunks(chunks, total_chunks, csv_util_chunk_states);
+
+  /* -- The body starts on a row, move every cut to the next row end */
+  uint8_t state = CSV_CUT_START;
+
+  for (unsigned c = 1; c < total_chunks; c++) {
+    state = chunks[c - 1].states[state];
+
+    size_t cut = chunks[c].begin;
+    uint8_t inside = state;
+
+    while (cut < mapped_size) {
+      CSV_CUT_CLASS class = csv_util_cut_class(mapped_data[cut++]);
+
+      if (class == CSV_CUT_NEWLINE && inside != CSV_CUT_QUOTED) {
+        break;
+      }
+
+      inside = csv_cut_table[class][inside];
+    }
+
+    if (cut < chunks[c - 1].begin) {
+      cut = chunks[c - 1].begin;
+    }
+
+    chunks[c - 1].end = cut;
+    chunks[c].begin = cut;
+  }
+
+  csv_util_run_chunks(chunks, total_chunks, csv_util_parse_chunk);
+
+  bool parsed = true;
+
+  for (unsigned c = 0; c < total_chunks; c++) {
+    parsed = parsed && chunks[c].segment != NULL;
+  }
+
+  int status = parsed ? csv_util_stitch(csv_list, *metadata, chunks,
+                                        total_chunks)
+                      : -1;
+
+  for (unsigned c = 0; c < total_chunks; c++) {
+    if (chunks[c].segment == NULL) {
+      continue;
+    }
+
+    /* -- The mapping belongs to the list */
+    chunks[c].segment->string_pool.mapped_data = NULL;
+
+    csv_clear(chunks[c].segment, chunks[c].segment_metadata);
+  }
+
+  free(chunks);
+
+  csv_util_end_import(csv_list);
+
+  if (status != 0) {
+    fprintf(stderr, "%s: Unable to import %s.\n", __func__, csv_file);
+    csv_clear(csv_list, *metadata);
+    return NULL;
+  }
+
+  return csv_list;
+}
@@ -0,0 +1,248 @@
+/**
+ * @file parser.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief RFC 4180 row parser for libcsv
+ *
+ * A table driven state machine walks the structural index of a block, so
+ * only delimiters, quotes and newlines are looked at. Quoted fields, doubled
+ * quotes, empty fields and CRLF line endings are handled in the same pass and
+ * rows are not limited in length.
+ *
+ * @version 0.1
+ * @date 2025-01-10
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csv-parser.h>
+#include <csv-scan.h>
+#include <libcsv.h>
+
+/************************************************/
+/*             CSV_PARSE_TABLE                  */
+/************************************************/
+
+typedef struct csv_transition {
+  CSV_STATE state;
+  CSV_ACTION action;
+} CSV_TRANSITION;
+
+/* -- Indexed by [state][class], OPEN and ESCAPE may still change state */
+const CSV_TRANSITION csv_parse_table[CSV_STATES][CSV_CLASSES] = {
+    [CSV_STATE_FIELD] =
+        {
+            [CSV_CLASS_DELIMITER] = {CSV_STATE_FIELD, CSV_ACTION_FIELD},
+            [CSV_CLASS_QUOTE] = {CSV_STATE_FIELD, CSV_ACTION_OPEN},
+            [CSV_CLASS_NEWLINE] = {CSV_STATE_FIELD, CSV_ACTION_ROW},
+        },
+    [CSV_STATE_QUOTED] =
+        {
+            [CSV_CLASS_DELIMITER] = {CSV_STATE_QUOTED, CSV_ACTION_NONE},
+            [CSV_CLASS_QUOTE] = {CSV_STATE_QUOTE, CSV_ACTION_CLOSE},
+            [CSV_CLASS_NEWLINE] = {CSV_STATE_QUOTED, CSV_ACTION_NONE},
+        },
+    [CSV_STATE_QUOTE] =
+        {
+            [CSV_CLASS_DELIMITER] = {CSV_STATE_FIELD, CSV_ACTION_FIELD},
+            [CSV_CLASS_QUOTE] = {CSV_STATE_QUOTED, CSV_ACTION_ESCAPE},
+            [CSV_CLASS_NEWLINE] = {CSV_STATE_FIELD, CSV_ACTION_ROW},
+        },
+    [CSV_STATE_AFTER_QUOTE] =
+        {
+            [CSV_CLASS_DELIMITER] = {CSV_STATE_FIELD, CSV_ACTION_FIELD},
+            [CSV_CLASS_QUOTE] = {CSV_STATE_AFTER_QUOTE, CSV_ACTION_NONE},
+            [CSV_CLASS_NEWLINE] = {CSV_STATE_FIELD, CSV_ACTION_ROW},
+        },
+};
+
+/************************************************/
+/*             CSV_PARSE_BLOCK                  */
+/************************************************/
+
+int csv_parse_block(CSV_PARSER *parser, const char *data, size_t length) {
+  parser->next = 0;
+  parser->row = 0;
+
+  return csv_scan_reset(&parser->scanner, data, length);
+}
+
+/************************************************/
+/*             CSV_PARSE_ROW                    */
+/************************************************/
+
+bool csv_parse_row(CSV_PARSER *parser, bool last, unsigned *fields) {
+  CSV_SCANNER *scanner = &parser->scanner;
+  const char *data = scanner->data;
+
+  while (parser->row < scanner->length) {
+    size_t next = parser->next;
+    size_t field_begin = parser->row;
+    size_t quote_begin = 0;
+    size_t quote_end = 0;
+
+    CSV_STATE state = CSV_STATE_FIELD;
+    unsigned flags = 0;
+    unsigned total_fields = 0;
+    bool complete = false;
+
+    while (!complete) {
+      size_t position = scanner->length;
+      CSV_CLASS class = CSV_CLASS_NEWLINE;
+
+      if (next < scanner->count) {
+        position = scanner->positions[next];
+        next += 1;
+
+        char character = data[position];
+
+        class = character == '\n'  ? CSV_CLASS_NEWLINE
+                : character == '"' ? CSV_CLASS_QUOTE
+                                   : CSV_CLASS_DELIMITER;
+      } else if (!last) {
+        /* -- Incomplete row, leave the cursor where it was */
+        return false;
+      } else if (state == CSV_STATE_QUOTED) {
+        /* -- Unterminated quote, the field runs to the end of the data */
+        quote_end = position;
+        state = CSV_STATE_AFTER_QUOTE;
+      }
+
+      CSV_TRANSITION transition = csv_parse_table[state][class];
+
+      switch (transition.action) {
+      case CSV_ACTION_NONE: {
+        break;
+      }
+      case CSV_ACTION_OPEN: {
+        /* -- Only a quote at the start of a field opens a quoted field */
+        const char *prefix = data + field_begin;
+
+        while (prefix < data + position && isspace((unsigned char)*prefix)) {
+          prefix++;
+        }
+
+        if (prefix == data + position) {
+          quote_begin = position + 1;
+          flags |= CSV_SPAN_QUOTED;
+          transition.state = CSV_STATE_QUOTED;
+        }
+
+        break;
+      }
+      case CSV_ACTION_CLOSE: {
+        quote_end = position;
+        break;
+      }
+      case CSV_ACTION_ESCAPE: {
+        /* -- Doubled quote, anything else after the closing quote is junk */
+        if (position == quote_end + 1) {
+          flags |= CSV_SPAN_ESCAPED;
+        } else {
+          transition.state = CSV_STATE_AFTER_QUOTE;
+        }
+
+        break;
+      }
+      case CSV_ACTION_FIELD:
+      case CSV_ACTION_ROW: {
+        if (total_fields >= parser->max_fields) {
+          unsigned max_fields =
+              parser->max_fields ? parser->max_fields * 2 : 64;
+          CSV_SPAN *spans =
+              realloc(parser->fields, max_fields * sizeof(CSV_SPAN));
+
+          if (spans == NULL) {
+            fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+            return false;
+          }
+
+          parser->fields = spans;
+          parser->max_fields = max_fields;
+        }
+
+        CSV_SPAN *span = &parser->fields[total_fields];
+
+        if (flags & CSV_SPAN_QUOTED) {
+          span->begin = quote_begin;
+          span->length = quote_end - quote_begin;
+        } else {
+          span->begin = field_begin;
+          span->length = position - field_begin;
+        }
+
+        span->flags = flags;
+
+        total_fields += 1;
+        flags = 0;
+        field_begin = position + 1;
+
+        complete = transition.action == CSV_ACTION_ROW;
+
+        break;
+      }
+      }
+
+      state = transition.state;
+    }
+
+    parser->next = next;
+    parser->row =
+        field_begin < scanner->length ? field_begin : scanner->length;
+
+    /* -- Skip blank lines */
+    if (total_fields == 1 && parser->fields[0].flags == 0) {
+      const char *blank = data + parser->fields[0].begin;
+      size_t length = parser->fields[0].length;
+
+      while (length > 0 && isspace((unsigned char)*blank)) {
+        blank++;
+        length--;
+      }
+
+      if (length == 0) {
+        continue;
+      }
+    }
+
+    *fields = total_fields;
+
+    return true;
+  }
+
+  return false;
+}
+
+/************************************************/
+/*             CSV_PARSE_UNESCAPE               */
+/************************************************/
+
+size_t csv_parse_unescape(const char *data, size_t length, char *output) {
+  size_t written = 0;
+
+  for (size_t i = 0; i < length; i++) {
+    output[written++] = data[i];
+
+    if (data[i] == '"' && i + 1 < length && data[i + 1] == '"') {
+      i++;
+    }
+  }
+
+  return written;
+}
+
+/************************************************/
+/*             CSV_PARSE_FREE                   */
+/************************************************/
+
+void csv_parse_free(CSV_PARSER *parser) {
+  csv_scan_free(&parser->scanner);
+  free(parser->fields);
+
+  memset(parser, 0, sizeof(CSV_PARSER));
+}
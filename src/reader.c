@@ -0,0 +1,241 @@
+/**
+ * @file reader.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Streaming reader for libcsv
+ *
+ * Rows are tokenized and typed one at a time from a reusable buffer, so files
+ * larger than memory can be filtered and aggregated without building a
+ * CSV_LIST.
+ *
+ * @version 0.1
+ * @date 2025-01-03
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csv-parser.h>
+#include <csv-utils.h>
+#include <libcsv.h>
+#include <util.h>
+
+/************************************************/
+/*             CSV_UTIL_READ_BLOCK              */
+/************************************************/
+
+bool csv_util_read_block(CSV_READER *csv_reader) {
+  if (csv_reader->eof) {
+    return false;
+  }
+
+  /* -- Move the partial row to the front */
+  size_t consumed = csv_reader->begin + csv_reader->parser->row;
+  size_t available = csv_reader->end - consumed;
+
+  memmove(csv_reader->buffer, csv_reader->buffer + consumed, available);
+
+  csv_reader->begin = 0;
+  csv_reader->end = available;
+
+  /* -- A single row fills the buffer, grow it */
+  if (csv_reader->end == csv_reader->size) {
+    char *buffer = realloc(csv_reader->buffer, csv_reader->size * 2 + 1);
+
+    if (buffer == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return false;
+    }
+
+    csv_reader->buffer = buffer;
+    csv_reader->size *= 2;
+  }
+
+  ptrdiff_t bytes =
+      csv_util_source_fill(csv_reader->source,
+                           csv_reader->buffer + csv_reader->end,
+                           csv_reader->size - csv_reader->end);
+
+  /* -- A failed source ends the input, the error is kept */
+  if (bytes < 0) {
+    csv_reader->error = true;
+    bytes = 0;
+  }
+
+  csv_reader->end += bytes;
+
+  if (bytes == 0) {
+    csv_reader->eof = true;
+  }
+
+  /* -- Index the whole block once */
+  return csv_parse_block(csv_reader->parser, csv_reader->buffer,
+                         csv_reader->end) == 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_READ_LINE               */
+/************************************************/
+
+bool csv_util_read_line(CSV_READER *csv_reader, unsigned *fields) {
+  while (!csv_parse_row(csv_reader->parser, csv_reader->eof, fields)) {
+    if (!csv_util_read_block(csv_reader)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/************************************************/
+/*             CSV_READER_OPEN                  */
+/************************************************/
+
+CSV_READER *csv_reader_open(char *csv_file, size_t buffer_size) {
+  return csv_reader_source(csv_source_file(csv_file), buffer_size);
+}
+
+/************************************************/
+/*             CSV_READER_SOURCE                */
+/************************************************/
+
+CSV_READER *csv_reader_source(CSV_SOURCE *source, size_t buffer_size) {
+  if (source == NULL) {
+    return NULL;
+  }
+
+  if (buffer_size == 0) {
+    buffer_size = CSV_READER_BUFFER_SIZE;
+  }
+
+  CSV_READER *csv_reader = calloc(1, sizeof(CSV_READER));
+
+  if (csv_reader == NULL) {
+    csv_source_close(source);
+    return NULL;
+  }
+
+  csv_reader->source = source;
+  csv_reader->size = buffer_size;
+  csv_reader->parser = calloc(1, sizeof(CSV_PARSER));
+
+  /* -- One spare byte to terminate the last cell of the file */
+  csv_reader->buffer = malloc(buffer_size + 1);
+
+  if (csv_reader->buffer == NULL || csv_reader->parser == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    csv_reader_close(csv_reader);
+    return NULL;
+  }
+
+  unsigned fields = 0;
+
+  if (!csv_util_read_line(csv_reader, &fields)) {
+    return csv_reader;
+  }
+
+  /* -- First extract all fields */
+  CSV_SPAN *spans = csv_reader->parser->fields;
+
+  csv_reader->field = calloc(fields ? fields : 1, sizeof(char *));
+  csv_reader->cells = calloc(fields ? fields : 1, sizeof(CSV_CELL));
+
+  if (csv_reader->field == NULL || csv_reader->cells == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    csv_reader_close(csv_reader);
+    return NULL;
+  }
+
+  for (unsigned i = 0; i < fields; i++) {
+    char *field = csv_util_field_name(csv_reader->buffer, &spans[i]);
+
+    if (field == NULL) {
+      csv_reader_close(csv_reader);
+      return NULL;
+    }
+
+    csv_reader->field[csv_reader->fields] = field;
+    csv_reader->fields += 1;
+  }
+
+  return csv_reader;
+}
+
+/************************************************/
+/*             CSV_READER_NEXT                  */
+/************************************************/
+
+bool csv_reader_next(CSV_READER *csv_reader, CSV_ROW *row) {
+  if (csv_reader == NULL || row == NULL) {
+    fprintf(stderr, "%s: csv_reader or row is NULL.\n", __func__);
+    return false;
+  }
+
+  unsigned fields = 0;
+
+  while (csv_util_read_line(csv_reader, &fields)) {
+    /* -- Check for correct number of fields */
+    if (fields != csv_reader->fields || fields == 0) {
+      continue;
+    }
+
+    CSV_SPAN *spans = csv_reader->parser->fields;
+
+    for (unsigned i = 0; i < fields; i++) {
+      char *token = csv_reader->buffer + spans[i].begin;
+      size_t length = spans[i].length;
+
+      /* -- The buffer is ours, collapse doubled quotes in place */
+      if (spans[i].flags & CSV_SPAN_ESCAPED) {
+        length = csv_parse_unescape(token, length, token);
+      }
+
+      csv_util_convert(token, length, spans[i].flags, &csv_reader->cells[i]);
+    }
+
+    /* -- Terminate strings in place, the row is fully parsed */
+    for (unsigned i = 0; i < fields; i++) {
+      CSV_CELL *cell = &csv_reader->cells[i];
+
+      cell->char_data[cell->char_length] = '\0';
+    }
+
+    row->fields = fields;
+    row->cells = csv_reader->cells;
+
+    return true;
+  }
+
+  return false;
+}
+
+/************************************************/
+/*             CSV_READER_CLOSE                 */
+/************************************************/
+
+void csv_reader_close(CSV_READER *csv_reader) {
+  if (csv_reader == NULL) {
+    return;
+  }
+
+  if (csv_reader->field != NULL) {
+    for (unsigned i = 0; i < csv_reader->fields; i++) {
+      free(csv_reader->field[i]);
+    }
+  }
+
+  csv_source_close(csv_reader->source);
+
+  if (csv_reader->parser != NULL) {
+    csv_parse_free(csv_reader->parser);
+  }
+
+  free(csv_reader->parser);
+  free(csv_reader->field);
+  free(csv_reader->cells);
+  free(csv_reader->buffer);
+  free(csv_reader);
+}
@@ -0,0 +1,194 @@
+/**
+ * @file scan.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Structural character scanner for libcsv
+ *
+ * One pass over a block finds every delimiter, quote and newline. The parser
+ * then jumps between those positions instead of looking at every byte.
+ *
+ * @version 0.1
+ * @date 2025-01-09
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <csv-scan.h>
+#include <libcsv.h>
+
+/************************************************/
+/*             CSV_SCAN_SCALAR                  */
+/************************************************/
+
+size_t csv_scan_scalar(const char *data, size_t length, char delimiter,
+                       uint32_t *positions) {
+  size_t count = 0;
+
+  /* -- Branch free, the slot is overwritten unless the byte matches */
+  for (size_t i = 0; i < length; i++) {
+    char character = data[i];
+
+    positions[count] = i;
+    count += (character == delimiter) | (character == '"') |
+             (character == '\n');
+  }
+
+  return count;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/************************************************/
+/*             CSV_SCAN_SSE2                    */
+/************************************************/
+
+__attribute__((target("sse2"))) size_t
+csv_scan_sse2(const char *data, size_t length, char delimiter,
+              uint32_t *positions) {
+  const __m128i delimiters = _mm_set1_epi8(delimiter);
+  const __m128i quotes = _mm_set1_epi8('"');
+  const __m128i newlines = _mm_set1_epi8('\n');
+
+  size_t count = 0;
+  size_t i = 0;
+
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+
+    __m128i matches =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, delimiters),
+                                  _mm_cmpeq_epi8(block, quotes)),
+                     _mm_cmpeq_epi8(block, newlines));
+
+    unsigned mask = _mm_movemask_epi8(matches);
+
+    while (mask != 0) {
+      positions[count++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+
+  /* -- Tail */
+  size_t tail = csv_scan_scalar(data + i, length - i, delimiter,
+                                positions + count);
+
+  for (size_t j = count; j < count + tail; j++) {
+    positions[j] += i;
+  }
+
+  return count + tail;
+}
+
+/************************************************/
+/*             CSV_SCAN_AVX2                    */
+/************************************************/
+
+__attribute__((target("avx2"))) size_t
+csv_scan_avx2(const char *data, size_t length, char delimiter,
+              uint32_t *positions) {
+  const __m256i delimiters = _mm256_set1_epi8(delimiter);
+  const __m256i quotes = _mm256_set1_epi8('"');
+  const __m256i newlines = _mm256_set1_epi8('\n');
+
+  size_t count = 0;
+  size_t i = 0;
+
+  for (; i + 32 <= length; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(data + i));
+
+    __m256i matches =
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, delimiters),
+                                        _mm256_cmpeq_epi8(block, quotes)),
+                        _mm256_cmpeq_epi8(block, newlines));
+
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(matches);
+
+    while (mask != 0) {
+      positions[count++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+
+  /* -- Tail */
+  size_t tail = csv_scan_scalar(data + i, length - i, delimiter,
+                                positions + count);
+
+  for (size_t j = count; j < count + tail; j++) {
+    positions[j] += i;
+  }
+
+  return count + tail;
+}
+
+#endif
+
+/************************************************/
+/*             CSV_SCAN                         */
+/************************************************/
+
+size_t csv_scan(const char *data, size_t length, char delimiter,
+                uint32_t *positions) {
+#if defined(__x86_64__) || defined(__i386__)
+#ifndef CSV_NO_SIMD
+  if (__builtin_cpu_supports("avx2")) {
+    return csv_scan_avx2(data, length, delimiter, positions);
+  }
+
+  if (__builtin_cpu_supports("sse2")) {
+    return csv_scan_sse2(data, length, delimiter, positions);
+  }
+#endif
+#endif
+
+  return csv_scan_scalar(data, length, delimiter, positions);
+}
+
+/************************************************/
+/*             CSV_SCAN_RESET                   */
+/************************************************/
+
+int csv_scan_reset(CSV_SCANNER *scanner, const char *data, size_t length) {
+  if (length > UINT32_MAX) {
+    fprintf(stderr, "%s: Block is too large to index.\n", __func__);
+    return -1;
+  }
+
+  /* -- Worst case every byte is structural, plus one scratch slot */
+  if (length + 1 > scanner->capacity) {
+    uint32_t *positions =
+        realloc(scanner->positions, (length + 1) * sizeof(uint32_t));
+
+    if (positions == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
+
+    scanner->positions = positions;
+    scanner->capacity = length + 1;
+  }
+
+  scanner->data = data;
+  scanner->length = length;
+  scanner->count =
+      csv_scan(data, length, CSV_DELIMETER[0], scanner->positions);
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_SCAN_FREE                    */
+/************************************************/
+
+void csv_scan_free(CSV_SCANNER *scanner) {
+  free(scanner->positions);
+
+  memset(scanner, 0, sizeof(CSV_SCANNER));
+}
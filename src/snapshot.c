@@ -0,0 +1,1094 @@
+/**
+ * @file snapshot.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Binary columnar snapshots of a list
+ *
+ * A snapshot holds the columns of a list as they sit in memory, so loading
+ * one is a mapping, a few checks and copies instead of a parse. The file is
+ *
+ *   header | column table | column sections | strings
+ *
+ * Sections start on 8 bytes. A column has its data (numbers, string
+ * offsets or dictionary codes), string lengths or dictionary value lengths,
+ * dictionary value offsets and the null map, the sections it does not need
+ * are left out. Strings are NUL terminated and addressed from the start of
+ * the strings, a loaded list reads them straight from the mapping. The
+ * header and the column table, every column and the strings carry a
+ * checksum of their own. Numbers are stored in the byte order of the machine
+ * that wrote them, the header tells it apart.
+ *
+ * @version 0.1
+ * @date 2025-01-24
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <csv-arena.h>
+#include <csv-utils.h>
+#include <libcsv.h>
+#include <util.h>
+
+#define CSV_SNAPSHOT_MAGIC "LIBCSVSN"
+#define CSV_SNAPSHOT_BYTE_ORDER 0x0102030405060708ULL
+
+/* -- Rows gathered at a time when removed rows are skipped */
+#define CSV_SNAPSHOT_BLOCK 4096
+
+#define CSV_CHECKSUM_PRIME_1 0x9E3779B185EBCA87ULL
+#define CSV_CHECKSUM_PRIME_2 0xC2B2AE3D27D4EB4FULL
+
+/************ SNAPSHOT FORMAT ************/
+
+typedef struct csv_snapshot_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t byte_order;
+  uint64_t file_size;
+
+  uint64_t fields;
+  uint64_t items;
+
+  /* -- CSV file the list came from, source_size is UINT64_MAX without one */
+  uint64_t source_size;
+  int64_t source_seconds;
+  int64_t source_nanoseconds;
+
+  uint64_t strings_offset;
+  uint64_t strings_size;
+  uint64_t strings_checksum;
+
+  /* -- Of the header, this field zero, and the column table */
+  uint64_t checksum;
+} CSV_SNAPSHOT_HEADER;
+
+typedef struct csv_snapshot_column {
+  uint64_t name_offset;
+  uint64_t name_length;
+
+  uint32_t field_type;
+  uint32_t type_source;
+  uint32_t dictionary_mode;
+
+  /* -- 0 for a column without a dictionary */
+  uint32_t code_width;
+
+  uint64_t nulls;
+  uint64_t values;
+
+  /* -- File offsets of the sections, 0 when a section is left out. A
+   * column without data is all nulls. */
+  uint64_t data_offset;
+  uint64_t length_offset;
+  uint64_t value_offset;
+  uint64_t null_offset;
+
+  /* -- Of the sections in this order */
+  uint64_t checksum;
+} CSV_SNAPSHOT_COLUMN;
+
+/************ SNAPSHOT WRITER ************/
+
+typedef struct csv_checksum {
+  uint64_t lane[4];
+
+  /* -- Bytes short of a 32 byte stripe */
+  unsigned char tail[32];
+  size_t tail_length;
+
+  uint64_t total;
+} CSV_CHECKSUM;
+
+typedef struct csv_snapshot_writer {
+  CSV_WRITER csv_writer;
+  uint64_t position;
+
+  CSV_CHECKSUM checksum;
+
+  /* -- Next string offset, strings are written in the order offsets are
+   * handed out */
+  uint64_t strings_size;
+
+  /* -- Live rows, NULL when no row is removed */
+  const size_t *live;
+  size_t items;
+} CSV_SNAPSHOT_WRITER;
+
+/************************************************/
+/*             CSV_CHECKSUM_ROUND               */
+/************************************************/
+
+static uint64_t csv_checksum_round(uint64_t lane, uint64_t word) {
+  lane += word * CSV_CHECKSUM_PRIME_2;
+  lane = (lane << 31) | (lane >> 33);
+
+  return lane * CSV_CHECKSUM_PRIME_1;
+}
+
+/************************************************/
+/*             CSV_CHECKSUM_RESET               */
+/************************************************/
+
+static void csv_checksum_reset(CSV_CHECKSUM *checksum) {
+  memset(checksum, 0, sizeof(CSV_CHECKSUM));
+
+  checksum->lane[0] = CSV_CHECKSUM_PRIME_1 + CSV_CHECKSUM_PRIME_2;
+  checksum->lane[1] = CSV_CHECKSUM_PRIME_2;
+  checksum->lane[2] = 0;
+  checksum->lane[3] = 0 - CSV_CHECKSUM_PRIME_1;
+}
+
+/************************************************/
+/*             CSV_CHECKSUM_STRIPES             */
+/************************************************/
+
+static void csv_checksum_stripes(CSV_CHECKSUM *checksum,
+                                 const unsigned char *data, size_t stripes) {
+  uint64_t lane[4] = {checksum->lane[0], checksum->lane[1], checksum->lane[2],
+                      checksum->lane[3]};
+
+  for (size_t stripe = 0; stripe < stripes; stripe++, data += 32) {
+    uint64_t word[4];
+
+    memcpy(word, data, sizeof(word));
+
+    lane[0] = csv_checksum_round(lane[0], word[0]);
+    lane[1] = csv_checksum_round(lane[1], word[1]);
+    lane[2] = csv_checksum_round(lane[2], word[2]);
+    lane[3] = csv_checksum_round(lane[3], word[3]);
+  }
+
+  memcpy(checksum->lane, lane, sizeof(lane));
+}
+
+/************************************************/
+/*             CSV_CHECKSUM_UPDATE              */
+/************************************************/
+
+static void csv_checksum_update(CSV_CHECKSUM *checksum, const void *data,
+                                size_t length) {
+  const unsigned char *bytes = data;
+
+  checksum->total += length;
+
+  if (checksum->tail_length > 0) {
+    size_t fill = 32 - checksum->tail_length;
+
+    if (fill > length) {
+      fill = length;
+    }
+
+    memcpy(checksum->tail + checksum->tail_length, bytes, fill);
+    checksum->tail_length += fill;
+    bytes += fill;
+    length -= fill;
+
+    if (checksum->tail_length < 32) {
+      return;
+    }
+
+    csv_checksum_stripes(checksum, checksum->tail, 1);
+    checksum->tail_length = 0;
+  }
+
+  csv_checksum_stripes(checksum, bytes, length / 32);
+
+  memcpy(checksum->tail, bytes + length / 32 * 32, length % 32);
+  checksum->tail_length = length % 32;
+}
+
+/************************************************/
+/*             CSV_CHECKSUM_FINAL               */
+/************************************************/
+
+static uint64_t csv_checksum_final(const CSV_CHECKSUM *checksum) {
+  uint64_t hash = checksum->total;
+
+  for (unsigned i = 0; i < 4; i++) {
+    hash = csv_checksum_round(hash ^ csv_checksum_round(0, checksum->lane[i]),
+                              checksum->lane[i]);
+  }
+
+  for (size_t i = 0; i < checksum->tail_length; i++) {
+    hash = csv_checksum_round(hash, checksum->tail[i] + i);
+  }
+
+  hash ^= hash >> 33;
+  hash *= CSV_CHECKSUM_PRIME_2;
+
+  return hash ^ (hash >> 29);
+}
+
+/************************************************/
+/*             CSV_CHECKSUM                     */
+/************************************************/
+
+static uint64_t csv_checksum(const void *data, size_t length) {
+  CSV_CHECKSUM checksum;
+
+  csv_checksum_reset(&checksum);
+  csv_checksum_update(&checksum, data, length);
+
+  return csv_checksum_final(&checksum);
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_WRITE               */
+/************************************************/
+
+static void csv_snapshot_write(CSV_SNAPSHOT_WRITER *writer, const void *data,
+                               size_t length) {
+  csv_util_write(&writer->csv_writer, data, length);
+  csv_checksum_update(&writer->checksum, data, length);
+
+  writer->position += length;
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_ALIGN               */
+/************************************************/
+
+/* -- Sections start on 8 bytes, padding is not part of any checksum */
+static uint64_t csv_snapshot_align(CSV_SNAPSHOT_WRITER *writer) {
+  static const char padding[8] = {0};
+  size_t length = (8 - writer->position % 8) % 8;
+
+  csv_util_write(&writer->csv_writer, padding, length);
+  writer->position += length;
+
+  return writer->position;
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_ROWS                */
+/************************************************/
+
+/* -- Writes width bytes per live row, gathered by get a block at a time */
+static void csv_snapshot_rows(CSV_SNAPSHOT_WRITER *writer,
+                              CSV_FIELD_LIST *field_list, unsigned width,
+                              void (*get)(CSV_SNAPSHOT_WRITER *,
+                                          CSV_FIELD_LIST *, size_t, void *)) {
+  uint64_t block[CSV_SNAPSHOT_BLOCK];
+
+  for (size_t begin = 0; begin < writer->items; begin += CSV_SNAPSHOT_BLOCK) {
+    size_t end = begin + CSV_SNAPSHOT_BLOCK < writer->items
+                     ? begin + CSV_SNAPSHOT_BLOCK
+                     : writer->items;
+    unsigned char *cell = (unsigned char *)block;
+
+    for (size_t i = begin; i < end; i++, cell += width) {
+      get(writer, field_list, writer->live != NULL ? writer->live[i] : i,
+          cell);
+    }
+
+    csv_snapshot_write(writer, block, (end - begin) * width);
+  }
+}
+
+static void csv_snapshot_number(CSV_SNAPSHOT_WRITER *writer,
+                                CSV_FIELD_LIST *field_list, size_t row,
+                                void *cell) {
+  memcpy(cell, &field_list->int_data[row], 8);
+}
+
+static void csv_snapshot_offset(CSV_SNAPSHOT_WRITER *writer,
+                                CSV_FIELD_LIST *field_list, size_t row,
+                                void *cell) {
+  uint64_t offset = writer->strings_size;
+
+  memcpy(cell, &offset, 8);
+  writer->strings_size += field_list->char_length[row] + 1;
+}
+
+static void csv_snapshot_length(CSV_SNAPSHOT_WRITER *writer,
+                                CSV_FIELD_LIST *field_list, size_t row,
+                                void *cell) {
+  memcpy(cell, &field_list->char_length[row], 4);
+}
+
+static void csv_snapshot_code(CSV_SNAPSHOT_WRITER *writer,
+                              CSV_FIELD_LIST *field_list, size_t row,
+                              void *cell) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+
+  memcpy(cell, (const char *)dictionary->codes + row * dictionary->code_width,
+         dictionary->code_width);
+}
+
+static void csv_snapshot_null(CSV_SNAPSHOT_WRITER *writer,
+                              CSV_FIELD_LIST *field_list, size_t row,
+                              void *cell) {
+  *(uint8_t *)cell = field_list->null_data[row];
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_LIVE_NULLS          */
+/************************************************/
+
+static size_t csv_snapshot_live_nulls(CSV_SNAPSHOT_WRITER *writer,
+                                      CSV_FIELD_LIST *field_list) {
+  if (field_list->capacity == 0) {
+    return writer->items;
+  }
+
+  if (field_list->null_data == NULL) {
+    return 0;
+  }
+
+  size_t nulls = 0;
+
+  for (size_t i = 0; i < writer->items; i++) {
+    nulls += field_list->null_data[writer->live != NULL ? writer->live[i] : i];
+  }
+
+  return nulls;
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_SECTIONS            */
+/************************************************/
+
+static void csv_snapshot_sections(CSV_SNAPSHOT_WRITER *writer,
+                                  CSV_FIELD_LIST *field_list,
+                                  CSV_SNAPSHOT_COLUMN *column) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+
+  column->field_type = field_list->field_type;
+  column->type_source = field_list->type_source;
+  column->dictionary_mode = field_list->dictionary_mode;
+  column->nulls = csv_snapshot_live_nulls(writer, field_list);
+
+  /* -- Columns of nulls are left without storage */
+  if (column->nulls == writer->items) {
+    return;
+  }
+
+  csv_checksum_reset(&writer->checksum);
+
+  column->data_offset = csv_snapshot_align(writer);
+
+  if (dictionary != NULL) {
+    column->code_width = dictionary->code_width;
+    column->values = dictionary->values;
+
+    csv_snapshot_rows(writer, field_list, dictionary->code_width,
+                      csv_snapshot_code);
+
+    column->length_offset = csv_snapshot_align(writer);
+    csv_snapshot_write(writer, dictionary->value_length,
+                       dictionary->values * sizeof(uint32_t));
+
+    column->value_offset = csv_snapshot_align(writer);
+
+    for (uint32_t code = 0; code < dictionary->values; code++) {
+      uint64_t offset = writer->strings_size;
+
+      csv_snapshot_write(writer, &offset, sizeof(offset));
+      writer->strings_size += dictionary->value_length[code] + 1;
+    }
+  } else if (field_list->field_type == CHAR_TYPE) {
+    csv_snapshot_rows(writer, field_list, 8, csv_snapshot_offset);
+
+    column->length_offset = csv_snapshot_align(writer);
+    csv_snapshot_rows(writer, field_list, 4, csv_snapshot_length);
+  } else {
+    csv_snapshot_rows(writer, field_list, 8, csv_snapshot_number);
+  }
+
+  if (field_list->null_data != NULL && column->nulls > 0) {
+    column->null_offset = csv_snapshot_align(writer);
+    csv_snapshot_rows(writer, field_list, 1, csv_snapshot_null);
+  }
+
+  column->checksum = csv_checksum_final(&writer->checksum);
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_STRINGS             */
+/************************************************/
+
+/* -- Same order the offsets were handed out in */
+static void csv_snapshot_strings(CSV_SNAPSHOT_WRITER *writer,
+                                 CSV_LIST *csv_list, CSV_METADATA *metadata,
+                                 const CSV_SNAPSHOT_COLUMN *columns) {
+  for (unsigned i = 0; i < metadata->fields; i++) {
+    const char *field = csv_list->field_list[i]->field;
+
+    csv_snapshot_write(writer, field, strlen(field) + 1);
+  }
+
+  for (unsigned i = 0; i < metadata->fields; i++) {
+    CSV_FIELD_LIST *field_list = csv_list->field_list[i];
+    CSV_DICTIONARY *dictionary = field_list->dictionary;
+
+    if (columns[i].data_offset == 0 || field_list->field_type != CHAR_TYPE) {
+      continue;
+    }
+
+    if (dictionary != NULL) {
+      for (uint32_t code = 0; code < dictionary->values; code++) {
+        size_t length = 0;
+        char *string = csv_code_string(field_list, code, &length);
+
+        csv_snapshot_write(writer, string, length);
+        csv_snapshot_write(writer, "", 1);
+      }
+
+      continue;
+    }
+
+    for (size_t j = 0; j < writer->items; j++) {
+      size_t row = writer->live != NULL ? writer->live[j] : j;
+      size_t length = 0;
+      char *string = csv_util_char(field_list, row, &length);
+
+      csv_snapshot_write(writer, string, length);
+      csv_snapshot_write(writer, "", 1);
+    }
+  }
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_FILE                */
+/************************************************/
+
+static int csv_snapshot_file(CSV_SNAPSHOT_WRITER *writer, CSV_LIST *csv_list,
+                             CSV_METADATA *metadata,
+                             CSV_SNAPSHOT_HEADER *header,
+                             CSV_SNAPSHOT_COLUMN *columns) {
+  size_t table_size = metadata->fields * sizeof(CSV_SNAPSHOT_COLUMN);
+  CSV_SNAPSHOT_HEADER placeholder = {0};
+
+  /* -- Header and column table are written again once they are known */
+  csv_util_write(&writer->csv_writer, (const char *)&placeholder,
+                 sizeof(CSV_SNAPSHOT_HEADER));
+  csv_util_write(&writer->csv_writer, (const char *)columns, table_size);
+  writer->position = sizeof(CSV_SNAPSHOT_HEADER) + table_size;
+
+  /* -- Field names come first in the strings */
+  for (unsigned i = 0; i < metadata->fields; i++) {
+    columns[i].name_offset = writer->strings_size;
+    columns[i].name_length = strlen(csv_list->field_list[i]->field);
+    writer->strings_size += columns[i].name_length + 1;
+  }
+
+  for (unsigned i = 0; i < metadata->fields; i++) {
+    csv_snapshot_sections(writer, csv_list->field_list[i], &columns[i]);
+  }
+
+  csv_checksum_reset(&writer->checksum);
+
+  header->strings_offset = csv_snapshot_align(writer);
+  header->strings_size = writer->strings_size;
+
+  csv_snapshot_strings(writer, csv_list, metadata, columns);
+
+  header->strings_checksum = csv_checksum_final(&writer->checksum);
+  header->file_size = writer->position;
+
+  memcpy(header->magic, CSV_SNAPSHOT_MAGIC, sizeof(header->magic));
+  header->version = CSV_SNAPSHOT_VERSION;
+  header->header_size = sizeof(CSV_SNAPSHOT_HEADER);
+  header->byte_order = CSV_SNAPSHOT_BYTE_ORDER;
+  header->fields = metadata->fields;
+  header->items = writer->items;
+
+  CSV_CHECKSUM checksum;
+
+  csv_checksum_reset(&checksum);
+  csv_checksum_update(&checksum, header, sizeof(CSV_SNAPSHOT_HEADER));
+  csv_checksum_update(&checksum, columns, table_size);
+
+  header->checksum = csv_checksum_final(&checksum);
+
+  if (csv_util_flush(&writer->csv_writer) != 0 ||
+      fseek(writer->csv_writer.stream, 0, SEEK_SET) != 0 ||
+      fwrite(header, sizeof(CSV_SNAPSHOT_HEADER), 1,
+             writer->csv_writer.stream) != 1 ||
+      (table_size > 0 &&
+       fwrite(columns, table_size, 1, writer->csv_writer.stream) != 1)) {
+    return -1;
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_UTIL_SNAPSHOT_WRITE          */
+/************************************************/
+
+int csv_util_snapshot_write(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                            const char *snapshot_file,
+                            const struct stat *source) {
+  CSV_TOMBSTONES *tombstones = &csv_list->tombstones;
+
+  CSV_SNAPSHOT_WRITER writer = {0};
+  CSV_SNAPSHOT_HEADER header = {0};
+
+  size_t *live = NULL;
+
+  writer.items = metadata->items - tombstones->dead;
+
+  if (tombstones->dead > 0) {
+    live = malloc((writer.items + 1) * sizeof(size_t));
+
+    if (live == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
+
+    size_t total = 0;
+
+    for (size_t row = 0; row < metadata->items; row++) {
+      if (!csv_util_row_dead(tombstones, row)) {
+        live[total++] = row;
+      }
+    }
+
+    writer.live = live;
+  }
+
+  /* -- Written next to the snapshot and renamed, readers never see half a
+   * file */
+  size_t length = strlen(snapshot_file) + 5;
+  char *temporary = malloc(length);
+
+  CSV_SNAPSHOT_COLUMN *columns =
+      calloc(metadata->fields + 1, sizeof(CSV_SNAPSHOT_COLUMN));
+
+  writer.csv_writer.size = CSV_OUTPUT_BUFFER_SIZE;
+  writer.csv_writer.buffer = malloc(CSV_OUTPUT_BUFFER_SIZE);
+
+  if (temporary == NULL || columns == NULL ||
+      writer.csv_writer.buffer == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    free(live);
+    free(temporary);
+    free(columns);
+    free(writer.csv_writer.buffer);
+    return -1;
+  }
+
+  snprintf(temporary, length, "%s.tmp", snapshot_file);
+
+  writer.csv_writer.stream = fopen(temporary, "wb");
+
+  int status = -1;
+
+  if (writer.csv_writer.stream == NULL) {
+    fprintf(stderr, "%s: Unable to open %s.\n", __func__, temporary);
+  } else {
+    header.source_size = UINT64_MAX;
+
+    if (source != NULL) {
+      header.source_size = source->st_size;
+      header.source_seconds = source->st_mtim.tv_sec;
+      header.source_nanoseconds = source->st_mtim.tv_nsec;
+    }
+
+    status = csv_snapshot_file(&writer, csv_list, metadata, &header, columns);
+
+    if (fclose(writer.csv_writer.stream) != 0 || writer.csv_writer.error) {
+      status = -1;
+    }
+
+    if (status == 0 && rename(temporary, snapshot_file) != 0) {
+      status = -1;
+    }
+
+    if (status != 0) {
+      fprintf(stderr, "%s: Failed to write %s.\n", __func__, snapshot_file);
+      remove(temporary);
+    }
+  }
+
+  free(live);
+  free(temporary);
+  free(columns);
+  free(writer.csv_writer.buffer);
+
+  return status;
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_SAVE                */
+/************************************************/
+
+int csv_snapshot_save(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                      const char *snapshot_file, const char *csv_file) {
+  if (csv_list == NULL || metadata == NULL || snapshot_file == NULL) {
+    fprintf(stderr, "%s: csv_list, metadata or snapshot_file is NULL.\n",
+            __func__);
+    return -1;
+  }
+
+  struct stat source;
+
+  if (csv_file != NULL && stat(csv_file, &source) != 0) {
+    fprintf(stderr, "%s: Unable to stat %s.\n", __func__, csv_file);
+    return -1;
+  }
+
+  return csv_util_snapshot_write(csv_list, metadata, snapshot_file,
+                                 csv_file != NULL ? &source : NULL);
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_HEADER              */
+/************************************************/
+
+static bool csv_snapshot_header(const CSV_SNAPSHOT_HEADER *header,
+                                size_t size) {
+  return memcmp(header->magic, CSV_SNAPSHOT_MAGIC, sizeof(header->magic)) ==
+             0 &&
+         header->version == CSV_SNAPSHOT_VERSION &&
+         header->header_size == sizeof(CSV_SNAPSHOT_HEADER) &&
+         header->byte_order == CSV_SNAPSHOT_BYTE_ORDER &&
+         header->file_size == size;
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_SECTION             */
+/************************************************/
+
+/* -- A section of length bytes lies between the column table and the
+ * strings */
+static bool csv_snapshot_section(const CSV_SNAPSHOT_HEADER *header,
+                                 uint64_t offset, uint64_t length) {
+  uint64_t begin = sizeof(CSV_SNAPSHOT_HEADER) +
+                   header->fields * sizeof(CSV_SNAPSHOT_COLUMN);
+
+  return offset >= begin && offset % 8 == 0 &&
+         offset <= header->strings_offset &&
+         length <= header->strings_offset - offset;
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_STRINGS_CHECK       */
+/************************************************/
+
+/* -- Every string ends inside the strings, on its NUL */
+static bool csv_snapshot_strings_check(const CSV_SNAPSHOT_HEADER *header,
+                                       const char *strings,
+                                       const uint64_t *offset,
+                                       const uint32_t *length, size_t total) {
+  for (size_t i = 0; i < total; i++) {
+    if (offset[i] >= header->strings_size ||
+        length[i] >= header->strings_size - offset[i] ||
+        strings[offset[i] + length[i]] != '\0') {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_COLUMN_CHECK        */
+/************************************************/
+
+static bool csv_snapshot_column_check(const CSV_SNAPSHOT_HEADER *header,
+                                      const char *data,
+                                      const CSV_SNAPSHOT_COLUMN *column) {
+  uint64_t items = header->items;
+  const char *strings = data + header->strings_offset;
+
+  if (column->field_type > DOUBLE_TYPE ||
+      column->type_source > CSV_TYPE_DECLARED ||
+      column->dictionary_mode > CSV_DICTIONARY_ALWAYS ||
+      column->nulls > items || column->name_offset >= header->strings_size ||
+      column->name_length >= header->strings_size - column->name_offset ||
+      strings[column->name_offset + column->name_length] != '\0') {
+    return false;
+  }
+
+  if (column->data_offset == 0) {
+    return column->nulls == items;
+  }
+
+  CSV_CHECKSUM checksum;
+
+  csv_checksum_reset(&checksum);
+
+  if (column->code_width != 0) {
+    uint32_t width = column->code_width;
+    uint64_t values = column->values;
+
+    if (column->field_type != CHAR_TYPE ||
+        (width != 1 && width != 2 && width != 4) || values == 0 ||
+        values > (width == 4 ? CSV_NO_CODE : 1ULL << (width * 8)) ||
+        !csv_snapshot_section(header, column->data_offset, items * width) ||
+        !csv_snapshot_section(header, column->length_offset, values * 4) ||
+        !csv_snapshot_section(header, column->value_offset, values * 8)) {
+      return false;
+    }
+
+    csv_checksum_update(&checksum, data + column->data_offset, items * width);
+    csv_checksum_update(&checksum, data + column->length_offset, values * 4);
+    csv_checksum_update(&checksum, data + column->value_offset, values * 8);
+  } else if (column->field_type == CHAR_TYPE) {
+    if (!csv_snapshot_section(header, column->data_offset, items * 8) ||
+        !csv_snapshot_section(header, column->length_offset, items * 4)) {
+      return false;
+    }
+
+    csv_checksum_update(&checksum, data + column->data_offset, items * 8);
+    csv_checksum_update(&checksum, data + column->length_offset, items * 4);
+  } else {
+    if (!csv_snapshot_section(header, column->data_offset, items * 8)) {
+      return false;
+    }
+
+    csv_checksum_update(&checksum, data + column->data_offset, items * 8);
+  }
+
+  if (column->null_offset != 0) {
+    if (!csv_snapshot_section(header, column->null_offset, items)) {
+      return false;
+    }
+
+    csv_checksum_update(&checksum, data + column->null_offset, items);
+  }
+
+  return csv_checksum_final(&checksum) == column->checksum;
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_DICTIONARY          */
+/************************************************/
+
+static int csv_snapshot_dictionary(CSV_FIELD_LIST *field_list,
+                                   const CSV_SNAPSHOT_HEADER *header,
+                                   const char *data,
+                                   const CSV_SNAPSHOT_COLUMN *column) {
+  CSV_DICTIONARY *dictionary = field_list->dictionary;
+  CSV_ALLOCATOR *allocator = field_list->allocator;
+
+  size_t items = header->items;
+  uint32_t values = column->values;
+
+  const uint32_t *value_length =
+      (const uint32_t *)(data + column->length_offset);
+  const uint64_t *value_offset =
+      (const uint64_t *)(data + column->value_offset);
+
+  if (!csv_snapshot_strings_check(header, data + header->strings_offset,
+                                  value_offset, value_length, values)) {
+    return -1;
+  }
+
+  memcpy(dictionary->codes, data + column->data_offset,
+         items * dictionary->code_width);
+
+  for (size_t row = 0; row < items; row++) {
+    if (csv_util_dictionary_code(dictionary, row) >= values) {
+      return -1;
+    }
+  }
+
+  dictionary->value_offset =
+      csv_alloc_resize(allocator, NULL, 0, values * sizeof(size_t));
+  dictionary->value_length =
+      csv_alloc_resize(allocator, NULL, 0, values * sizeof(uint32_t));
+
+  if (dictionary->value_offset == NULL || dictionary->value_length == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return -1;
+  }
+
+  dictionary->value_capacity = values;
+  dictionary->values = values;
+
+  /* -- The mapping starts at the header, strings sit further in */
+  for (uint32_t code = 0; code < values; code++) {
+    dictionary->value_offset[code] =
+        header->strings_offset + value_offset[code];
+  }
+
+  memcpy(dictionary->value_length, value_length, values * sizeof(uint32_t));
+
+  return csv_util_dictionary_index(field_list);
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_FIELD               */
+/************************************************/
+
+static int csv_snapshot_field(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                              const CSV_SNAPSHOT_HEADER *header,
+                              const char *data,
+                              const CSV_SNAPSHOT_COLUMN *column) {
+  const char *strings = data + header->strings_offset;
+
+  if (csv_util_add_field(csv_list, metadata, strings + column->name_offset) !=
+      0) {
+    return -1;
+  }
+
+  CSV_FIELD_LIST *field_list = csv_list->field_list[metadata->fields - 1];
+  size_t items = header->items;
+
+  csv_util_promote(field_list, column->field_type);
+  field_list->type_source = column->type_source;
+
+  /* -- All nulls, nothing stored until a value shows up */
+  if (column->data_offset == 0) {
+    field_list->dictionary_mode = column->dictionary_mode;
+    field_list->rows = items;
+    field_list->nulls = items;
+    return 0;
+  }
+
+  /* -- Storage is reserved in the encoding the column was saved in */
+  if (column->code_width != 0) {
+    if (csv_util_dictionary_create(field_list) != 0) {
+      return -1;
+    }
+
+    field_list->dictionary->code_width = column->code_width;
+  } else {
+    field_list->dictionary_mode = CSV_DICTIONARY_OFF;
+  }
+
+  int status = csv_util_reserve(field_list, items);
+
+  field_list->dictionary_mode = column->dictionary_mode;
+
+  if (status != 0) {
+    return -1;
+  }
+
+  if (column->null_offset != 0) {
+    field_list->null_data = csv_alloc_resize(field_list->allocator, NULL, 0,
+                                             field_list->capacity);
+
+    if (field_list->null_data == NULL) {
+      fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+      return -1;
+    }
+
+    memcpy(field_list->null_data, data + column->null_offset, items);
+    memset(field_list->null_data + items, 0, field_list->capacity - items);
+  }
+
+  if (column->code_width != 0) {
+    status = csv_snapshot_dictionary(field_list, header, data, column);
+  } else if (column->field_type == CHAR_TYPE) {
+    const uint64_t *char_offset =
+        (const uint64_t *)(data + column->data_offset);
+    const uint32_t *char_length =
+        (const uint32_t *)(data + column->length_offset);
+
+    if (!csv_snapshot_strings_check(header, strings, char_offset, char_length,
+                                    items)) {
+      return -1;
+    }
+
+    for (size_t row = 0; row < items; row++) {
+      field_list->char_offset[row] = header->strings_offset + char_offset[row];
+    }
+
+    memcpy(field_list->char_length, char_length, items * sizeof(uint32_t));
+  } else {
+    memcpy(field_list->int_data, data + column->data_offset, items * 8);
+  }
+
+  field_list->rows = items;
+  field_list->nulls = column->nulls;
+
+  return status;
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_CHECK               */
+/************************************************/
+
+static bool csv_snapshot_check(const char *data, size_t size) {
+  CSV_SNAPSHOT_HEADER header;
+
+  if (size < sizeof(CSV_SNAPSHOT_HEADER)) {
+    return false;
+  }
+
+  memcpy(&header, data, sizeof(CSV_SNAPSHOT_HEADER));
+
+  if (!csv_snapshot_header(&header, size) || header.fields > UINT_MAX ||
+      header.items > UINT_MAX ||
+      header.fields > (size - sizeof(CSV_SNAPSHOT_HEADER)) /
+                          sizeof(CSV_SNAPSHOT_COLUMN)) {
+    return false;
+  }
+
+  size_t table_size = header.fields * sizeof(CSV_SNAPSHOT_COLUMN);
+  uint64_t checksum = header.checksum;
+
+  header.checksum = 0;
+
+  CSV_CHECKSUM table;
+
+  csv_checksum_reset(&table);
+  csv_checksum_update(&table, &header, sizeof(CSV_SNAPSHOT_HEADER));
+  csv_checksum_update(&table, data + sizeof(CSV_SNAPSHOT_HEADER), table_size);
+
+  if (csv_checksum_final(&table) != checksum ||
+      header.strings_offset < sizeof(CSV_SNAPSHOT_HEADER) + table_size ||
+      header.strings_offset > size ||
+      header.strings_size != size - header.strings_offset) {
+    return false;
+  }
+
+  return csv_checksum(data + header.strings_offset, header.strings_size) ==
+         header.strings_checksum;
+}
+
+/************************************************/
+/*             CSV_SNAPSHOT_LOAD                */
+/************************************************/
+
+CSV_LIST *csv_snapshot_load(const char *snapshot_file, CSV_METADATA **metadata,
+                            CSV_OPTIONS *options) {
+  if (snapshot_file == NULL || metadata == NULL) {
+    return NULL;
+  }
+
+  CSV_OPTIONS defaults = {0};
+
+  if (options == NULL) {
+    options = &defaults;
+  }
+
+  const char *data = NULL;
+  size_t size = 0;
+
+  if (csv_util_map_file(snapshot_file, &data, &size) != 0) {
+    fprintf(stderr, "%s: Unable to open %s.\n", __func__, snapshot_file);
+    return NULL;
+  }
+
+  if (data == NULL || !csv_snapshot_check(data, size)) {
+    fprintf(stderr, "%s: %s is not a valid snapshot.\n", __func__,
+            snapshot_file);
+
+    if (data != NULL) {
+      munmap((void *)data, size);
+    }
+
+    return NULL;
+  }
+
+  CSV_LIST *csv_list = csv_arena_list(options->allocator, metadata);
+
+  if (csv_list == NULL) {
+    munmap((void *)data, size);
+    return NULL;
+  }
+
+  /* -- Strings are read from the mapping, it lives until csv_clear() */
+  csv_list->string_pool.mapped_data = data;
+  csv_list->string_pool.mapped_size = size;
+
+  csv_util_prepare(csv_list, options);
+  csv_util_end_import(csv_list);
+
+  CSV_SNAPSHOT_HEADER header;
+
+  memcpy(&header, data, sizeof(CSV_SNAPSHOT_HEADER));
+
+  const CSV_SNAPSHOT_COLUMN *columns =
+      (const CSV_SNAPSHOT_COLUMN *)(data + sizeof(CSV_SNAPSHOT_HEADER));
+
+  int status = csv_util_reserve_fields(csv_list, *metadata, header.fields);
+
+  for (unsigned i = 0; status == 0 && i < header.fields; i++) {
+    if (!csv_snapshot_column_check(&header, data, &columns[i]) ||
+        csv_snapshot_field(csv_list, *metadata, &header, data, &columns[i]) !=
+            0) {
+      fprintf(stderr, "%s: Column %u of %s is damaged.\n", __func__, i,
+              snapshot_file);
+      status = -1;
+    }
+  }
+
+  if (status != 0) {
+    csv_clear(csv_list, *metadata);
+    return NULL;
+  }
+
+  (*metadata)->items = header.items;
+
+  return csv_list;
+}
+
+/************************************************/
+/*             CSV_UTIL_SNAPSHOT_FRESH          */
+/************************************************/
+
+/* -- The snapshot was written from a source of this size and mtime */
+static bool csv_util_snapshot_fresh(const char *snapshot_file,
+                                    const struct stat *source) {
+  FILE *snapshot_stream = fopen(snapshot_file, "rb");
+
+  if (snapshot_stream == NULL) {
+    return false;
+  }
+
+  CSV_SNAPSHOT_HEADER header;
+  struct stat snapshot_stat;
+
+  bool fresh =
+      fread(&header, sizeof(CSV_SNAPSHOT_HEADER), 1, snapshot_stream) == 1 &&
+      fstat(fileno(snapshot_stream), &snapshot_stat) == 0 &&
+      csv_snapshot_header(&header, snapshot_stat.st_size) &&
+      header.source_size == (uint64_t)source->st_size &&
+      header.source_seconds == source->st_mtim.tv_sec &&
+      header.source_nanoseconds == source->st_mtim.tv_nsec;
+
+  fclose(snapshot_stream);
+
+  return fresh;
+}
+
+/************************************************/
+/*             CSV_UTIL_IMPORT_CACHED           */
+/************************************************/
+
+CSV_LIST *csv_util_import_cached(char *csv_file, CSV_METADATA **metadata,
+                                 CSV_OPTIONS *options) {
+  struct stat source;
+
+  CSV_OPTIONS import = *options;
+
+  import.snapshot = NULL;
+
+  /* -- Taken before the import, a file changing meanwhile is not cached */
+  if (stat(csv_file, &source) != 0) {
+    return csv_import_ex(csv_file, metadata, &import);
+  }
+
+  if (csv_util_snapshot_fresh(options->snapshot, &source)) {
+    CSV_LIST *csv_list =
+        csv_snapshot_load(options->snapshot, metadata, &import);
+
+    if (csv_list != NULL) {
+      return csv_list;
+    }
+  }
+
+  CSV_LIST *csv_list = csv_import_ex(csv_file, metadata, &import);
+
+  if (csv_list != NULL) {
+    csv_util_snapshot_write(csv_list, *metadata, options->snapshot, &source);
+  }
+
+  return csv_list;
+}
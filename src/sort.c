@@ -0,0 +1,686 @@
+/**
+ * @file sort.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Sorting rows of a list
+ *
+ * A sort computes a permutation of the live rows and leaves the columns
+ * alone. Keys are sorted one at a time from the last to the first with a
+ * stable sort, so earlier keys decide and later keys break ties. Every cell
+ * of a key is turned into a 64 bit word that orders like the cell: integers
+ * and doubles with their sign flipped, dictionary strings by the rank of
+ * their value, plain strings by their first 8 bytes. The words are sorted
+ * with an LSD radix sort, in chunks on several threads and merged when the
+ * list is large. Plain strings with the same first 8 bytes are then ordered
+ * by a merge sort on the whole string.
+ *
+ * @version 0.1
+ * @date 2025-01-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <csv-utils.h>
+#include <libcsv.h>
+
+#define CSV_SORT_SIGN 0x8000000000000000ULL
+#define CSV_SORT_INSERTION 16
+
+/************ SORT BUFFERS ************/
+
+typedef struct csv_sort_context {
+  /* -- Rows in their current order and the key word of each */
+  size_t *rows;
+  uint64_t *keys;
+
+  /* -- Same size, the other side of every radix pass and merge */
+  size_t *row_buffer;
+  uint64_t *key_buffer;
+
+  size_t length;
+  unsigned threads;
+} CSV_SORT_CONTEXT;
+
+typedef struct csv_sort_task {
+  uint64_t *keys;
+  size_t *rows;
+  uint64_t *key_buffer;
+  size_t *row_buffer;
+
+  /* -- A run to sort, or two runs [begin, middle) and [middle, end) */
+  size_t begin;
+  size_t middle;
+  size_t end;
+} CSV_SORT_TASK;
+
+typedef struct csv_sort_strings {
+  CSV_FIELD_LIST *field_list;
+
+  /* -- Items are dictionary codes instead of rows */
+  bool by_code;
+  bool descending;
+} CSV_SORT_STRINGS;
+
+/************************************************/
+/*             CSV_SORT_RADIX                   */
+/************************************************/
+
+static void csv_sort_radix(uint64_t *keys, size_t *rows, uint64_t *key_buffer,
+                           size_t *row_buffer, size_t length) {
+  size_t count[8][256];
+
+  memset(count, 0, sizeof(count));
+
+  /* -- Counts of every digit in one pass */
+  for (size_t i = 0; i < length; i++) {
+    uint64_t key = keys[i];
+
+    for (unsigned digit = 0; digit < 8; digit++) {
+      count[digit][(key >> (digit * 8)) & 0xFF]++;
+    }
+  }
+
+  uint64_t *source_keys = keys;
+  size_t *source_rows = rows;
+  uint64_t *target_keys = key_buffer;
+  size_t *target_rows = row_buffer;
+
+  for (unsigned digit = 0; digit < 8 && length > 1; digit++) {
+    unsigned shift = digit * 8;
+
+    /* -- Every key has the same digit, the pass would not move anything */
+    if (count[digit][(source_keys[0] >> shift) & 0xFF] == length) {
+      continue;
+    }
+
+    size_t position = 0;
+
+    for (unsigned bucket = 0; bucket < 256; bucket++) {
+      size_t total = count[digit][bucket];
+
+      count[digit][bucket] = position;
+      position += total;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+      size_t slot = count[digit][(source_keys[i] >> shift) & 0xFF]++;
+
+      target_keys[slot] = source_keys[i];
+      target_rows[slot] = source_rows[i];
+    }
+
+    uint64_t *swap_keys = source_keys;
+    size_t *swap_rows = source_rows;
+
+    source_keys = target_keys;
+    source_rows = target_rows;
+    target_keys = swap_keys;
+    target_rows = swap_rows;
+  }
+
+  if (source_keys != keys) {
+    memcpy(keys, source_keys, length * sizeof(uint64_t));
+    memcpy(rows, source_rows, length * sizeof(size_t));
+  }
+}
+
+/************************************************/
+/*             CSV_SORT_RADIX_TASK              */
+/************************************************/
+
+static void *csv_sort_radix_task(void *argument) {
+  CSV_SORT_TASK *task = argument;
+  size_t begin = task->begin;
+
+  csv_sort_radix(task->keys + begin, task->rows + begin,
+                 task->key_buffer + begin, task->row_buffer + begin,
+                 task->end - begin);
+
+  return NULL;
+}
+
+/************************************************/
+/*             CSV_SORT_MERGE_TASK              */
+/************************************************/
+
+/* -- Merges two sorted runs of keys into key_buffer, left first on ties */
+static void *csv_sort_merge_task(void *argument) {
+  CSV_SORT_TASK *task = argument;
+
+  size_t left = task->begin;
+  size_t right = task->middle;
+  size_t target = task->begin;
+
+  while (left < task->middle && right < task->end) {
+    if (task->keys[right] < task->keys[left]) {
+      task->key_buffer[target] = task->keys[right];
+      task->row_buffer[target++] = task->rows[right++];
+    } else {
+      task->key_buffer[target] = task->keys[left];
+      task->row_buffer[target++] = task->rows[left++];
+    }
+  }
+
+  for (; left < task->middle; left++, target++) {
+    task->key_buffer[target] = task->keys[left];
+    task->row_buffer[target] = task->rows[left];
+  }
+
+  for (; right < task->end; right++, target++) {
+    task->key_buffer[target] = task->keys[right];
+    task->row_buffer[target] = task->rows[right];
+  }
+
+  return NULL;
+}
+
+/************************************************/
+/*             CSV_SORT_SPAWN                   */
+/************************************************/
+
+/* -- Runs every task on a thread of its own, the first on this thread */
+static void csv_sort_spawn(void *(*function)(void *), CSV_SORT_TASK *tasks,
+                           unsigned total_tasks) {
+  pthread_t thread[total_tasks];
+  bool started[total_tasks];
+
+  for (unsigned t = 1; t < total_tasks; t++) {
+    started[t] = pthread_create(&thread[t], NULL, function, &tasks[t]) == 0;
+  }
+
+  started[0] = false;
+
+  for (unsigned t = 0; t < total_tasks; t++) {
+    if (!started[t]) {
+      function(&tasks[t]);
+    }
+  }
+
+  for (unsigned t = 1; t < total_tasks; t++) {
+    if (started[t]) {
+      pthread_join(thread[t], NULL);
+    }
+  }
+}
+
+/************************************************/
+/*             CSV_SORT_WORDS                   */
+/************************************************/
+
+/* -- Stable sort of length rows by key, from offset in the context */
+static void csv_sort_words(CSV_SORT_CONTEXT *context, size_t offset,
+                           size_t length) {
+  uint64_t *keys = context->keys + offset;
+  size_t *rows = context->rows + offset;
+  uint64_t *key_buffer = context->key_buffer + offset;
+  size_t *row_buffer = context->row_buffer + offset;
+
+  unsigned chunks = context->threads ? context->threads : 1;
+
+  if (length / CSV_SORT_ROWS < chunks) {
+    chunks = length / CSV_SORT_ROWS ? length / CSV_SORT_ROWS : 1;
+  }
+
+  if (chunks == 1) {
+    csv_sort_radix(keys, rows, key_buffer, row_buffer, length);
+    return;
+  }
+
+  CSV_SORT_TASK tasks[chunks];
+  size_t bounds[chunks + 1];
+
+  for (unsigned c = 0; c <= chunks; c++) {
+    bounds[c] = c < chunks ? length / chunks * c : length;
+  }
+
+  for (unsigned c = 0; c < chunks; c++) {
+    tasks[c] = (CSV_SORT_TASK){keys,      rows,      key_buffer,
+                               row_buffer, bounds[c], bounds[c],
+                               bounds[c + 1]};
+  }
+
+  csv_sort_spawn(csv_sort_radix_task, tasks, chunks);
+
+  /* -- Neighbouring runs are merged pairwise until one is left */
+  unsigned runs = chunks;
+
+  while (runs > 1) {
+    unsigned merges = runs / 2;
+
+    for (unsigned m = 0; m < merges; m++) {
+      tasks[m] = (CSV_SORT_TASK){keys,          rows,
+                                 key_buffer,    row_buffer,
+                                 bounds[2 * m], bounds[2 * m + 1],
+                                 bounds[2 * m + 2]};
+    }
+
+    csv_sort_spawn(csv_sort_merge_task, tasks, merges);
+
+    /* -- An odd run out is carried over as it is */
+    if (runs % 2) {
+      size_t begin = bounds[runs - 1];
+
+      memcpy(key_buffer + begin, keys + begin,
+             (length - begin) * sizeof(uint64_t));
+      memcpy(row_buffer + begin, rows + begin,
+             (length - begin) * sizeof(size_t));
+    }
+
+    for (unsigned m = 0; m < merges; m++) {
+      bounds[m] = bounds[2 * m];
+    }
+
+    if (runs % 2) {
+      bounds[merges] = bounds[runs - 1];
+    }
+
+    runs = merges + runs % 2;
+    bounds[runs] = length;
+
+    uint64_t *swap_keys = keys;
+    size_t *swap_rows = rows;
+
+    keys = key_buffer;
+    rows = row_buffer;
+    key_buffer = swap_keys;
+    row_buffer = swap_rows;
+  }
+
+  if (keys != context->keys + offset) {
+    memcpy(context->keys + offset, keys, length * sizeof(uint64_t));
+    memcpy(context->rows + offset, rows, length * sizeof(size_t));
+  }
+}
+
+/************************************************/
+/*             CSV_SORT_COMPARE                 */
+/************************************************/
+
+static int csv_sort_compare(const CSV_SORT_STRINGS *strings, size_t item,
+                            size_t other) {
+  CSV_FIELD_LIST *field_list = strings->field_list;
+
+  size_t length = 0;
+  size_t other_length = 0;
+  char *string = NULL;
+  char *other_string = NULL;
+
+  if (strings->by_code) {
+    string = csv_code_string(field_list, (uint32_t)item, &length);
+    other_string = csv_code_string(field_list, (uint32_t)other, &other_length);
+  } else {
+    string = csv_util_char(field_list, item, &length);
+    other_string = csv_util_char(field_list, other, &other_length);
+  }
+
+  size_t common = length < other_length ? length : other_length;
+  int order = memcmp(string, other_string, common);
+
+  if (order == 0) {
+    order = (length > other_length) - (length < other_length);
+  }
+
+  return strings->descending ? -order : order;
+}
+
+/************************************************/
+/*             CSV_SORT_STRINGS                 */
+/************************************************/
+
+/* -- Stable bottom up merge sort of items, buffer holds length items */
+static void csv_sort_strings(const CSV_SORT_STRINGS *strings, size_t *items,
+                             size_t *buffer, size_t length) {
+  for (size_t begin = 0; begin < length; begin += CSV_SORT_INSERTION) {
+    size_t end = begin + CSV_SORT_INSERTION < length
+                     ? begin + CSV_SORT_INSERTION
+                     : length;
+
+    for (size_t i = begin + 1; i < end; i++) {
+      size_t item = items[i];
+      size_t j = i;
+
+      while (j > begin && csv_sort_compare(strings, item, items[j - 1]) < 0) {
+        items[j] = items[j - 1];
+        j--;
+      }
+
+      items[j] = item;
+    }
+  }
+
+  size_t *source = items;
+  size_t *target = buffer;
+
+  for (size_t width = CSV_SORT_INSERTION; width < length; width *= 2) {
+    for (size_t begin = 0; begin < length; begin += 2 * width) {
+      size_t middle = begin + width < length ? begin + width : length;
+      size_t end = middle + width < length ? middle + width : length;
+
+      size_t left = begin;
+      size_t right = middle;
+      size_t slot = begin;
+
+      while (left < middle && right < end) {
+        if (csv_sort_compare(strings, source[right], source[left]) < 0) {
+          target[slot++] = source[right++];
+        } else {
+          target[slot++] = source[left++];
+        }
+      }
+
+      while (left < middle) {
+        target[slot++] = source[left++];
+      }
+
+      while (right < end) {
+        target[slot++] = source[right++];
+      }
+    }
+
+    size_t *swap = source;
+
+    source = target;
+    target = swap;
+  }
+
+  if (source != items) {
+    memcpy(items, source, length * sizeof(size_t));
+  }
+}
+
+/************************************************/
+/*             CSV_SORT_RANKS                   */
+/************************************************/
+
+/* -- Rank of every dictionary value in string order, codes are unique */
+static uint32_t *csv_sort_ranks(CSV_FIELD_LIST *field_list) {
+  uint32_t values = field_list->dictionary->values;
+
+  size_t *codes = malloc((values + 1) * sizeof(size_t));
+  size_t *buffer = malloc((values + 1) * sizeof(size_t));
+  uint32_t *ranks = malloc((values + 1) * sizeof(uint32_t));
+
+  if (codes == NULL || buffer == NULL || ranks == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    free(codes);
+    free(buffer);
+    free(ranks);
+    return NULL;
+  }
+
+  CSV_SORT_STRINGS strings = {field_list, true, false};
+
+  for (uint32_t code = 0; code < values; code++) {
+    codes[code] = code;
+  }
+
+  csv_sort_strings(&strings, codes, buffer, values);
+
+  for (uint32_t rank = 0; rank < values; rank++) {
+    ranks[codes[rank]] = rank;
+  }
+
+  free(codes);
+  free(buffer);
+
+  return ranks;
+}
+
+/************************************************/
+/*             CSV_SORT_PREFIX                  */
+/************************************************/
+
+/* -- First 8 bytes of a string, big endian so words order like bytes */
+static uint64_t csv_sort_prefix(const char *string, size_t length) {
+  uint64_t word = 0;
+
+  for (size_t i = 0; i < 8; i++) {
+    word = (word << 8) | (i < length ? (unsigned char)string[i] : 0);
+  }
+
+  return word;
+}
+
+/************************************************/
+/*             CSV_SORT_ENCODE                  */
+/************************************************/
+
+static int csv_sort_encode(CSV_SORT_CONTEXT *context,
+                           CSV_FIELD_LIST *field_list, size_t offset,
+                           size_t length) {
+  uint64_t *keys = context->keys + offset;
+  const size_t *rows = context->rows + offset;
+
+  switch (field_list->field_type) {
+  case INT_TYPE: {
+    for (size_t i = 0; i < length; i++) {
+      keys[i] = (uint64_t)field_list->int_data[rows[i]] ^ CSV_SORT_SIGN;
+    }
+
+    break;
+  }
+  case DOUBLE_TYPE: {
+    for (size_t i = 0; i < length; i++) {
+      double data = field_list->double_data[rows[i]];
+      uint64_t word = 0;
+
+      /* -- 0.0 and -0.0 tie */
+      if (data == 0) {
+        data = 0;
+      }
+
+      memcpy(&word, &data, sizeof(word));
+
+      keys[i] = (word & CSV_SORT_SIGN) ? ~word : word | CSV_SORT_SIGN;
+    }
+
+    break;
+  }
+  case CHAR_TYPE: {
+    if (field_list->dictionary == NULL) {
+      for (size_t i = 0; i < length; i++) {
+        size_t char_length = 0;
+        char *string = csv_util_char(field_list, rows[i], &char_length);
+
+        keys[i] = csv_sort_prefix(string, char_length);
+      }
+
+      break;
+    }
+
+    uint32_t *ranks = csv_sort_ranks(field_list);
+
+    if (ranks == NULL) {
+      return -1;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+      keys[i] =
+          ranks[csv_util_dictionary_code(field_list->dictionary, rows[i])];
+    }
+
+    free(ranks);
+    break;
+  }
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_SORT_TIES                    */
+/************************************************/
+
+/* -- Plain strings sharing their first 8 bytes are ordered in full */
+static void csv_sort_ties(CSV_SORT_CONTEXT *context, CSV_FIELD_LIST *field_list,
+                          CSV_DIRECTION direction, size_t offset,
+                          size_t length) {
+  const uint64_t *keys = context->keys + offset;
+  size_t *rows = context->rows + offset;
+  size_t *buffer = context->row_buffer + offset;
+
+  CSV_SORT_STRINGS strings = {field_list, false,
+                              direction == CSV_DESCENDING};
+
+  size_t begin = 0;
+
+  while (begin < length) {
+    size_t end = begin + 1;
+
+    while (end < length && keys[end] == keys[begin]) {
+      end++;
+    }
+
+    if (end - begin > 1) {
+      csv_sort_strings(&strings, rows + begin, buffer + begin, end - begin);
+    }
+
+    begin = end;
+  }
+}
+
+/************************************************/
+/*             CSV_SORT_KEY                     */
+/************************************************/
+
+static int csv_sort_key(CSV_SORT_CONTEXT *context, CSV_FIELD_LIST *field_list,
+                        CSV_DIRECTION direction) {
+  size_t length = context->length;
+
+  /* -- A column of nulls only, every row ties */
+  if (field_list->capacity == 0) {
+    return 0;
+  }
+
+  size_t nulls = 0;
+
+  if (field_list->nulls > 0) {
+    for (size_t i = 0; i < length; i++) {
+      nulls += csv_util_is_null(field_list, context->rows[i]);
+    }
+  }
+
+  /* -- Nulls go after the values, before them when descending */
+  size_t offset = direction == CSV_DESCENDING ? nulls : 0;
+
+  if (nulls > 0) {
+    size_t value = offset;
+    size_t null = direction == CSV_DESCENDING ? 0 : length - nulls;
+
+    for (size_t i = 0; i < length; i++) {
+      size_t row = context->rows[i];
+
+      if (csv_util_is_null(field_list, row)) {
+        context->row_buffer[null++] = row;
+      } else {
+        context->row_buffer[value++] = row;
+      }
+    }
+
+    size_t *swap = context->rows;
+
+    context->rows = context->row_buffer;
+    context->row_buffer = swap;
+  }
+
+  length -= nulls;
+
+  if (csv_sort_encode(context, field_list, offset, length) != 0) {
+    return -1;
+  }
+
+  if (direction == CSV_DESCENDING) {
+    uint64_t *keys = context->keys + offset;
+
+    for (size_t i = 0; i < length; i++) {
+      keys[i] = ~keys[i];
+    }
+  }
+
+  csv_sort_words(context, offset, length);
+
+  if (field_list->field_type == CHAR_TYPE && field_list->dictionary == NULL) {
+    csv_sort_ties(context, field_list, direction, offset, length);
+  }
+
+  return 0;
+}
+
+/************************************************/
+/*             CSV_SORT                         */
+/************************************************/
+
+size_t *csv_sort(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                 const unsigned *keys, const CSV_DIRECTION *directions,
+                 unsigned total_keys, size_t *total_rows,
+                 CSV_OPTIONS *options) {
+  if (csv_list == NULL || metadata == NULL ||
+      (keys == NULL && total_keys > 0)) {
+    fprintf(stderr, "%s: csv_list, metadata or keys is NULL.\n", __func__);
+    return NULL;
+  }
+
+  CSV_FIELD_LIST *key_field[total_keys + 1];
+
+  for (unsigned k = 0; k < total_keys; k++) {
+    key_field[k] = csv_column(keys[k], csv_list, metadata);
+
+    if (key_field[k] == NULL) {
+      fprintf(stderr, "%s: No column %u.\n", __func__, keys[k]);
+      return NULL;
+    }
+  }
+
+  size_t items = metadata->items;
+  size_t live = items - csv_list->tombstones.dead;
+
+  CSV_SORT_CONTEXT context = {0};
+
+  context.threads = options != NULL ? options->threads : 1;
+  context.rows = malloc((live + 1) * sizeof(size_t));
+  context.row_buffer = malloc((live + 1) * sizeof(size_t));
+  context.keys = malloc((live + 1) * sizeof(uint64_t));
+  context.key_buffer = malloc((live + 1) * sizeof(uint64_t));
+
+  int status = 0;
+
+  if (context.rows == NULL || context.row_buffer == NULL ||
+      context.keys == NULL || context.key_buffer == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    status = -1;
+  } else {
+    for (size_t row = 0; row < items; row++) {
+      if (!csv_util_row_dead(&csv_list->tombstones, row)) {
+        context.rows[context.length++] = row;
+      }
+    }
+  }
+
+  /* -- The last key first, later passes keep the order of ties */
+  for (unsigned k = total_keys; status == 0 && k > 0; k--) {
+    CSV_DIRECTION direction =
+        directions != NULL ? directions[k - 1] : CSV_ASCENDING;
+
+    status = csv_sort_key(&context, key_field[k - 1], direction);
+  }
+
+  free(context.row_buffer);
+  free(context.keys);
+  free(context.key_buffer);
+
+  if (status != 0) {
+    free(context.rows);
+    return NULL;
+  }
+
+  if (total_rows != NULL) {
+    *total_rows = context.length;
+  }
+
+  return context.rows;
+}
@@ -0,0 +1,390 @@
+/**
+ * @file source.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Input sources for libcsv
+ *
+ * A source hands out the bytes of its input in whatever blocks the reader
+ * asks for: a callback, a buffer in memory, a file descriptor or a file.
+ * The gzip source wraps another one and inflates its compressed blocks
+ * straight into the reader buffer, so nothing is decompressed to disk and
+ * the plain text is never copied twice.
+ *
+ * @version 0.1
+ * @date 2025-01-26
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <csv-utils.h>
+#include <libcsv.h>
+
+/************ SOURCE CONTEXT ************/
+
+typedef struct csv_source_buffer {
+  const char *data;
+  size_t size;
+  size_t position;
+} CSV_SOURCE_BUFFER;
+
+typedef struct csv_source_descriptor {
+  int descriptor;
+
+  /* -- Opened by csv_source_file(), closed with the source */
+  bool owned;
+} CSV_SOURCE_DESCRIPTOR;
+
+typedef struct csv_source_inflate {
+  z_stream stream;
+
+  struct csv_source *compressed;
+
+  unsigned char *input;
+  bool input_end;
+
+  /* -- Inside a gzip member, the input must not end here */
+  bool member;
+} CSV_SOURCE_INFLATE;
+
+/************************************************/
+/*             CSV_SOURCE_CALLBACK              */
+/************************************************/
+
+CSV_SOURCE *csv_source_callback(ptrdiff_t (*read)(void *data, size_t size,
+                                                  void *context),
+                                void (*close)(void *context), void *context) {
+  if (read == NULL) {
+    fprintf(stderr, "%s: read is NULL.\n", __func__);
+    return NULL;
+  }
+
+  CSV_SOURCE *source = malloc(sizeof(CSV_SOURCE));
+
+  if (source == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+
+    if (close != NULL) {
+      close(context);
+    }
+
+    return NULL;
+  }
+
+  source->read = read;
+  source->close = close;
+  source->context = context;
+
+  return source;
+}
+
+/************************************************/
+/*             CSV_SOURCE_MEMORY                */
+/************************************************/
+
+static ptrdiff_t csv_source_memory_read(void *data, size_t size,
+                                        void *context) {
+  CSV_SOURCE_BUFFER *buffer = context;
+  size_t length = buffer->size - buffer->position;
+
+  if (length > size) {
+    length = size;
+  }
+
+  memcpy(data, buffer->data + buffer->position, length);
+  buffer->position += length;
+
+  return length;
+}
+
+CSV_SOURCE *csv_source_memory(const char *data, size_t size) {
+  if (data == NULL && size > 0) {
+    fprintf(stderr, "%s: data is NULL.\n", __func__);
+    return NULL;
+  }
+
+  CSV_SOURCE_BUFFER *buffer = malloc(sizeof(CSV_SOURCE_BUFFER));
+
+  if (buffer == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    return NULL;
+  }
+
+  buffer->data = data;
+  buffer->size = size;
+  buffer->position = 0;
+
+  return csv_source_callback(csv_source_memory_read, free, buffer);
+}
+
+/************************************************/
+/*             CSV_SOURCE_FD                    */
+/************************************************/
+
+static ptrdiff_t csv_source_fd_read(void *data, size_t size, void *context) {
+  CSV_SOURCE_DESCRIPTOR *descriptor = context;
+
+  if (size > SSIZE_MAX) {
+    size = SSIZE_MAX;
+  }
+
+  ssize_t bytes = 0;
+
+  do {
+    bytes = read(descriptor->descriptor, data, size);
+  } while (bytes < 0 && errno == EINTR);
+
+  return bytes;
+}
+
+static void csv_source_fd_close(void *context) {
+  CSV_SOURCE_DESCRIPTOR *descriptor = context;
+
+  if (descriptor->owned) {
+    close(descriptor->descriptor);
+  }
+
+  free(descriptor);
+}
+
+static CSV_SOURCE *csv_source_descriptor(int descriptor, bool owned) {
+  CSV_SOURCE_DESCRIPTOR *context = malloc(sizeof(CSV_SOURCE_DESCRIPTOR));
+
+  if (context == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+
+    if (owned) {
+      close(descriptor);
+    }
+
+    return NULL;
+  }
+
+  context->descriptor = descriptor;
+  context->owned = owned;
+
+  return csv_source_callback(csv_source_fd_read, csv_source_fd_close,
+                             context);
+}
+
+CSV_SOURCE *csv_source_fd(int descriptor) {
+  if (descriptor < 0) {
+    fprintf(stderr, "%s: Invalid file descriptor.\n", __func__);
+    return NULL;
+  }
+
+  return csv_source_descriptor(descriptor, false);
+}
+
+/************************************************/
+/*             CSV_SOURCE_FILE                  */
+/************************************************/
+
+CSV_SOURCE *csv_source_file(const char *csv_file) {
+  int csv_fd = open(csv_file, O_RDONLY);
+
+  if (csv_fd < 0) {
+    return NULL;
+  }
+
+  posix_fadvise(csv_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  return csv_source_descriptor(csv_fd, true);
+}
+
+/************************************************/
+/*             CSV_SOURCE_GZIP                  */
+/************************************************/
+
+/* -- Tops the input up to the 2 bytes of a gzip magic, unless it ended */
+static int csv_source_gzip_peek(CSV_SOURCE_INFLATE *inflater) {
+  z_stream *stream = &inflater->stream;
+  size_t kept = stream->avail_in;
+
+  if (kept >= 2 || inflater->input_end) {
+    return 0;
+  }
+
+  memmove(inflater->input, stream->next_in, kept);
+
+  ptrdiff_t bytes =
+      csv_util_source_fill(inflater->compressed, (char *)inflater->input + kept,
+                           CSV_SOURCE_BUFFER_SIZE - kept);
+
+  if (bytes < 0) {
+    return -1;
+  }
+
+  stream->next_in = inflater->input;
+  stream->avail_in = kept + bytes;
+  inflater->input_end = (size_t)bytes < CSV_SOURCE_BUFFER_SIZE - kept;
+
+  return 0;
+}
+
+static ptrdiff_t csv_source_gzip_read(void *data, size_t size, void *context) {
+  CSV_SOURCE_INFLATE *inflater = context;
+  z_stream *stream = &inflater->stream;
+
+  if (size > UINT_MAX) {
+    size = UINT_MAX;
+  }
+
+  /* -- Inflate straight into the caller's buffer */
+  stream->next_out = data;
+  stream->avail_out = size;
+
+  while (stream->avail_out > 0) {
+    if (stream->avail_in == 0 && !inflater->input_end) {
+      ptrdiff_t bytes =
+          csv_util_source_fill(inflater->compressed, (char *)inflater->input,
+                               CSV_SOURCE_BUFFER_SIZE);
+
+      if (bytes < 0) {
+        return -1;
+      }
+
+      stream->next_in = inflater->input;
+      stream->avail_in = bytes;
+      inflater->input_end = bytes < CSV_SOURCE_BUFFER_SIZE;
+    }
+
+    if (stream->avail_in == 0) {
+      if (inflater->member) {
+        fprintf(stderr, "%s: Compressed data is truncated.\n", __func__);
+        return -1;
+      }
+
+      break;
+    }
+
+    int status = inflate(stream, Z_NO_FLUSH);
+
+    if (status == Z_STREAM_END) {
+      inflater->member = false;
+
+      if (csv_source_gzip_peek(inflater) != 0) {
+        return -1;
+      }
+
+      /* -- Another member only starts with the gzip magic, anything else
+       * after the last one is padding and ignored like gzip does */
+      if (stream->avail_in < 2 || stream->next_in[0] != 0x1f ||
+          stream->next_in[1] != 0x8b) {
+        stream->avail_in = 0;
+        inflater->input_end = true;
+        break;
+      }
+
+      if (inflateReset(stream) != Z_OK) {
+        return -1;
+      }
+
+      continue;
+    }
+
+    if (status != Z_OK && status != Z_BUF_ERROR) {
+      fprintf(stderr, "%s: %s.\n", __func__,
+              stream->msg ? stream->msg : "Invalid compressed data");
+      return -1;
+    }
+
+    inflater->member = true;
+  }
+
+  return size - stream->avail_out;
+}
+
+static void csv_source_gzip_close(void *context) {
+  CSV_SOURCE_INFLATE *inflater = context;
+
+  inflateEnd(&inflater->stream);
+  csv_source_close(inflater->compressed);
+
+  free(inflater->input);
+  free(inflater);
+}
+
+CSV_SOURCE *csv_source_gzip(CSV_SOURCE *compressed) {
+  if (compressed == NULL) {
+    return NULL;
+  }
+
+  CSV_SOURCE_INFLATE *inflater = calloc(1, sizeof(CSV_SOURCE_INFLATE));
+  unsigned char *input = malloc(CSV_SOURCE_BUFFER_SIZE);
+
+  if (inflater == NULL || input == NULL) {
+    fprintf(stderr, "%s: Memory allocation failed.\n", __func__);
+    free(inflater);
+    free(input);
+    csv_source_close(compressed);
+    return NULL;
+  }
+
+  /* -- 32 detects a gzip or zlib header */
+  if (inflateInit2(&inflater->stream, MAX_WBITS + 32) != Z_OK) {
+    fprintf(stderr, "%s: Unable to start inflating.\n", __func__);
+    free(inflater);
+    free(input);
+    csv_source_close(compressed);
+    return NULL;
+  }
+
+  inflater->compressed = compressed;
+  inflater->input = input;
+
+  return csv_source_callback(csv_source_gzip_read, csv_source_gzip_close,
+                             inflater);
+}
+
+/************************************************/
+/*             CSV_SOURCE_CLOSE                 */
+/************************************************/
+
+void csv_source_close(CSV_SOURCE *source) {
+  if (source == NULL) {
+    return;
+  }
+
+  if (source->close != NULL) {
+    source->close(source->context);
+  }
+
+  free(source);
+}
+
+/************************************************/
+/*             CSV_UTIL_SOURCE_FILL             */
+/************************************************/
+
+ptrdiff_t csv_util_source_fill(CSV_SOURCE *source, char *data, size_t size) {
+  size_t filled = 0;
+
+  /* -- Sources may return short reads, only 0 ends the input */
+  while (filled < size) {
+    ptrdiff_t bytes = source->read(data + filled, size - filled,
+                                   source->context);
+
+    if (bytes < 0) {
+      return -1;
+    }
+
+    if (bytes == 0) {
+      break;
+    }
+
+    filled += bytes;
+  }
+
+  return filled;
+}
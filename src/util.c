@@ -19,108 +19,107 @@
 #include <util.h>
 
 /************************************************/
-/*             UTIL_TRIM_STRING                 */
+/*             UTIL_TRIM_SPAN                   */
 /************************************************/
 
-char *util_trim_string(char *string) {
-  int string_len = strlen(string);
-
-  int begin = 0;
-  int end = string_len - 1;
-
-  char *in_string = string;
+const char *util_trim_span(const char *string, size_t *length) {
+  size_t string_len = *length;
 
   /* -- Remove front spaces */
-  while (in_string) {
-    if (!isspace(*in_string)) {
-      break;
-    }
-
-    in_string++;
-    begin++;
+  while (string_len > 0 && isspace((unsigned char)*string)) {
+    string++;
+    string_len--;
   }
 
   /* -- Remove back spaces */
-  while (string_len > -1) {
-    if (!isspace(*(in_string - begin + end))) {
-      break;
-    }
-
+  while (string_len > 0 && isspace((unsigned char)string[string_len - 1])) {
     string_len--;
-    end--;
-  }
-
-  /* -- Create new string */
-  char *trimmed_string = calloc(1, end - begin + 2);
-
-  int i = 0;
-
-  for (i = 0; i < end - begin + 1; i++) {
-    trimmed_string[i] = *in_string;
-
-    in_string++;
   }
 
-  trimmed_string[i] = '\0';
+  *length = string_len;
 
-  return trimmed_string;
+  return string;
 }
 
 /************************************************/
-/*             UTIL_STRING_TO_NUMBER            */
+/*             UTIL_NUMBER_TO_STRING            */
 /************************************************/
 
-int util_string_to_number(char *string, int *data) {
-  char *characters;
+int util_number_to_string(int64_t data, char *buffer) {
+  static const char digit_pairs[] = "00010203040506070809"
+                                    "10111213141516171819"
+                                    "20212223242526272829"
+                                    "30313233343536373839"
+                                    "40414243444546474849"
+                                    "50515253545556575859"
+                                    "60616263646566676869"
+                                    "70717273747576777879"
+                                    "80818283848586878889"
+                                    "90919293949596979899";
+
+  char digits[20];
+  int length = 0;
+
+  uint64_t value = data < 0 ? 0 - (uint64_t)data : (uint64_t)data;
+
+  /* -- Two digits at a time, from the back */
+  while (value >= 100) {
+    unsigned pair = (unsigned)(value % 100) * 2;
+    value /= 100;
+
+    digits[19 - length++] = digit_pairs[pair + 1];
+    digits[19 - length++] = digit_pairs[pair];
+  }
+
+  if (value >= 10) {
+    digits[19 - length++] = digit_pairs[value * 2 + 1];
+    digits[19 - length++] = digit_pairs[value * 2];
+  } else {
+    digits[19 - length++] = (char)('0' + value);
+  }
 
-  *data = strtol(string, &characters, 10);
+  int sign = data < 0 ? 1 : 0;
 
-  if (*characters != '\0') {
-    return -1;
+  if (sign) {
+    buffer[0] = '-';
   }
 
-  return 0;
+  memcpy(buffer + sign, digits + 20 - length, length);
+  buffer[sign + length] = '\0';
+
+  return sign + length;
 }
 
 /************************************************/
-/*             UTIL_STRING_TO_DOUBLE            */
+/*             UTIL_DOUBLE_TO_STRING            */
 /************************************************/
 
-int util_string_to_double(char *string, double *data) {
-  if (strstr(string, ".") == NULL) {
-    return -1;
-  }
-
-  char *characters;
+int util_double_to_string(double data, char *buffer, size_t size) {
+  int length = 0;
 
-  *data = strtod(string, &characters);
+  for (int precision = 1; precision <= 17; precision++) {
+    length = snprintf(buffer, size, "%.*g", precision, data);
 
-  if (*characters != '\0') {
-    return -1;
+    if (strtod(buffer, NULL) == data) {
+      break;
+    }
   }
 
-  return 0;
+  return length;
 }
 
 /************************************************/
-/*             UTIL_TOTAL_FIELDS                */
+/*             UTIL_HASH                        */
 /************************************************/
 
-int util_total_fields(char *string) {
-  char *buffer = calloc(1, strlen(string));
-  strcpy(buffer, string);
-
-  char *token = strtok(buffer, CSV_DELIMETER);
-
-  unsigned total_fields = 0;
+uint64_t util_hash(const void *data, size_t length) {
+  const unsigned char *bytes = data;
+  uint64_t hash = 14695981039346656037ULL;
 
-  while (token != NULL) {
-    total_fields += 1;
-
-    token = strtok(NULL, CSV_DELIMETER);
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
   }
 
-  free(buffer);
-
-  return total_fields;
-}
\ No newline at end of file
+  return hash;
+}
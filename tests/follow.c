@@ -0,0 +1,300 @@
+/**
+ * @file follow.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Checks csv_refresh() on a followed file: appended rows, partial and
+ * multi-line rows, a truncated file, a rotated file and another header
+ *
+ * @version 0.1
+ * @date 2025-01-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libcsv.h>
+
+#define TEST_FILE "build/follow.csv"
+#define ROTATED_FILE "build/follow.csv.1"
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/************ INPUT ************/
+
+static bool write_text(const char *csv_file, const char *mode,
+                       const char *text) {
+  FILE *csv_stream = fopen(csv_file, mode);
+
+  if (csv_stream == NULL) {
+    printf("FAIL unable to write %s\n", csv_file);
+    failures++;
+    return false;
+  }
+
+  fputs(text, csv_stream);
+
+  return fclose(csv_stream) == 0;
+}
+
+static CSV_LIST *import_file(CSV_METADATA **metadata) {
+  CSV_OPTIONS options = {.follow = true};
+  CSV_LIST *csv_list = csv_import_ex(TEST_FILE, metadata, &options);
+
+  checks++;
+
+  if (csv_list == NULL) {
+    printf("FAIL unable to follow %s\n", TEST_FILE);
+    failures++;
+  }
+
+  return csv_list;
+}
+
+/************ COMPARE ************/
+
+/* -- The list holds the ids and names given, in order */
+static void check_rows(const char *name, CSV_LIST *csv_list,
+                       CSV_METADATA *metadata, const int64_t *ids,
+                       const char **names, size_t total_rows) {
+  checks++;
+
+  if (metadata->items != total_rows) {
+    printf("FAIL %s: %u rows, %zu expected\n", name, metadata->items,
+           total_rows);
+    failures++;
+    return;
+  }
+
+  for (size_t row = 0; row < total_rows; row++) {
+    CSV_CELL id = {0};
+    CSV_CELL text = {0};
+
+    checks++;
+
+    if (!csv_cell(row, 0, &id, csv_list, metadata) ||
+        !csv_cell(row, 1, &text, csv_list, metadata) ||
+        id.field_type != INT_TYPE || id.int_data != ids[row] ||
+        text.char_length != strlen(names[row]) ||
+        memcmp(text.char_data, names[row], text.char_length) != 0) {
+      printf("FAIL %s: row %zu does not hold %lld,%s\n", name, row,
+             (long long)ids[row], names[row]);
+      failures++;
+      return;
+    }
+  }
+}
+
+static void check_refresh(const char *name, CSV_LIST *csv_list,
+                          CSV_METADATA *metadata, size_t expected) {
+  size_t rows = csv_refresh(csv_list, metadata);
+
+  checks++;
+
+  if (rows != expected) {
+    printf("FAIL %s: %zu rows appended, %zu expected\n", name, rows,
+           expected);
+    failures++;
+  }
+}
+
+/************ CHECKS ************/
+
+static void check_append(void) {
+  if (!write_text(TEST_FILE, "w", "id,name\n0,zero\n1,one\n2,tw")) {
+    return;
+  }
+
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = import_file(&metadata);
+
+  if (csv_list == NULL) {
+    return;
+  }
+
+  int64_t ids[] = {0, 1, 2, 3, 4, 5};
+  const char *names[] = {"zero", "one", "two", "three", "four",
+                         "multi\nline, \"quoted\""};
+
+  /* -- The partial last row waits for its newline */
+  check_rows("import", csv_list, metadata, ids, names, 2);
+
+  check_refresh("no change", csv_list, metadata, 0);
+
+  write_text(TEST_FILE, "a", "o\n3,three\n");
+  check_refresh("append", csv_list, metadata, 2);
+  check_rows("append", csv_list, metadata, ids, names, 4);
+
+  check_refresh("append again", csv_list, metadata, 0);
+
+  /* -- A newline inside quotes does not end the row */
+  write_text(TEST_FILE, "a", "4,four\n5,\"multi\n");
+  check_refresh("quoted newline", csv_list, metadata, 1);
+
+  write_text(TEST_FILE, "a", "line, \"\"quoted\"\"\"\n");
+  check_refresh("quoted end", csv_list, metadata, 1);
+  check_rows("quoted", csv_list, metadata, ids, names, 6);
+
+  csv_clear(csv_list, metadata);
+}
+
+static void check_late_header(void) {
+  if (!write_text(TEST_FILE, "w", "")) {
+    return;
+  }
+
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = import_file(&metadata);
+
+  if (csv_list == NULL) {
+    return;
+  }
+
+  checks++;
+
+  if (metadata->items != 0) {
+    printf("FAIL an empty file has %u rows\n", metadata->items);
+    failures++;
+  }
+
+  int64_t ids[] = {7, 8};
+  const char *names[] = {"seven", "eight"};
+
+  write_text(TEST_FILE, "a", "id,na");
+  check_refresh("partial header", csv_list, metadata, 0);
+
+  write_text(TEST_FILE, "a", "me\n7,seven\n8,eight\n");
+  check_refresh("late header", csv_list, metadata, 2);
+  check_rows("late header", csv_list, metadata, ids, names, 2);
+
+  checks++;
+
+  if (metadata->fields != 2 ||
+      strcmp(csv_list->field_list[1]->field, "name") != 0) {
+    printf("FAIL the late header is not the one of the file\n");
+    failures++;
+  }
+
+  csv_clear(csv_list, metadata);
+}
+
+/* -- A shorter file was truncated, its rows are appended again */
+static void check_truncate(void) {
+  if (!write_text(TEST_FILE, "w", "id,name\n0,zero\n1,one\n2,two\n")) {
+    return;
+  }
+
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = import_file(&metadata);
+
+  if (csv_list == NULL) {
+    return;
+  }
+
+  int64_t ids[] = {0, 1, 2, 9};
+  const char *names[] = {"zero", "one", "two", "nine"};
+
+  write_text(TEST_FILE, "w", "id,name\n9,nine\n");
+  check_refresh("truncate", csv_list, metadata, 1);
+  check_rows("truncate", csv_list, metadata, ids, names, 4);
+
+  check_refresh("truncate again", csv_list, metadata, 0);
+
+  csv_clear(csv_list, metadata);
+}
+
+/* -- The old file is read to its end before the new one */
+static void check_rotate(void) {
+  if (!write_text(TEST_FILE, "w", "id,name\n0,zero\n")) {
+    return;
+  }
+
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = import_file(&metadata);
+
+  if (csv_list == NULL) {
+    return;
+  }
+
+  int64_t ids[] = {0, 1, 2, 3};
+  const char *names[] = {"zero", "one", "two", "three"};
+
+  rename(TEST_FILE, ROTATED_FILE);
+
+  write_text(ROTATED_FILE, "a", "1,one\n");
+  write_text(TEST_FILE, "w", "id,name\n2,two\n");
+
+  check_refresh("rotate", csv_list, metadata, 2);
+  check_rows("rotate", csv_list, metadata, ids, names, 3);
+
+  /* -- Only the new file is followed now */
+  write_text(ROTATED_FILE, "a", "8,eight\n");
+  write_text(TEST_FILE, "a", "3,three\n");
+
+  check_refresh("after rotate", csv_list, metadata, 1);
+  check_rows("after rotate", csv_list, metadata, ids, names, 4);
+
+  csv_clear(csv_list, metadata);
+  remove(ROTATED_FILE);
+}
+
+/* -- A file with another header is refused, the list stays as it is */
+static void check_header(void) {
+  if (!write_text(TEST_FILE, "w", "id,name\n0,zero\n")) {
+    return;
+  }
+
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = import_file(&metadata);
+
+  if (csv_list == NULL) {
+    return;
+  }
+
+  int64_t ids[] = {0};
+  const char *names[] = {"zero"};
+
+  write_text(TEST_FILE, "w", "key,value\n1,one\n2,two\n");
+
+  /* -- The refused header explains itself on stderr, keep it quiet */
+  int error_fd = dup(STDERR_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+
+  fflush(stderr);
+  dup2(null_fd, STDERR_FILENO);
+
+  check_refresh("another header", csv_list, metadata, 0);
+  check_refresh("another header again", csv_list, metadata, 0);
+
+  fflush(stderr);
+  dup2(error_fd, STDERR_FILENO);
+  close(error_fd);
+  close(null_fd);
+
+  check_rows("another header", csv_list, metadata, ids, names, 1);
+
+  csv_clear(csv_list, metadata);
+}
+
+int main(void) {
+  check_append();
+  check_late_header();
+  check_truncate();
+  check_rotate();
+  check_header();
+
+  remove(TEST_FILE);
+
+  printf("%lu checks, %lu failures\n", checks, failures);
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,473 @@
+/**
+ * @file group.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Checks csv_group_by() against sums kept for every group while the
+ * input is written, and integer sums past the range of int64_t
+ *
+ * @version 0.1
+ * @date 2025-01-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcsv.h>
+
+#define TEST_FILE "build/group.csv"
+#define OVERFLOW_FILE "build/group-overflow.csv"
+
+/* -- Several CSV_GROUP_ROWS, so threads group chunks and merge them */
+#define TEST_ROWS 300000
+
+/* -- Names k0 to k19, a null name and "only", whose values are all null */
+#define NAMES 22
+#define NULL_NAME 20
+#define ONLY_NAME 21
+
+/* -- Numbers 0 to 9 and a null one */
+#define NUMBERS 11
+#define NULL_NUMBER 10
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/* -- xorshift64*, the same sequence on every run */
+static uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
+/************ EXPECTED ************/
+
+typedef struct group {
+  size_t first_row;
+  size_t rows;
+
+  size_t int_count;
+  int64_t int_sum;
+  int64_t int_min;
+  int64_t int_max;
+
+  size_t double_count;
+  double double_sum;
+  double double_min;
+  double double_max;
+} GROUP;
+
+static GROUP groups[NAMES * NUMBERS];
+
+/* -- Group of every row as written */
+static unsigned row_group[TEST_ROWS];
+static bool row_int[TEST_ROWS];
+static int64_t row_int_data[TEST_ROWS];
+static bool row_double[TEST_ROWS];
+static double row_double_data[TEST_ROWS];
+
+/************ INPUT ************/
+
+static bool write_file(const char *csv_file) {
+  FILE *csv_stream = fopen(csv_file, "w");
+
+  if (csv_stream == NULL) {
+    printf("FAIL unable to write %s\n", csv_file);
+    return false;
+  }
+
+  fprintf(csv_stream, "name,number,count,score\n");
+
+  for (unsigned row = 0; row < TEST_ROWS; row++) {
+    uint64_t random = next_random();
+
+    unsigned name = (random >> 4) % NAMES;
+    unsigned number = (random >> 12) % NUMBERS;
+
+    row_group[row] = name * NUMBERS + number;
+    row_int[row] = name != ONLY_NAME && (random >> 20) % 30 != 0;
+    row_double[row] = name != ONLY_NAME && (random >> 28) % 30 != 0;
+    row_int_data[row] = (int64_t)((random >> 32) % 2001) - 1000;
+
+    /* -- The value the parser reads back */
+    char score[32];
+
+    snprintf(score, sizeof(score), "%.2f",
+             (double)((random >> 40) % 100001) / 100 - 500);
+    row_double_data[row] = strtod(score, NULL);
+
+    if (name == ONLY_NAME) {
+      fprintf(csv_stream, "only,");
+    } else if (name != NULL_NAME) {
+      fprintf(csv_stream, "k%u,", name);
+    } else {
+      fprintf(csv_stream, ",");
+    }
+
+    if (number != NULL_NUMBER) {
+      fprintf(csv_stream, "%u", number);
+    }
+
+    fprintf(csv_stream, ",");
+
+    if (row_int[row]) {
+      fprintf(csv_stream, "%lld", (long long)row_int_data[row]);
+    }
+
+    fprintf(csv_stream, ",");
+
+    if (row_double[row]) {
+      fprintf(csv_stream, "%s", score);
+    }
+
+    fprintf(csv_stream, "\n");
+  }
+
+  return fclose(csv_stream) == 0;
+}
+
+/* -- Only the live rows count */
+static void expect_groups(CSV_LIST *csv_list) {
+  memset(groups, 0, sizeof(groups));
+
+  for (size_t row = 0; row < TEST_ROWS; row++) {
+    if (csv_row_removed(row, csv_list)) {
+      continue;
+    }
+
+    GROUP *group = &groups[row_group[row]];
+
+    if (group->rows++ == 0) {
+      group->first_row = row;
+    }
+
+    if (row_int[row]) {
+      int64_t data = row_int_data[row];
+
+      if (group->int_count++ == 0 || data < group->int_min) {
+        group->int_min = data;
+      }
+
+      if (group->int_count == 1 || data > group->int_max) {
+        group->int_max = data;
+      }
+
+      group->int_sum += data;
+    }
+
+    if (row_double[row]) {
+      double data = row_double_data[row];
+
+      if (group->double_count++ == 0 || data < group->double_min) {
+        group->double_min = data;
+      }
+
+      if (group->double_count == 1 || data > group->double_max) {
+        group->double_max = data;
+      }
+
+      group->double_sum += data;
+    }
+  }
+}
+
+/************ COMPARE ************/
+
+static unsigned name_index(CSV_CELL *cell) {
+  if (cell->is_null) {
+    return NULL_NAME;
+  }
+
+  if (cell->char_length == 4 && memcmp(cell->char_data, "only", 4) == 0) {
+    return ONLY_NAME;
+  }
+
+  unsigned name = 0;
+
+  for (size_t i = 1; i < cell->char_length; i++) {
+    name = name * 10 + (cell->char_data[i] - '0');
+  }
+
+  return cell->char_length > 1 && cell->char_data[0] == 'k' ? name : NAMES;
+}
+
+static bool check_int(CSV_CELL *cell, bool present, int64_t expected) {
+  if (!present) {
+    return cell->is_null;
+  }
+
+  return !cell->is_null && cell->field_type == INT_TYPE &&
+         cell->int_data == expected;
+}
+
+static bool check_double(CSV_CELL *cell, bool present, double expected,
+                         double tolerance) {
+  if (!present) {
+    return cell->is_null;
+  }
+
+  return !cell->is_null && cell->field_type == DOUBLE_TYPE &&
+         fabs(cell->double_data - expected) <= tolerance;
+}
+
+/************ CHECKS ************/
+
+static void check_group_by(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                           unsigned threads) {
+  unsigned keys[] = {0, 1};
+  CSV_GROUP_AGG aggregates[] = {
+      {CSV_AGG_COUNT, 2}, {CSV_AGG_SUM, 2},  {CSV_AGG_MIN, 2},
+      {CSV_AGG_MAX, 2},   {CSV_AGG_MEAN, 2}, {CSV_AGG_SUM, 3},
+      {CSV_AGG_MIN, 3},   {CSV_AGG_MAX, 3},  {CSV_AGG_MEAN, 3}};
+
+  CSV_GROUP_BY group_by = {
+      .keys = 2,
+      .key_column = keys,
+      .aggregates = sizeof(aggregates) / sizeof(*aggregates),
+      .aggregate = aggregates};
+
+  CSV_OPTIONS options = {.threads = threads};
+  CSV_METADATA *group_metadata = NULL;
+
+  CSV_LIST *group_list =
+      csv_group_by(csv_list, metadata, &group_by, &group_metadata, &options);
+
+  checks++;
+
+  if (group_list == NULL || group_metadata->fields != 11) {
+    printf("FAIL %u threads: no groups\n", threads);
+    failures++;
+
+    if (group_list != NULL) {
+      csv_clear(group_list, group_metadata);
+    }
+
+    return;
+  }
+
+  checks++;
+
+  if (strcmp(group_list->field_list[2]->field, "count(count)") != 0 ||
+      strcmp(group_list->field_list[7]->field, "sum(score)") != 0) {
+    printf("FAIL %u threads: columns %s and %s\n", threads,
+           group_list->field_list[2]->field, group_list->field_list[7]->field);
+    failures++;
+  }
+
+  /* -- Groups come in the order of their first row */
+  size_t previous_row = 0;
+  size_t total_groups = 0;
+  unsigned mismatches = 0;
+
+  for (size_t row = 0; row < group_metadata->items; row++) {
+    CSV_CELL cells[11] = {0};
+
+    for (unsigned column = 0; column < 11; column++) {
+      csv_cell(row, column, &cells[column], group_list, group_metadata);
+    }
+
+    unsigned name = name_index(&cells[0]);
+    unsigned number = NULL_NUMBER;
+
+    if (!cells[1].is_null) {
+      number = (unsigned)cells[1].int_data;
+    }
+
+    bool valid = name < NAMES && number < NUMBERS &&
+                 groups[name * NUMBERS + number].rows > 0;
+
+    GROUP *group = valid ? &groups[name * NUMBERS + number] : NULL;
+
+    valid = valid && (row == 0 || group->first_row > previous_row);
+
+    if (valid) {
+      bool ints = group->int_count > 0;
+      bool doubles = group->double_count > 0;
+
+      double int_mean = ints ? (double)group->int_sum / group->int_count : 0;
+      double double_mean =
+          doubles ? group->double_sum / group->double_count : 0;
+
+      valid = check_int(&cells[2], true, group->int_count) &&
+              check_int(&cells[3], ints, group->int_sum) &&
+              check_int(&cells[4], ints, group->int_min) &&
+              check_int(&cells[5], ints, group->int_max) &&
+              check_double(&cells[6], ints, int_mean, 1e-9) &&
+              check_double(&cells[7], doubles, group->double_sum, 1e-6) &&
+              check_double(&cells[8], doubles, group->double_min, 0) &&
+              check_double(&cells[9], doubles, group->double_max, 0) &&
+              check_double(&cells[10], doubles, double_mean, 1e-9);
+
+      previous_row = group->first_row;
+      total_groups++;
+    }
+
+    checks++;
+
+    if (!valid) {
+      if (mismatches++ == 0) {
+        printf("FAIL %u threads: group %zu differs\n", threads, row);
+      }
+
+      failures++;
+    }
+  }
+
+  size_t expected_groups = 0;
+
+  for (unsigned g = 0; g < NAMES * NUMBERS; g++) {
+    expected_groups += groups[g].rows > 0;
+  }
+
+  checks++;
+
+  if (total_groups != expected_groups ||
+      group_metadata->items != expected_groups) {
+    printf("FAIL %u threads: %u groups, %zu expected\n", threads,
+           group_metadata->items, expected_groups);
+    failures++;
+  }
+
+  csv_clear(group_list, group_metadata);
+}
+
+/************ OVERFLOW ************/
+
+/* -- A sum past INT64_MAX is carried, not wrapped */
+static void check_overflow(void) {
+  FILE *csv_stream = fopen(OVERFLOW_FILE, "w");
+
+  if (csv_stream == NULL) {
+    printf("FAIL unable to write %s\n", OVERFLOW_FILE);
+    failures++;
+    return;
+  }
+
+  fprintf(csv_stream, "name,count\n");
+
+  for (unsigned row = 0; row < 1000; row++) {
+    fprintf(csv_stream, "big,4000000000000000000\nsmall,%u\n", row % 3);
+  }
+
+  fclose(csv_stream);
+
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = csv_import(OVERFLOW_FILE, &metadata);
+
+  checks++;
+
+  if (csv_list == NULL) {
+    printf("FAIL unable to import %s\n", OVERFLOW_FILE);
+    failures++;
+    return;
+  }
+
+  double big = 4e21;
+  double small = 999;
+  double total = csv_agg_sum(csv_column(1, csv_list, metadata), NULL,
+                             CSV_SUM_FAST);
+  double mean = csv_agg_mean(csv_column(1, csv_list, metadata), NULL,
+                             CSV_SUM_FAST);
+
+  checks++;
+
+  if (fabs(total - (big + small)) > 1e6 ||
+      fabs(mean - (big + small) / 2000) > 1e3) {
+    printf("FAIL overflow: sum %.17g, mean %.17g\n", total, mean);
+    failures++;
+  }
+
+  unsigned keys[] = {0};
+  CSV_GROUP_AGG aggregates[] = {{CSV_AGG_SUM, 1}};
+  CSV_GROUP_BY group_by = {1, keys, 1, aggregates};
+
+  unsigned threads[] = {0, 2};
+
+  for (unsigned t = 0; t < sizeof(threads) / sizeof(*threads); t++) {
+    CSV_OPTIONS options = {.threads = threads[t]};
+    CSV_METADATA *group_metadata = NULL;
+
+    CSV_LIST *group_list =
+        csv_group_by(csv_list, metadata, &group_by, &group_metadata, &options);
+
+    CSV_CELL big_cell = {0};
+    CSV_CELL small_cell = {0};
+
+    checks++;
+
+    if (group_list == NULL ||
+        !csv_cell(0, 1, &big_cell, group_list, group_metadata) ||
+        !csv_cell(1, 1, &small_cell, group_list, group_metadata) ||
+        !check_double(&big_cell, true, big, 1e6) ||
+        !check_double(&small_cell, true, small, 0)) {
+      printf("FAIL overflow, %u threads: grouped sums %.17g and %.17g\n",
+             threads[t], big_cell.double_data, small_cell.double_data);
+      failures++;
+    }
+
+    if (group_list != NULL) {
+      csv_clear(group_list, group_metadata);
+    }
+  }
+
+  csv_clear(csv_list, metadata);
+  remove(OVERFLOW_FILE);
+}
+
+int main(void) {
+  if (!write_file(TEST_FILE)) {
+    return 1;
+  }
+
+  CSV_DICTIONARY_MODE modes[] = {CSV_DICTIONARY_AUTO, CSV_DICTIONARY_OFF};
+
+  for (unsigned m = 0; m < sizeof(modes) / sizeof(*modes); m++) {
+    CSV_OPTIONS options = {.dictionary = modes[m], .compact_ratio = 1};
+    CSV_METADATA *metadata = NULL;
+
+    CSV_LIST *csv_list = csv_import_ex(TEST_FILE, &metadata, &options);
+
+    if (csv_list == NULL) {
+      printf("FAIL unable to import %s\n", TEST_FILE);
+      failures++;
+      continue;
+    }
+
+    /* -- Removed rows belong to no group */
+    size_t removed[TEST_ROWS / 101 + 1];
+    size_t total_removed = 0;
+
+    for (size_t row = 3; row < metadata->items; row += 101) {
+      removed[total_removed++] = row;
+    }
+
+    csv_remove_rows(removed, total_removed, csv_list, metadata);
+
+    expect_groups(csv_list);
+
+    unsigned threads[] = {0, 4};
+
+    for (unsigned t = 0; t < sizeof(threads) / sizeof(*threads); t++) {
+      check_group_by(csv_list, metadata, threads[t]);
+    }
+
+    csv_clear(csv_list, metadata);
+  }
+
+  check_overflow();
+
+  remove(TEST_FILE);
+
+  printf("%lu checks, %lu failures\n", checks, failures);
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,362 @@
+/**
+ * @file join.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Checks csv_join() cell by cell against the matches found from the
+ * keys as written, for number and string keys and either side hashed
+ *
+ * @version 0.1
+ * @date 2025-01-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcsv.h>
+
+#define LEFT_FILE "build/join-left.csv"
+#define RIGHT_FILE "build/join-right.csv"
+
+/* -- More right rows than CSV_JOIN_PARTITION_ROWS, the build is partitioned */
+#define LEFT_ROWS 60000
+#define RIGHT_ROWS 40000
+#define RIGHT_KEYS 30000
+#define LEFT_KEYS 33000
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/* -- xorshift64*, the same sequence on every run */
+static uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
+/************ INPUT ************/
+
+/* -- Key of every row as written, -1 for a null key */
+static long left_keys[LEFT_ROWS];
+static long right_keys[RIGHT_ROWS];
+
+/* -- Right rows by key, in row order */
+static size_t key_begin[LEFT_KEYS + 1];
+static size_t key_rows[RIGHT_ROWS];
+
+static bool write_left(const char *csv_file, unsigned rows) {
+  FILE *csv_stream = fopen(csv_file, "w");
+
+  if (csv_stream == NULL) {
+    printf("FAIL unable to write %s\n", csv_file);
+    return false;
+  }
+
+  fprintf(csv_stream, "order,customer,code,amount\n");
+
+  for (unsigned row = 0; row < rows; row++) {
+    uint64_t random = next_random();
+
+    /* -- Some keys are past the right ones and find no match */
+    left_keys[row] =
+        random % 50 == 0 ? -1 : (long)((random >> 8) % LEFT_KEYS);
+
+    if (left_keys[row] < 0) {
+      fprintf(csv_stream, "%u,,,%.2f\n", row, (double)(random >> 40) / 100);
+    } else {
+      fprintf(csv_stream, "%u,%ld,c%ld,%.2f\n", row, left_keys[row],
+              left_keys[row], (double)(random >> 40) / 100);
+    }
+  }
+
+  return fclose(csv_stream) == 0;
+}
+
+static bool write_right(const char *csv_file) {
+  FILE *csv_stream = fopen(csv_file, "w");
+
+  if (csv_stream == NULL) {
+    printf("FAIL unable to write %s\n", csv_file);
+    return false;
+  }
+
+  fprintf(csv_stream, "customer,code,name\n");
+
+  for (unsigned row = 0; row < RIGHT_ROWS; row++) {
+    uint64_t random = next_random();
+
+    /* -- Keys repeat, a left row gets every match in right order */
+    right_keys[row] =
+        random % 80 == 0 ? -1 : (long)((random >> 8) % RIGHT_KEYS);
+
+    if (right_keys[row] < 0) {
+      fprintf(csv_stream, ",,name%u\n", row);
+    } else {
+      fprintf(csv_stream, "%ld,c%ld,name%u\n", right_keys[row],
+              right_keys[row], row);
+      key_begin[right_keys[row] + 1]++;
+    }
+  }
+
+  for (unsigned key = 0; key < LEFT_KEYS; key++) {
+    key_begin[key + 1] += key_begin[key];
+  }
+
+  size_t filled[LEFT_KEYS] = {0};
+
+  for (unsigned row = 0; row < RIGHT_ROWS; row++) {
+    long key = right_keys[row];
+
+    if (key >= 0) {
+      key_rows[key_begin[key] + filled[key]++] = row;
+    }
+  }
+
+  return fclose(csv_stream) == 0;
+}
+
+/************ COMPARE ************/
+
+static bool same_cell(CSV_CELL *expected, CSV_CELL *cell) {
+  if (expected->is_null || cell->is_null) {
+    return expected->is_null == cell->is_null;
+  }
+
+  if (expected->field_type != cell->field_type) {
+    return false;
+  }
+
+  switch (cell->field_type) {
+  case CHAR_TYPE:
+    return expected->char_length == cell->char_length &&
+           memcmp(expected->char_data, cell->char_data, cell->char_length) ==
+               0;
+  case INT_TYPE:
+    return expected->int_data == cell->int_data;
+  case DOUBLE_TYPE:
+    return memcmp(&expected->double_data, &cell->double_data,
+                  sizeof(double)) == 0;
+  }
+
+  return false;
+}
+
+/* -- Cells of a source row against the columns of a joined row from begin,
+ * a source row of SIZE_MAX expects nulls */
+static bool same_row(CSV_LIST *join_list, CSV_METADATA *join_metadata,
+                     size_t join_row, unsigned begin, CSV_LIST *csv_list,
+                     CSV_METADATA *metadata, size_t row) {
+  for (unsigned column = 0; column < metadata->fields; column++) {
+    CSV_CELL expected = {.is_null = true};
+    CSV_CELL cell = {0};
+
+    if (row != SIZE_MAX) {
+      csv_cell(row, column, &expected, csv_list, metadata);
+    }
+
+    if (!csv_cell(join_row, begin + column, &cell, join_list, join_metadata) ||
+        !same_cell(&expected, &cell)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/************ CHECKS ************/
+
+static void check_names(CSV_LIST *join_list, CSV_METADATA *join_metadata) {
+  const char *names[] = {"left.order", "left.customer", "left.code",
+                         "left.amount", "right.customer", "right.code",
+                         "right.name"};
+
+  checks++;
+
+  if (join_metadata->fields != sizeof(names) / sizeof(*names)) {
+    printf("FAIL join has %u fields\n", join_metadata->fields);
+    failures++;
+    return;
+  }
+
+  for (unsigned column = 0; column < join_metadata->fields; column++) {
+    checks++;
+
+    if (strcmp(join_list->field_list[column]->field, names[column]) != 0) {
+      printf("FAIL column %u is %s, not %s\n", column,
+             join_list->field_list[column]->field, names[column]);
+      failures++;
+    }
+  }
+}
+
+static void check_join(CSV_LIST *left_list, CSV_METADATA *left_metadata,
+                       CSV_LIST *right_list, CSV_METADATA *right_metadata,
+                       CSV_JOIN *join, unsigned threads) {
+  CSV_OPTIONS options = {.threads = threads};
+  CSV_METADATA *join_metadata = NULL;
+
+  CSV_LIST *join_list = csv_join(left_list, left_metadata, right_list,
+                                 right_metadata, join, &join_metadata,
+                                 &options);
+
+  checks++;
+
+  if (join_list == NULL) {
+    printf("FAIL key %u, %u threads: no join\n", join->left_key, threads);
+    failures++;
+    return;
+  }
+
+  check_names(join_list, join_metadata);
+
+  size_t join_row = 0;
+  unsigned mismatches = 0;
+
+  for (size_t left_row = 0; left_row < left_metadata->items; left_row++) {
+    if (csv_row_removed(left_row, left_list)) {
+      continue;
+    }
+
+    long key = left_keys[left_row];
+    size_t matches = 0;
+    size_t begin = key >= 0 ? key_begin[key] : 0;
+    size_t end = key >= 0 ? key_begin[key + 1] : 0;
+
+    for (size_t i = begin; i < end; i++) {
+      size_t right_row = key_rows[i];
+
+      if (csv_row_removed(right_row, right_list)) {
+        continue;
+      }
+
+      matches++;
+      checks++;
+
+      if (join_row >= join_metadata->items ||
+          !same_row(join_list, join_metadata, join_row, 0, left_list,
+                    left_metadata, left_row) ||
+          !same_row(join_list, join_metadata, join_row,
+                    left_metadata->fields, right_list, right_metadata,
+                    right_row)) {
+        if (mismatches++ == 0) {
+          printf("FAIL key %u, %u threads: left row %zu, right row %zu\n",
+                 join->left_key, threads, left_row, right_row);
+        }
+
+        failures++;
+      }
+
+      join_row++;
+    }
+
+    if (matches > 0 || join->kind != CSV_JOIN_LEFT) {
+      continue;
+    }
+
+    checks++;
+
+    if (join_row >= join_metadata->items ||
+        !same_row(join_list, join_metadata, join_row, 0, left_list,
+                  left_metadata, left_row) ||
+        !same_row(join_list, join_metadata, join_row, left_metadata->fields,
+                  right_list, right_metadata, SIZE_MAX)) {
+      if (mismatches++ == 0) {
+        printf("FAIL key %u, %u threads: left row %zu without a match\n",
+               join->left_key, threads, left_row);
+      }
+
+      failures++;
+    }
+
+    join_row++;
+  }
+
+  checks++;
+
+  if (join_row != join_metadata->items) {
+    printf("FAIL key %u, %u threads: %u rows, %zu expected\n", join->left_key,
+           threads, join_metadata->items, join_row);
+    failures++;
+  }
+
+  csv_clear(join_list, join_metadata);
+}
+
+static void check_lists(unsigned left_rows, CSV_DICTIONARY_MODE mode) {
+  if (!write_left(LEFT_FILE, left_rows)) {
+    failures++;
+    return;
+  }
+
+  CSV_OPTIONS options = {.dictionary = mode, .compact_ratio = 1};
+  CSV_METADATA *left_metadata = NULL;
+  CSV_METADATA *right_metadata = NULL;
+
+  CSV_LIST *left_list = csv_import_ex(LEFT_FILE, &left_metadata, &options);
+  CSV_LIST *right_list = csv_import_ex(RIGHT_FILE, &right_metadata, &options);
+
+  checks++;
+
+  if (left_list == NULL || right_list == NULL) {
+    printf("FAIL unable to import the lists\n");
+    failures++;
+  } else {
+    /* -- Removed rows take part on neither side */
+    size_t removed[] = {1, 7, 100, 2500, 9999};
+
+    csv_remove_rows(removed, sizeof(removed) / sizeof(*removed), left_list,
+                    left_metadata);
+    csv_remove_rows(removed, sizeof(removed) / sizeof(*removed), right_list,
+                    right_metadata);
+
+    CSV_JOIN_KIND kinds[] = {CSV_JOIN_INNER, CSV_JOIN_LEFT};
+    unsigned threads[] = {0, 4};
+
+    for (unsigned k = 0; k < sizeof(kinds) / sizeof(*kinds); k++) {
+      for (unsigned t = 0; t < sizeof(threads) / sizeof(*threads); t++) {
+        CSV_JOIN numbers = {.kind = kinds[k], .left_key = 1, .right_key = 0};
+        CSV_JOIN strings = {.kind = kinds[k], .left_key = 2, .right_key = 1};
+
+        check_join(left_list, left_metadata, right_list, right_metadata,
+                   &numbers, threads[t]);
+        check_join(left_list, left_metadata, right_list, right_metadata,
+                   &strings, threads[t]);
+      }
+    }
+  }
+
+  if (left_list != NULL) {
+    csv_clear(left_list, left_metadata);
+  }
+
+  if (right_list != NULL) {
+    csv_clear(right_list, right_metadata);
+  }
+
+  remove(LEFT_FILE);
+}
+
+int main(void) {
+  if (!write_right(RIGHT_FILE)) {
+    return 1;
+  }
+
+  /* -- The right list is hashed, then the left one */
+  check_lists(LEFT_ROWS, CSV_DICTIONARY_AUTO);
+  check_lists(LEFT_ROWS, CSV_DICTIONARY_OFF);
+  check_lists(10000, CSV_DICTIONARY_AUTO);
+
+  remove(RIGHT_FILE);
+
+  printf("%lu checks, %lu failures\n", checks, failures);
+
+  return failures == 0 ? 0 : 1;
+}
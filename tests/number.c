@@ -0,0 +1,239 @@
+/**
+ * @file number.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Checks util_string_to_double() and util_string_to_number() against
+ * strtod() and strtoll(), bit for bit
+ *
+ * @version 0.1
+ * @date 2025-01-14
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util.h>
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/* -- xorshift64*, the same sequence on every run */
+static uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
+/************ DOUBLES ************/
+
+static void check_double(const char *string) {
+  size_t length = strlen(string);
+  char *characters = NULL;
+
+  double expected = strtod(string, &characters);
+  double data = 0;
+
+  int status = util_string_to_double(string, length, &data);
+
+  checks++;
+
+  if (*characters != '\0' || length == 0) {
+    if (status == 0) {
+      printf("FAIL %s: accepted, strtod() stops early\n", string);
+      failures++;
+    }
+
+    return;
+  }
+
+  if (status != 0 || memcmp(&data, &expected, sizeof(double)) != 0) {
+    printf("FAIL %s: %.17g, strtod() gives %.17g\n", string, data, expected);
+    failures++;
+  }
+}
+
+static void check_bits(uint64_t bits) {
+  double data = 0;
+  char buffer[64];
+
+  memcpy(&data, &bits, sizeof(bits));
+
+  /* -- NaN and infinity are not spelled with digits */
+  if (data != data || data - data != 0) {
+    return;
+  }
+
+  for (int precision = 1; precision <= 17; precision += 4) {
+    snprintf(buffer, sizeof(buffer), "%.*g", precision, data);
+    check_double(buffer);
+
+    snprintf(buffer, sizeof(buffer), "%.*e", precision, data);
+    check_double(buffer);
+  }
+
+  snprintf(buffer, sizeof(buffer), "%.17g", data);
+  check_double(buffer);
+}
+
+static void check_digits(unsigned digits, int exponent) {
+  char buffer[128];
+  unsigned length = 0;
+
+  if (next_random() & 1) {
+    buffer[length++] = '-';
+  }
+
+  unsigned point = (unsigned)(next_random() % (digits + 1));
+
+  for (unsigned i = 0; i < digits; i++) {
+    if (i == point) {
+      buffer[length++] = '.';
+    }
+
+    buffer[length++] = (char)('0' + next_random() % 10);
+  }
+
+  snprintf(buffer + length, sizeof(buffer) - length, "e%d", exponent);
+  check_double(buffer);
+
+  buffer[length] = '\0';
+  check_double(buffer);
+}
+
+static void check_doubles(void) {
+  static const char *cases[] = {
+      "0", "-0", "0.0", "-0.0", ".5", "5.", "+1.5", "1e0", "1E+2", "1e-2",
+      "00000000000000000000000001.5", "0.000000000000000000000000000001",
+      "1.7976931348623157e308", "1.7976931348623159e308", "1e309", "-1e400",
+      "2.2250738585072014e-308", "2.2250738585072011e-308", "4.9e-324",
+      "2.4703282292062327e-324", "2.4703282292062328e-324", "1e-400",
+      "9007199254740992", "9007199254740993", "9007199254740994",
+      "9007199254740993.0000000000000000001", "0.1", "0.2", "0.3",
+      "3.14159265358979323846264338327950288419716939937510",
+      "1.00000000000000011102230246251565404236316680908203125",
+      "1.00000000000000011102230246251565404236316680908203124",
+      "1.00000000000000011102230246251565404236316680908203126",
+      "7.2057594037927933e16", "123456789012345678901234567890e-10",
+      "1e23", "8.98846567431158e307", "1e22", "1e-22", "4503599627370496.5",
+      "4503599627370497.5", "1e99999999999", "1e-99999999999",
+      /* -- Not numbers */
+      "", "-", "+", ".", "e5", "1e", "1e+", "1.5x", "1..5", "1.5 ", "--1",
+      "1e5.5"};
+
+  /* -- strtod() takes these, cells are decimal only */
+  static const char *rejected[] = {" 1.5", "0x10", "inf", "nan", "-infinity"};
+
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    check_double(cases[i]);
+  }
+
+  for (size_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); i++) {
+    double data = 0;
+
+    checks++;
+
+    if (util_string_to_double(rejected[i], strlen(rejected[i]), &data) == 0) {
+      printf("FAIL %s: accepted\n", rejected[i]);
+      failures++;
+    }
+  }
+
+  /* -- Every bit pattern class, normals and subnormals */
+  for (int i = 0; i < 200000; i++) {
+    check_bits(next_random());
+    check_bits(next_random() >> 12);
+  }
+
+  /* -- Decimal strings of every length, including long truncated ones */
+  for (int i = 0; i < 200000; i++) {
+    unsigned digits = 1 + (unsigned)(next_random() % 40);
+    int exponent = (int)(next_random() % 700) - 350;
+
+    check_digits(digits, exponent);
+  }
+
+  /* -- Halfway between two doubles, 17 digits then a tail */
+  for (int i = 0; i < 50000; i++) {
+    uint64_t bits = next_random() >> 2;
+    double low = 0;
+    double high = 0;
+    char buffer[128];
+
+    memcpy(&low, &bits, sizeof(bits));
+    bits += 1;
+    memcpy(&high, &bits, sizeof(bits));
+
+    if (low != low || high - high != 0) {
+      continue;
+    }
+
+    snprintf(buffer, sizeof(buffer), "%.40e", low / 2 + high / 2);
+    check_double(buffer);
+  }
+}
+
+/************ INTEGERS ************/
+
+static void check_number(const char *string) {
+  size_t length = strlen(string);
+  char *characters = NULL;
+
+  errno = 0;
+
+  long long expected = strtoll(string, &characters, 10);
+  bool valid = length > 0 && *characters == '\0' && errno != ERANGE &&
+               string[0] != ' ';
+
+  int64_t data = 0;
+  int status = util_string_to_number(string, length, &data);
+
+  checks++;
+
+  if ((status == 0) != valid || (valid && data != expected)) {
+    printf("FAIL %s: %lld, strtoll() gives %lld\n", string, (long long)data,
+           expected);
+    failures++;
+  }
+}
+
+static void check_numbers(void) {
+  static const char *cases[] = {
+      "0", "-0", "+0", "7", "-7", "12345678", "123456789", "1234567890123456",
+      "9223372036854775807", "9223372036854775808", "-9223372036854775808",
+      "-9223372036854775809", "18446744073709551616", "00000000000000000000042",
+      "99999999999999999999", "", "-", "+", "1a", "a1", "12345678a", "1.0",
+      "1e3", "--1"};
+
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    check_number(cases[i]);
+  }
+
+  char buffer[64];
+
+  for (int i = 0; i < 200000; i++) {
+    int64_t value = (int64_t)(next_random() >> (next_random() % 64));
+
+    snprintf(buffer, sizeof(buffer), "%lld",
+             (long long)(i & 1 ? -value : value));
+    check_number(buffer);
+  }
+}
+
+int main(void) {
+  check_doubles();
+  check_numbers();
+
+  printf("%lu checks, %lu failures\n", checks, failures);
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/**
+ * @file parallel.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Checks that a threaded import gives the same list as a single
+ * threaded one, cell by cell, on quoted and multi-line fields
+ *
+ * @version 0.1
+ * @date 2025-01-27
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcsv.h>
+
+#define TEST_FILE "build/parallel.csv"
+#define TEST_ROWS 300000
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/* -- xorshift64*, the same sequence on every run */
+static uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
+/************ INPUT ************/
+
+/* -- Quotes inside unquoted fields are plain characters for the parser,
+ * they must not flip the quote state of the cuts */
+static const char *fields[] = {
+    "plain",           "\"m\nl\"",      "x\"y",          "\"a,b\"",
+    "\"say \"\"hi\"\"\"", " \"spaced\" ", "\"ab\"cd\"e",   "\"\"",
+    "",                "\"\n\n\"",      "z\"\"\"",       "\"tail\"\"\n\"",
+};
+
+static bool write_file(const char *csv_file) {
+  FILE *csv_stream = fopen(csv_file, "w");
+
+  if (csv_stream == NULL) {
+    printf("FAIL unable to write %s\n", csv_file);
+    return false;
+  }
+
+  fprintf(csv_stream, "id,score,note,city\n");
+
+  for (unsigned row = 0; row < TEST_ROWS; row++) {
+    uint64_t random = next_random();
+    const char *note = fields[random % (sizeof(fields) / sizeof(*fields))];
+
+    /* -- One stray quote well after the sample rows */
+    if (row == 50000) {
+      note = "x\"y";
+    }
+
+    fprintf(csv_stream, "%u,%.3f,%s,city%u\n", row,
+            (double)(random >> 40) / 1000, note, (unsigned)(random >> 20) % 97);
+  }
+
+  return fclose(csv_stream) == 0;
+}
+
+/************ COMPARE ************/
+
+static bool same_cell(CSV_CELL *expected, CSV_CELL *cell) {
+  if (expected->is_null || cell->is_null) {
+    return expected->is_null == cell->is_null;
+  }
+
+  if (expected->field_type != cell->field_type) {
+    return false;
+  }
+
+  switch (cell->field_type) {
+  case CHAR_TYPE:
+    return expected->char_length == cell->char_length &&
+           memcmp(expected->char_data, cell->char_data, cell->char_length) ==
+               0;
+  case INT_TYPE:
+    return expected->int_data == cell->int_data;
+  case DOUBLE_TYPE:
+    return memcmp(&expected->double_data, &cell->double_data,
+                  sizeof(double)) == 0;
+  }
+
+  return false;
+}
+
+static void check_import(const char *csv_file, CSV_LIST *expected_list,
+                         CSV_METADATA *expected_metadata,
+                         CSV_OPTIONS *options) {
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = csv_import_ex((char *)csv_file, &metadata, options);
+
+  checks++;
+
+  if (csv_list == NULL || metadata->items != expected_metadata->items ||
+      metadata->fields != expected_metadata->fields) {
+    printf("FAIL %u threads: %u rows, single threaded gives %u\n",
+           options->threads, csv_list ? metadata->items : 0,
+           expected_metadata->items);
+    failures++;
+
+    if (csv_list != NULL) {
+      csv_clear(csv_list, metadata);
+    }
+
+    return;
+  }
+
+  unsigned mismatches = 0;
+
+  for (size_t row = 0; row < metadata->items; row++) {
+    for (unsigned column = 0; column < metadata->fields; column++) {
+      CSV_CELL expected = {0};
+      CSV_CELL cell = {0};
+
+      csv_cell(row, column, &expected, expected_list, expected_metadata);
+      csv_cell(row, column, &cell, csv_list, metadata);
+
+      checks++;
+
+      if (!same_cell(&expected, &cell)) {
+        /* -- One line is enough to find a bad cut */
+        if (mismatches++ == 0) {
+          printf("FAIL %u threads: row %zu column %u differs\n",
+                 options->threads, row, column);
+        }
+
+        failures++;
+      }
+    }
+  }
+
+  csv_clear(csv_list, metadata);
+}
+
+int main(void) {
+  if (!write_file(TEST_FILE)) {
+    return 1;
+  }
+
+  CSV_DICTIONARY_MODE modes[] = {CSV_DICTIONARY_AUTO, CSV_DICTIONARY_OFF};
+
+  for (unsigned m = 0; m < sizeof(modes) / sizeof(*modes); m++) {
+    CSV_OPTIONS options = {.dictionary = modes[m]};
+    CSV_METADATA *metadata = NULL;
+
+    CSV_LIST *csv_list = csv_import_ex(TEST_FILE, &metadata, &options);
+
+    if (csv_list == NULL) {
+      printf("FAIL unable to import %s\n", TEST_FILE);
+      failures++;
+      continue;
+    }
+
+    unsigned threads[] = {2, 3, 4, 8};
+
+    for (unsigned t = 0; t < sizeof(threads) / sizeof(*threads); t++) {
+      options.threads = threads[t];
+      check_import(TEST_FILE, csv_list, metadata, &options);
+    }
+
+    csv_clear(csv_list, metadata);
+  }
+
+  remove(TEST_FILE);
+
+  printf("%lu checks, %lu failures\n", checks, failures);
+
+  return failures == 0 ? 0 : 1;
+}
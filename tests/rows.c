@@ -0,0 +1,294 @@
+/**
+ * @file rows.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Checks removed rows: they are hidden from reads and aggregates until
+ * the list is compacted, compaction keeps the other rows in order and starts
+ * on its own past the dead row ratio
+ *
+ * @version 0.1
+ * @date 2025-01-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcsv.h>
+
+#define TEST_FILE "build/rows.csv"
+#define TEST_ROWS 1000
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/************ INPUT ************/
+
+/* -- Row n holds id n and name "name<n>" */
+static bool write_file(const char *csv_file) {
+  FILE *csv_stream = fopen(csv_file, "w");
+
+  if (csv_stream == NULL) {
+    printf("FAIL unable to write %s\n", csv_file);
+    return false;
+  }
+
+  fprintf(csv_stream, "id,name\n");
+
+  for (unsigned row = 0; row < TEST_ROWS; row++) {
+    fprintf(csv_stream, "%u,name%u\n", row, row);
+  }
+
+  return fclose(csv_stream) == 0;
+}
+
+static CSV_LIST *import_file(CSV_METADATA **metadata, double compact_ratio) {
+  CSV_OPTIONS options = {.compact_ratio = compact_ratio};
+  CSV_LIST *csv_list = csv_import_ex(TEST_FILE, metadata, &options);
+
+  checks++;
+
+  if (csv_list == NULL || (*metadata)->items != TEST_ROWS) {
+    printf("FAIL unable to import %s\n", TEST_FILE);
+    failures++;
+    return NULL;
+  }
+
+  return csv_list;
+}
+
+/************ COMPARE ************/
+
+/* -- Row row holds the source row id, in both columns */
+static bool holds(CSV_LIST *csv_list, CSV_METADATA *metadata, size_t row,
+                  size_t id) {
+  CSV_CELL cells[2] = {{0}};
+  CSV_ROW row_data = {.cells = cells};
+  char name[32];
+
+  int length = snprintf(name, sizeof(name), "name%zu", id);
+
+  return csv_row(row, &row_data, csv_list, metadata) &&
+         row_data.fields == 2 && cells[0].int_data == (int64_t)id &&
+         cells[1].char_length == (size_t)length &&
+         memcmp(cells[1].char_data, name, length) == 0;
+}
+
+/* -- The rows left are the ids not in removed, in order */
+static void check_rows(const char *name, CSV_LIST *csv_list,
+                       CSV_METADATA *metadata, const bool *removed) {
+  size_t row = 0;
+  unsigned mismatches = 0;
+
+  for (size_t id = 0; id < TEST_ROWS; id++) {
+    if (removed[id]) {
+      continue;
+    }
+
+    checks++;
+
+    if (row >= metadata->items || !holds(csv_list, metadata, row, id)) {
+      if (mismatches++ == 0) {
+        printf("FAIL %s: row %zu does not hold id %zu\n", name, row, id);
+      }
+
+      failures++;
+    }
+
+    row++;
+  }
+
+  checks++;
+
+  if (row != metadata->items) {
+    printf("FAIL %s: %u rows, %zu expected\n", name, metadata->items, row);
+    failures++;
+  }
+}
+
+/************ CHECKS ************/
+
+static void check_tombstones(void) {
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = import_file(&metadata, 1);
+
+  if (csv_list == NULL) {
+    return;
+  }
+
+  bool removed[TEST_ROWS] = {false};
+  size_t rows[TEST_ROWS];
+  size_t total_rows = 0;
+  int64_t sum = 0;
+  size_t max = 0;
+
+  for (size_t id = 0; id < TEST_ROWS; id++) {
+    removed[id] = id % 3 == 0 || id == 998;
+
+    if (removed[id]) {
+      rows[total_rows++] = id;
+    } else {
+      sum += id;
+      max = id;
+    }
+  }
+
+  /* -- Twice the same rows and one past the end change nothing more */
+  csv_remove_rows(rows, total_rows, csv_list, metadata);
+  csv_remove_rows(rows, total_rows / 2, csv_list, metadata);
+
+  size_t past_end = TEST_ROWS;
+
+  csv_remove_rows(&past_end, 1, csv_list, metadata);
+
+  checks++;
+
+  if (metadata->items != TEST_ROWS) {
+    printf("FAIL removed rows were compacted with a ratio of 1\n");
+    failures++;
+  }
+
+  unsigned mismatches = 0;
+
+  for (size_t row = 0; row < TEST_ROWS; row++) {
+    CSV_CELL cell = {0};
+
+    bool hidden = csv_row_removed(row, csv_list) &&
+                  !csv_cell(row, 0, &cell, csv_list, metadata);
+    bool shown = !csv_row_removed(row, csv_list) &&
+                 holds(csv_list, metadata, row, row);
+
+    checks++;
+
+    if (removed[row] ? !hidden : !shown) {
+      if (mismatches++ == 0) {
+        printf("FAIL row %zu is %s\n", row,
+               removed[row] ? "not removed" : "removed");
+      }
+
+      failures++;
+    }
+  }
+
+  CSV_FIELD_LIST *id_list = csv_column(0, csv_list, metadata);
+
+  checks++;
+
+  if (csv_agg_count(id_list, NULL) != TEST_ROWS - total_rows ||
+      csv_agg_sum(id_list, NULL, CSV_SUM_FAST) != (double)sum ||
+      csv_agg_max(id_list, NULL) != (double)max) {
+    printf("FAIL aggregates count removed rows\n");
+    failures++;
+  }
+
+  /* -- Removing one row compacts right away, the pending rows too */
+  csv_remove_row(1, csv_list, metadata);
+  removed[1] = true;
+
+  check_rows("csv_remove_row", csv_list, metadata, removed);
+
+  checks++;
+
+  for (size_t row = 0; row < metadata->items; row++) {
+    if (csv_row_removed(row, csv_list)) {
+      printf("FAIL row %zu is still removed after compaction\n", row);
+      failures++;
+      break;
+    }
+  }
+
+  /* -- Rows appended after compaction are live */
+  const char *more = "1000,name1000\n";
+
+  checks++;
+
+  if (csv_append_buffer(more, strlen(more), csv_list, metadata) != 1 ||
+      !holds(csv_list, metadata, metadata->items - 1, 1000)) {
+    printf("FAIL a row appended after compaction is missing\n");
+    failures++;
+  }
+
+  csv_clear(csv_list, metadata);
+}
+
+static void check_compact(void) {
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = import_file(&metadata, 1);
+
+  if (csv_list == NULL) {
+    return;
+  }
+
+  bool removed[TEST_ROWS] = {false};
+  size_t rows[TEST_ROWS];
+  size_t total_rows = 0;
+
+  for (size_t id = 0; id < TEST_ROWS; id += 7) {
+    removed[id] = true;
+    rows[total_rows++] = id;
+  }
+
+  csv_remove_rows(rows, total_rows, csv_list, metadata);
+  csv_compact(csv_list, metadata);
+
+  check_rows("csv_compact", csv_list, metadata, removed);
+
+  csv_clear(csv_list, metadata);
+}
+
+/* -- Past CSV_COMPACT_RATIO dead rows the list compacts itself */
+static void check_ratio(void) {
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = import_file(&metadata, 0);
+
+  if (csv_list == NULL) {
+    return;
+  }
+
+  bool removed[TEST_ROWS] = {false};
+  size_t rows[TEST_ROWS];
+  size_t total_rows = 0;
+
+  for (size_t id = 0; id < TEST_ROWS * CSV_COMPACT_RATIO; id++) {
+    removed[id * 2 % TEST_ROWS] = true;
+    rows[total_rows++] = id * 2 % TEST_ROWS;
+  }
+
+  csv_remove_rows(rows, total_rows, csv_list, metadata);
+
+  checks++;
+
+  if (metadata->items != TEST_ROWS) {
+    printf("FAIL compacted at %zu dead rows\n", total_rows);
+    failures++;
+  }
+
+  size_t one_more = 1;
+
+  removed[one_more] = true;
+  csv_remove_rows(&one_more, 1, csv_list, metadata);
+
+  check_rows("compact ratio", csv_list, metadata, removed);
+
+  csv_clear(csv_list, metadata);
+}
+
+int main(void) {
+  if (!write_file(TEST_FILE)) {
+    return 1;
+  }
+
+  check_tombstones();
+  check_compact();
+  check_ratio();
+
+  remove(TEST_FILE);
+
+  printf("%lu checks, %lu failures\n", checks, failures);
+
+  return failures == 0 ? 0 : 1;
+}
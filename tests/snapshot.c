@@ -0,0 +1,492 @@
+/**
+ * @file snapshot.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Checks that a snapshot loads back the live rows of the list it was
+ * saved from, that damaged snapshots are refused and that CSV_OPTIONS
+ * snapshot reuses one only while the CSV file keeps its size and mtime
+ *
+ * @version 0.1
+ * @date 2025-01-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <libcsv.h>
+
+#define TEST_FILE "build/snapshot.csv"
+#define SNAPSHOT_FILE "build/snapshot.bin"
+#define DAMAGED_FILE "build/snapshot-damaged.bin"
+#define CACHE_FILE "build/snapshot-cache.bin"
+#define TEST_ROWS 20000
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/* -- xorshift64*, the same sequence on every run */
+static uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
+/************ INPUT ************/
+
+static const char *notes[] = {"plain", "\"a,b\"", "\"say \"\"hi\"\"\"",
+                              "\"m\nl\"", "", "x\"y", "\"\""};
+
+static bool write_file(const char *csv_file, unsigned rows) {
+  FILE *csv_stream = fopen(csv_file, "w");
+
+  if (csv_stream == NULL) {
+    printf("FAIL unable to write %s\n", csv_file);
+    return false;
+  }
+
+  fprintf(csv_stream, "id,score,city,note,count\n");
+
+  for (unsigned row = 0; row < rows; row++) {
+    uint64_t random = next_random();
+    const char *note = notes[random % (sizeof(notes) / sizeof(*notes))];
+
+    fprintf(csv_stream, "%u,", row);
+
+    if ((random >> 8) % 20 != 0) {
+      fprintf(csv_stream, "%.4f", (double)(random >> 30) / 7);
+    }
+
+    /* -- Few cities, the column gets a dictionary */
+    fprintf(csv_stream, ",city%u,%s,", (unsigned)(random >> 16) % 31, note);
+
+    if ((random >> 24) % 10 != 0) {
+      fprintf(csv_stream, "%lld", (long long)(random >> 2) - (1LL << 61));
+    }
+
+    fprintf(csv_stream, "\n");
+  }
+
+  return fclose(csv_stream) == 0;
+}
+
+static bool read_bytes(const char *file, char **data, size_t *size) {
+  FILE *stream = fopen(file, "rb");
+
+  if (stream == NULL) {
+    return false;
+  }
+
+  fseek(stream, 0, SEEK_END);
+  *size = ftell(stream);
+  fseek(stream, 0, SEEK_SET);
+
+  *data = malloc(*size ? *size : 1);
+
+  bool read = *data != NULL && fread(*data, 1, *size, stream) == *size;
+
+  fclose(stream);
+
+  return read;
+}
+
+static bool write_bytes(const char *file, const char *data, size_t size) {
+  FILE *stream = fopen(file, "wb");
+
+  if (stream == NULL) {
+    return false;
+  }
+
+  bool written = fwrite(data, 1, size, stream) == size;
+
+  return fclose(stream) == 0 && written;
+}
+
+/************ COMPARE ************/
+
+static bool same_cell(CSV_CELL *expected, CSV_CELL *cell) {
+  if (expected->is_null || cell->is_null) {
+    return expected->is_null == cell->is_null;
+  }
+
+  if (expected->field_type != cell->field_type) {
+    return false;
+  }
+
+  switch (cell->field_type) {
+  case CHAR_TYPE:
+    return expected->char_length == cell->char_length &&
+           memcmp(expected->char_data, cell->char_data, cell->char_length) ==
+               0;
+  case INT_TYPE:
+    return expected->int_data == cell->int_data;
+  case DOUBLE_TYPE:
+    return memcmp(&expected->double_data, &cell->double_data,
+                  sizeof(double)) == 0;
+  }
+
+  return false;
+}
+
+/* -- The live rows of expected_list in order, against every row of
+ * csv_list */
+static bool same_list(CSV_LIST *expected_list,
+                      CSV_METADATA *expected_metadata, CSV_LIST *csv_list,
+                      CSV_METADATA *metadata) {
+  if (metadata->fields != expected_metadata->fields) {
+    return false;
+  }
+
+  for (unsigned column = 0; column < metadata->fields; column++) {
+    if (strcmp(expected_list->field_list[column]->field,
+               csv_list->field_list[column]->field) != 0 ||
+        expected_list->field_list[column]->field_type !=
+            csv_list->field_list[column]->field_type) {
+      return false;
+    }
+  }
+
+  size_t row = 0;
+
+  for (size_t expected_row = 0; expected_row < expected_metadata->items;
+       expected_row++) {
+    if (csv_row_removed(expected_row, expected_list)) {
+      continue;
+    }
+
+    for (unsigned column = 0; column < metadata->fields; column++) {
+      CSV_CELL expected = {0};
+      CSV_CELL cell = {0};
+
+      csv_cell(expected_row, column, &expected, expected_list,
+               expected_metadata);
+
+      if (!csv_cell(row, column, &cell, csv_list, metadata) ||
+          !same_cell(&expected, &cell)) {
+        return false;
+      }
+    }
+
+    row++;
+  }
+
+  return row == metadata->items;
+}
+
+/************ CHECKS ************/
+
+static void check_round_trip(CSV_DICTIONARY_MODE mode) {
+  CSV_OPTIONS options = {.dictionary = mode, .compact_ratio = 1};
+  CSV_METADATA *metadata = NULL;
+
+  CSV_LIST *csv_list = csv_import_ex(TEST_FILE, &metadata, &options);
+
+  checks++;
+
+  if (csv_list == NULL) {
+    printf("FAIL unable to import %s\n", TEST_FILE);
+    failures++;
+    return;
+  }
+
+  /* -- Removed rows are left out of the snapshot */
+  size_t removed[] = {0, 2, 3, 500, 19999};
+
+  csv_remove_rows(removed, sizeof(removed) / sizeof(*removed), csv_list,
+                  metadata);
+
+  checks++;
+
+  if (csv_snapshot_save(csv_list, metadata, SNAPSHOT_FILE, NULL) != 0) {
+    printf("FAIL dictionary %d: unable to save\n", mode);
+    failures++;
+    csv_clear(csv_list, metadata);
+    return;
+  }
+
+  CSV_METADATA *loaded_metadata = NULL;
+  CSV_LIST *loaded_list =
+      csv_snapshot_load(SNAPSHOT_FILE, &loaded_metadata, &options);
+
+  checks++;
+
+  if (loaded_list == NULL ||
+      !same_list(csv_list, metadata, loaded_list, loaded_metadata)) {
+    printf("FAIL dictionary %d: the loaded list differs\n", mode);
+    failures++;
+  }
+
+  /* -- A loaded list is a list like any other, it can be saved again */
+  if (loaded_list != NULL) {
+    CSV_METADATA *again_metadata = NULL;
+    CSV_LIST *again_list = NULL;
+
+    if (csv_snapshot_save(loaded_list, loaded_metadata, DAMAGED_FILE, NULL) ==
+        0) {
+      again_list = csv_snapshot_load(DAMAGED_FILE, &again_metadata, NULL);
+    }
+
+    checks++;
+
+    if (again_list == NULL ||
+        !same_list(csv_list, metadata, again_list, again_metadata)) {
+      printf("FAIL dictionary %d: the list saved again differs\n", mode);
+      failures++;
+    }
+
+    if (again_list != NULL) {
+      csv_clear(again_list, again_metadata);
+    }
+
+    csv_clear(loaded_list, loaded_metadata);
+  }
+
+  csv_clear(csv_list, metadata);
+}
+
+/* -- A damaged byte is refused, or it was padding and changes nothing */
+static void check_damage(void) {
+  if (!write_file(TEST_FILE, 300)) {
+    failures++;
+    return;
+  }
+
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = csv_import(TEST_FILE, &metadata);
+
+  char *data = NULL;
+  size_t size = 0;
+
+  checks++;
+
+  if (csv_list == NULL ||
+      csv_snapshot_save(csv_list, metadata, SNAPSHOT_FILE, NULL) != 0 ||
+      !read_bytes(SNAPSHOT_FILE, &data, &size)) {
+    printf("FAIL unable to save a snapshot to damage\n");
+    failures++;
+    free(data);
+
+    if (csv_list != NULL) {
+      csv_clear(csv_list, metadata);
+    }
+
+    return;
+  }
+
+  size_t refused = 0;
+  size_t damaged = 0;
+
+  /* -- Every refused load explains itself on stderr, keep it quiet */
+  int error_fd = dup(STDERR_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+
+  fflush(stderr);
+  dup2(null_fd, STDERR_FILENO);
+
+  for (size_t position = 0; position < size; position += 7) {
+    data[position] ^= 0x20;
+
+    CSV_METADATA *loaded_metadata = NULL;
+    CSV_LIST *loaded_list = NULL;
+
+    if (write_bytes(DAMAGED_FILE, data, size)) {
+      loaded_list = csv_snapshot_load(DAMAGED_FILE, &loaded_metadata, NULL);
+    }
+
+    data[position] ^= 0x20;
+    damaged++;
+
+    if (loaded_list == NULL) {
+      refused++;
+      continue;
+    }
+
+    checks++;
+
+    if (!same_list(csv_list, metadata, loaded_list, loaded_metadata)) {
+      printf("FAIL byte %zu damaged: the list loads with other data\n",
+             position);
+      failures++;
+    }
+
+    csv_clear(loaded_list, loaded_metadata);
+  }
+
+  checks++;
+
+  /* -- Only padding between the sections goes unchecked */
+  if (refused < damaged * 9 / 10) {
+    printf("FAIL %zu of %zu damaged bytes refused\n", refused, damaged);
+    failures++;
+  }
+
+  /* -- Cut short anywhere */
+  size_t lengths[] = {0, 7, 64, size / 2, size - 1};
+
+  for (unsigned i = 0; i < sizeof(lengths) / sizeof(*lengths); i++) {
+    CSV_METADATA *loaded_metadata = NULL;
+    CSV_LIST *loaded_list = NULL;
+
+    if (write_bytes(DAMAGED_FILE, data, lengths[i])) {
+      loaded_list = csv_snapshot_load(DAMAGED_FILE, &loaded_metadata, NULL);
+    }
+
+    checks++;
+
+    if (loaded_list != NULL) {
+      printf("FAIL snapshot cut to %zu bytes loads\n", lengths[i]);
+      failures++;
+      csv_clear(loaded_list, loaded_metadata);
+    }
+  }
+
+  fflush(stderr);
+  dup2(error_fd, STDERR_FILENO);
+  close(error_fd);
+  close(null_fd);
+
+  free(data);
+  csv_clear(csv_list, metadata);
+}
+
+/* -- Same size and mtime reuse the snapshot, anything else imports again */
+static void check_cache(void) {
+  remove(CACHE_FILE);
+
+  if (!write_file(TEST_FILE, 1000)) {
+    failures++;
+    return;
+  }
+
+  CSV_OPTIONS options = {.snapshot = CACHE_FILE};
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = csv_import_ex(TEST_FILE, &metadata, &options);
+
+  struct stat cache_stat;
+  struct stat source_stat;
+
+  checks++;
+
+  if (csv_list == NULL || stat(CACHE_FILE, &cache_stat) != 0 ||
+      stat(TEST_FILE, &source_stat) != 0) {
+    printf("FAIL the import wrote no snapshot\n");
+    failures++;
+
+    if (csv_list != NULL) {
+      csv_clear(csv_list, metadata);
+    }
+
+    return;
+  }
+
+  /* -- Other rows of the same length, the mtime put back */
+  char *data = NULL;
+  size_t size = 0;
+
+  if (read_bytes(TEST_FILE, &data, &size)) {
+    char *row = strstr(data, "\n0,");
+
+    if (row != NULL) {
+      row[1] = '9';
+    }
+
+    write_bytes(TEST_FILE, data, size);
+  }
+
+  free(data);
+
+  struct timespec times[2] = {source_stat.st_atim, source_stat.st_mtim};
+
+  utimensat(AT_FDCWD, TEST_FILE, times, 0);
+
+  CSV_METADATA *cached_metadata = NULL;
+  CSV_LIST *cached_list = csv_import_ex(TEST_FILE, &cached_metadata, &options);
+
+  checks++;
+
+  if (cached_list == NULL ||
+      !same_list(csv_list, metadata, cached_list, cached_metadata)) {
+    printf("FAIL an unchanged size and mtime did not reuse the snapshot\n");
+    failures++;
+  }
+
+  if (cached_list != NULL) {
+    csv_clear(cached_list, cached_metadata);
+  }
+
+  /* -- A new mtime imports the file again and replaces the snapshot */
+  times[1].tv_sec -= 100;
+
+  utimensat(AT_FDCWD, TEST_FILE, times, 0);
+
+  CSV_METADATA *fresh_metadata = NULL;
+  CSV_LIST *fresh_list = csv_import_ex(TEST_FILE, &fresh_metadata, &options);
+
+  CSV_CELL cell = {0};
+
+  checks++;
+
+  if (fresh_list == NULL ||
+      !csv_cell(0, 0, &cell, fresh_list, fresh_metadata) ||
+      cell.int_data != 9) {
+    printf("FAIL a new mtime did not import the file again\n");
+    failures++;
+  }
+
+  CSV_METADATA *reloaded_metadata = NULL;
+  CSV_LIST *reloaded_list =
+      csv_import_ex(TEST_FILE, &reloaded_metadata, &options);
+
+  checks++;
+
+  if (fresh_list == NULL || reloaded_list == NULL ||
+      !same_list(fresh_list, fresh_metadata, reloaded_list,
+                 reloaded_metadata)) {
+    printf("FAIL the snapshot written again differs\n");
+    failures++;
+  }
+
+  if (reloaded_list != NULL) {
+    csv_clear(reloaded_list, reloaded_metadata);
+  }
+
+  if (fresh_list != NULL) {
+    csv_clear(fresh_list, fresh_metadata);
+  }
+
+  csv_clear(csv_list, metadata);
+  remove(CACHE_FILE);
+}
+
+int main(void) {
+  if (!write_file(TEST_FILE, TEST_ROWS)) {
+    return 1;
+  }
+
+  check_round_trip(CSV_DICTIONARY_AUTO);
+  check_round_trip(CSV_DICTIONARY_OFF);
+
+  check_damage();
+  check_cache();
+
+  remove(TEST_FILE);
+  remove(SNAPSHOT_FILE);
+  remove(DAMAGED_FILE);
+
+  printf("%lu checks, %lu failures\n", checks, failures);
+
+  return failures == 0 ? 0 : 1;
+}
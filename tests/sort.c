@@ -0,0 +1,325 @@
+/**
+ * @file sort.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Checks that csv_sort() returns every live row once, ordered by the
+ * keys and stable, and that csv_permute() moves the rows in that order
+ *
+ * @version 0.1
+ * @date 2025-01-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcsv.h>
+
+#define TEST_FILE "build/sort.csv"
+#define TEST_ROWS 200000
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/* -- xorshift64*, the same sequence on every run */
+static uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
+/************ INPUT ************/
+
+/* -- Names share their first 8 bytes often, so the whole string decides */
+static const char *names[] = {
+    "prefix00",  "prefix00a", "prefix00b", "prefix001", "prefix01",
+    "prefix0",   "alpha",     "alphabet",  "zeta",      "\"q,uoted\"",
+    "prefix00aa"};
+
+static bool write_file(const char *csv_file) {
+  FILE *csv_stream = fopen(csv_file, "w");
+
+  if (csv_stream == NULL) {
+    printf("FAIL unable to write %s\n", csv_file);
+    return false;
+  }
+
+  fprintf(csv_stream, "id,group,score,name\n");
+
+  for (unsigned row = 0; row < TEST_ROWS; row++) {
+    uint64_t random = next_random();
+    const char *name = names[random % (sizeof(names) / sizeof(*names))];
+
+    fprintf(csv_stream, "%u,", row);
+
+    /* -- Few distinct groups, so the later keys break many ties */
+    if ((random >> 8) % 50 != 0) {
+      fprintf(csv_stream, "%d", (int)((random >> 16) % 7) - 3);
+    }
+
+    fprintf(csv_stream, ",");
+
+    if ((random >> 24) % 40 != 0) {
+      fprintf(csv_stream, "%.1f", (double)((random >> 32) % 2001) / 10 - 100);
+    }
+
+    fprintf(csv_stream, ",%s\n", name);
+  }
+
+  return fclose(csv_stream) == 0;
+}
+
+/************ COMPARE ************/
+
+/* -- Ascending order of two cells, nulls last */
+static int compare_cells(CSV_CELL *cell, CSV_CELL *other) {
+  if (cell->is_null || other->is_null) {
+    return cell->is_null - other->is_null;
+  }
+
+  switch (cell->field_type) {
+  case INT_TYPE:
+    return (cell->int_data > other->int_data) -
+           (cell->int_data < other->int_data);
+  case DOUBLE_TYPE:
+    return (cell->double_data > other->double_data) -
+           (cell->double_data < other->double_data);
+  case CHAR_TYPE: {
+    size_t common = cell->char_length < other->char_length
+                        ? cell->char_length
+                        : other->char_length;
+    int order = memcmp(cell->char_data, other->char_data, common);
+
+    if (order != 0) {
+      return order < 0 ? -1 : 1;
+    }
+
+    return (cell->char_length > other->char_length) -
+           (cell->char_length < other->char_length);
+  }
+  }
+
+  return 0;
+}
+
+static int compare_rows(size_t row, size_t other, const unsigned *keys,
+                        const CSV_DIRECTION *directions, unsigned total_keys,
+                        CSV_LIST *csv_list, CSV_METADATA *metadata) {
+  for (unsigned k = 0; k < total_keys; k++) {
+    CSV_CELL cell = {0};
+    CSV_CELL other_cell = {0};
+
+    csv_cell(row, keys[k], &cell, csv_list, metadata);
+    csv_cell(other, keys[k], &other_cell, csv_list, metadata);
+
+    int order = compare_cells(&cell, &other_cell);
+
+    if (order != 0) {
+      return directions[k] == CSV_DESCENDING ? -order : order;
+    }
+  }
+
+  return 0;
+}
+
+/************ CHECKS ************/
+
+static void check_sort(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                       const unsigned *keys, const CSV_DIRECTION *directions,
+                       unsigned total_keys, unsigned threads) {
+  CSV_OPTIONS options = {.threads = threads};
+  size_t total_rows = 0;
+
+  size_t *order = csv_sort(csv_list, metadata, keys, directions, total_keys,
+                           &total_rows, &options);
+
+  checks++;
+
+  if (order == NULL) {
+    printf("FAIL key %u, %u threads: no order\n", keys[0], threads);
+    failures++;
+    return;
+  }
+
+  size_t live = 0;
+
+  for (size_t row = 0; row < metadata->items; row++) {
+    live += !csv_row_removed(row, csv_list);
+  }
+
+  checks++;
+
+  if (total_rows != live) {
+    printf("FAIL key %u, %u threads: %zu rows, %zu live\n", keys[0], threads,
+           total_rows, live);
+    failures++;
+    free(order);
+    return;
+  }
+
+  bool *seen = calloc(metadata->items, sizeof(bool));
+  unsigned mismatches = 0;
+
+  for (size_t i = 0; i < total_rows && seen != NULL; i++) {
+    size_t row = order[i];
+    bool valid = row < metadata->items && !seen[row] &&
+                 !csv_row_removed(row, csv_list);
+
+    /* -- Stable, rows that tie keep their order */
+    if (valid && i > 0) {
+      int rank = compare_rows(order[i - 1], row, keys, directions, total_keys,
+                              csv_list, metadata);
+
+      valid = rank < 0 || (rank == 0 && order[i - 1] < row);
+    }
+
+    if (valid) {
+      seen[row] = true;
+    }
+
+    checks++;
+
+    if (!valid) {
+      if (mismatches++ == 0) {
+        printf("FAIL key %u, %u threads: row %zu out of order at %zu\n",
+               keys[0], threads, row, i);
+      }
+
+      failures++;
+    }
+  }
+
+  free(seen);
+  free(order);
+}
+
+static void check_permute(CSV_LIST *csv_list, CSV_METADATA *metadata,
+                          CSV_OPTIONS *options) {
+  unsigned keys[] = {3, 0};
+  CSV_DIRECTION directions[] = {CSV_DESCENDING, CSV_ASCENDING};
+  size_t total_rows = 0;
+
+  size_t *order =
+      csv_sort(csv_list, metadata, keys, directions, 2, &total_rows, NULL);
+
+  CSV_METADATA *sorted_metadata = NULL;
+  CSV_LIST *sorted_list = csv_import_ex(TEST_FILE, &sorted_metadata, options);
+
+  checks++;
+
+  if (order == NULL || sorted_list == NULL) {
+    printf("FAIL permute: no order or list\n");
+    failures++;
+    free(order);
+
+    if (sorted_list != NULL) {
+      csv_clear(sorted_list, sorted_metadata);
+    }
+
+    return;
+  }
+
+  checks++;
+
+  if (csv_permute(sorted_list, sorted_metadata, order, total_rows) != 0 ||
+      sorted_metadata->items != total_rows) {
+    printf("FAIL permute: %u rows, %zu sorted\n", sorted_metadata->items,
+           total_rows);
+    failures++;
+  } else {
+    unsigned mismatches = 0;
+
+    for (size_t i = 0; i < total_rows; i++) {
+      for (unsigned column = 0; column < metadata->fields; column++) {
+        CSV_CELL expected = {0};
+        CSV_CELL cell = {0};
+
+        csv_cell(order[i], column, &expected, csv_list, metadata);
+        csv_cell(i, column, &cell, sorted_list, sorted_metadata);
+
+        checks++;
+
+        if (compare_cells(&expected, &cell) != 0 ||
+            expected.is_null != cell.is_null) {
+          if (mismatches++ == 0) {
+            printf("FAIL permute: row %zu column %u differs\n", i, column);
+          }
+
+          failures++;
+        }
+      }
+    }
+  }
+
+  free(order);
+  csv_clear(sorted_list, sorted_metadata);
+}
+
+int main(void) {
+  if (!write_file(TEST_FILE)) {
+    return 1;
+  }
+
+  CSV_DICTIONARY_MODE modes[] = {CSV_DICTIONARY_AUTO, CSV_DICTIONARY_OFF};
+
+  for (unsigned m = 0; m < sizeof(modes) / sizeof(*modes); m++) {
+    /* -- Removed rows stay in place, the sort must leave them out */
+    CSV_OPTIONS options = {.dictionary = modes[m], .compact_ratio = 1};
+    CSV_METADATA *metadata = NULL;
+
+    CSV_LIST *csv_list = csv_import_ex(TEST_FILE, &metadata, &options);
+
+    if (csv_list == NULL) {
+      printf("FAIL unable to import %s\n", TEST_FILE);
+      failures++;
+      continue;
+    }
+
+    size_t removed[TEST_ROWS / 97 + 1];
+    size_t total_removed = 0;
+
+    for (size_t row = 5; row < metadata->items; row += 97) {
+      removed[total_removed++] = row;
+    }
+
+    csv_remove_rows(removed, total_removed, csv_list, metadata);
+
+    unsigned id[] = {0};
+    unsigned group_score[] = {1, 2};
+    unsigned name_group[] = {3, 1};
+    unsigned score[] = {2};
+
+    CSV_DIRECTION ascending[] = {CSV_ASCENDING, CSV_ASCENDING};
+    CSV_DIRECTION descending[] = {CSV_DESCENDING, CSV_DESCENDING};
+    CSV_DIRECTION mixed[] = {CSV_ASCENDING, CSV_DESCENDING};
+
+    unsigned threads[] = {0, 4};
+
+    for (unsigned t = 0; t < sizeof(threads) / sizeof(*threads); t++) {
+      check_sort(csv_list, metadata, id, descending, 1, threads[t]);
+      check_sort(csv_list, metadata, score, ascending, 1, threads[t]);
+      check_sort(csv_list, metadata, score, descending, 1, threads[t]);
+      check_sort(csv_list, metadata, group_score, mixed, 2, threads[t]);
+      check_sort(csv_list, metadata, name_group, ascending, 2, threads[t]);
+      check_sort(csv_list, metadata, name_group, descending, 2, threads[t]);
+    }
+
+    check_permute(csv_list, metadata, &options);
+
+    csv_clear(csv_list, metadata);
+  }
+
+  remove(TEST_FILE);
+
+  printf("%lu checks, %lu failures\n", checks, failures);
+
+  return failures == 0 ? 0 : 1;
+}
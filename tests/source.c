@@ -0,0 +1,388 @@
+/**
+ * @file source.c
+ * @author Suraj Kareppagol (surajkareppagol.dev@gmail.com)
+ * @brief Checks imports from sources, gzip and zlib data, memory and a
+ * callback, cell by cell against the import of the plain file
+ *
+ * @version 0.1
+ * @date 2025-01-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include <libcsv.h>
+
+#define TEST_FILE "build/source.csv"
+#define GZIP_FILE "build/source.csv.gz"
+#define CUT_FILE "build/source-cut.csv.gz"
+#define TEST_ROWS 20000
+
+static unsigned long checks = 0;
+static unsigned long failures = 0;
+
+/* -- xorshift64*, the same sequence on every run */
+static uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t next_random(void) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
+/************ INPUT ************/
+
+static const char *notes[] = {"plain", "\"a,b\"", "\"say \"\"hi\"\"\"",
+                              "\"two\nlines\"", ""};
+
+/* -- The text of the file, kept for the memory and zlib sources */
+static char *text = NULL;
+static size_t text_size = 0;
+
+static bool write_file(const char *csv_file) {
+  FILE *csv_stream = fopen(csv_file, "w");
+
+  if (csv_stream == NULL) {
+    printf("FAIL unable to write %s\n", csv_file);
+    return false;
+  }
+
+  fprintf(csv_stream, "id,count,score,note\n");
+
+  for (unsigned row = 0; row < TEST_ROWS; row++) {
+    uint64_t random = next_random();
+
+    fprintf(csv_stream, "%u,%lld,%.3f,%s\n", row,
+            (long long)(random >> 20) - (1LL << 43),
+            (double)(random >> 44) / 1000,
+            notes[random % (sizeof(notes) / sizeof(*notes))]);
+  }
+
+  if (fclose(csv_stream) != 0) {
+    return false;
+  }
+
+  csv_stream = fopen(csv_file, "rb");
+
+  if (csv_stream == NULL) {
+    return false;
+  }
+
+  fseek(csv_stream, 0, SEEK_END);
+  text_size = ftell(csv_stream);
+  fseek(csv_stream, 0, SEEK_SET);
+
+  text = malloc(text_size);
+
+  bool read = text != NULL &&
+              fread(text, 1, text_size, csv_stream) == text_size;
+
+  fclose(csv_stream);
+
+  return read;
+}
+
+/* -- Two gzip members, then zero padding as some tools leave it */
+static bool write_gzip(const char *gzip_file) {
+  size_t half = text_size / 2;
+
+  gzFile gzip_stream = gzopen(gzip_file, "wb");
+
+  if (gzip_stream == NULL ||
+      gzwrite(gzip_stream, text, half) != (int)half ||
+      gzclose(gzip_stream) != Z_OK) {
+    printf("FAIL unable to write %s\n", gzip_file);
+    return false;
+  }
+
+  gzip_stream = gzopen(gzip_file, "ab");
+
+  if (gzip_stream == NULL ||
+      gzwrite(gzip_stream, text + half, text_size - half) !=
+          (int)(text_size - half) ||
+      gzclose(gzip_stream) != Z_OK) {
+    printf("FAIL unable to append to %s\n", gzip_file);
+    return false;
+  }
+
+  FILE *gzip_file_stream = fopen(gzip_file, "ab");
+  char padding[512] = {0};
+
+  if (gzip_file_stream == NULL ||
+      fwrite(padding, 1, sizeof(padding), gzip_file_stream) !=
+          sizeof(padding)) {
+    printf("FAIL unable to pad %s\n", gzip_file);
+
+    if (gzip_file_stream != NULL) {
+      fclose(gzip_file_stream);
+    }
+
+    return false;
+  }
+
+  return fclose(gzip_file_stream) == 0;
+}
+
+/************ COMPARE ************/
+
+static bool same_cell(CSV_CELL *expected, CSV_CELL *cell) {
+  if (expected->is_null || cell->is_null) {
+    return expected->is_null == cell->is_null;
+  }
+
+  if (expected->field_type != cell->field_type) {
+    return false;
+  }
+
+  switch (cell->field_type) {
+  case CHAR_TYPE:
+    return expected->char_length == cell->char_length &&
+           memcmp(expected->char_data, cell->char_data, cell->char_length) ==
+               0;
+  case INT_TYPE:
+    return expected->int_data == cell->int_data;
+  case DOUBLE_TYPE:
+    return memcmp(&expected->double_data, &cell->double_data,
+                  sizeof(double)) == 0;
+  }
+
+  return false;
+}
+
+static void check_source(const char *name, CSV_SOURCE *source,
+                         CSV_LIST *expected_list,
+                         CSV_METADATA *expected_metadata) {
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = csv_import_source(source, &metadata, NULL);
+
+  checks++;
+
+  if (csv_list == NULL) {
+    printf("FAIL %s: no list\n", name);
+    failures++;
+    return;
+  }
+
+  checks++;
+
+  if (metadata->items != expected_metadata->items ||
+      metadata->fields != expected_metadata->fields) {
+    printf("FAIL %s: %u rows of %u fields, %u of %u expected\n", name,
+           metadata->items, metadata->fields, expected_metadata->items,
+           expected_metadata->fields);
+    failures++;
+    csv_clear(csv_list, metadata);
+    return;
+  }
+
+  unsigned mismatches = 0;
+
+  for (size_t row = 0; row < metadata->items; row++) {
+    for (unsigned column = 0; column < metadata->fields; column++) {
+      CSV_CELL expected = {0};
+      CSV_CELL cell = {0};
+
+      csv_cell(row, column, &expected, expected_list, expected_metadata);
+
+      checks++;
+
+      if (!csv_cell(row, column, &cell, csv_list, metadata) ||
+          !same_cell(&expected, &cell)) {
+        if (mismatches++ == 0) {
+          printf("FAIL %s: row %zu column %u differs\n", name, row, column);
+        }
+
+        failures++;
+      }
+    }
+  }
+
+  csv_clear(csv_list, metadata);
+}
+
+/************ CALLBACK ************/
+
+typedef struct {
+  size_t position;
+  bool closed;
+} CALLBACK_CONTEXT;
+
+/* -- One byte a call, every row and quote is cut between reads */
+static ptrdiff_t read_byte(void *data, size_t size, void *context) {
+  CALLBACK_CONTEXT *callback = context;
+
+  if (size == 0 || callback->position == text_size) {
+    return 0;
+  }
+
+  *(char *)data = text[callback->position++];
+
+  return 1;
+}
+
+static void close_callback(void *context) {
+  ((CALLBACK_CONTEXT *)context)->closed = true;
+}
+
+/************ CHECKS ************/
+
+static void check_sources(CSV_LIST *csv_list, CSV_METADATA *metadata) {
+  check_source("gzip", csv_source_gzip(csv_source_file(GZIP_FILE)), csv_list,
+               metadata);
+
+  check_source("memory", csv_source_memory(text, text_size), csv_list,
+               metadata);
+
+  CALLBACK_CONTEXT callback = {0};
+
+  check_source("callback",
+               csv_source_callback(read_byte, close_callback, &callback),
+               csv_list, metadata);
+
+  checks++;
+
+  if (!callback.closed) {
+    printf("FAIL callback: the source was not closed\n");
+    failures++;
+  }
+
+  /* -- A zlib stream, not a gzip one */
+  uLongf zlib_size = compressBound(text_size);
+  Bytef *zlib_data = malloc(zlib_size);
+
+  checks++;
+
+  if (zlib_data == NULL ||
+      compress2(zlib_data, &zlib_size, (const Bytef *)text, text_size, 6) !=
+          Z_OK) {
+    printf("FAIL unable to compress the text\n");
+    failures++;
+  } else {
+    check_source("zlib",
+                 csv_source_gzip(
+                     csv_source_memory((const char *)zlib_data, zlib_size)),
+                 csv_list, metadata);
+  }
+
+  free(zlib_data);
+}
+
+/* -- Truncated data and missing files are errors, not short lists */
+static void check_failures(void) {
+  FILE *gzip_stream = fopen(GZIP_FILE, "rb");
+  FILE *cut_stream = fopen(CUT_FILE, "wb");
+
+  if (gzip_stream == NULL || cut_stream == NULL) {
+    printf("FAIL unable to write %s\n", CUT_FILE);
+    failures++;
+
+    if (gzip_stream != NULL) {
+      fclose(gzip_stream);
+    }
+
+    if (cut_stream != NULL) {
+      fclose(cut_stream);
+    }
+
+    return;
+  }
+
+  /* -- The first member ends half way through, no trailer */
+  char buffer[4096];
+  size_t cut = 0;
+  size_t bytes = 0;
+
+  while ((bytes = fread(buffer, 1, sizeof(buffer), gzip_stream)) > 0 &&
+         cut < 64 * 1024) {
+    fwrite(buffer, 1, bytes, cut_stream);
+    cut += bytes;
+  }
+
+  fclose(gzip_stream);
+  fclose(cut_stream);
+
+  /* -- The refused imports explain themselves on stderr, keep it quiet */
+  int error_fd = dup(STDERR_FILENO);
+  int null_fd = open("/dev/null", O_WRONLY);
+
+  fflush(stderr);
+  dup2(null_fd, STDERR_FILENO);
+
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list =
+      csv_import_source(csv_source_gzip(csv_source_file(CUT_FILE)),
+                        &metadata, NULL);
+
+  checks++;
+
+  if (csv_list != NULL) {
+    printf("FAIL a truncated gzip file imports %u rows\n", metadata->items);
+    failures++;
+    csv_clear(csv_list, metadata);
+  }
+
+  csv_list = csv_import_source(csv_source_file("build/source-missing.csv"),
+                               &metadata, NULL);
+
+  checks++;
+
+  if (csv_list != NULL) {
+    printf("FAIL a missing file imports\n");
+    failures++;
+    csv_clear(csv_list, metadata);
+  }
+
+  fflush(stderr);
+  dup2(error_fd, STDERR_FILENO);
+  close(error_fd);
+  close(null_fd);
+
+  remove(CUT_FILE);
+}
+
+int main(void) {
+  if (!write_file(TEST_FILE) || !write_gzip(GZIP_FILE)) {
+    free(text);
+    return 1;
+  }
+
+  CSV_METADATA *metadata = NULL;
+  CSV_LIST *csv_list = csv_import(TEST_FILE, &metadata);
+
+  checks++;
+
+  if (csv_list == NULL || metadata->items != TEST_ROWS) {
+    printf("FAIL unable to import %s\n", TEST_FILE);
+    failures++;
+  } else {
+    check_sources(csv_list, metadata);
+  }
+
+  check_failures();
+
+  if (csv_list != NULL) {
+    csv_clear(csv_list, metadata);
+  }
+
+  free(text);
+  remove(TEST_FILE);
+  remove(GZIP_FILE);
+
+  printf("%lu checks, %lu failures\n", checks, failures);
+
+  return failures == 0 ? 0 : 1;
+}
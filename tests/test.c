@@ -1,5 +1,6 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <libcsv.h>
 
@@ -23,57 +24,55 @@ int main(int argc, char **argv) {
 
   printf("\n");
 
-  unsigned int row = 0;
-  unsigned int field = 0;
-  bool last_row = false;
+  /************ csv_row() ************/
 
-  while (1) {
-    for (int i = 0; i < metadata->fields; i++) {
-      unsigned current_row = 0;
-      CSV_CHAR_BLOCK *block = csv_list->field_list[i]->char_block_head;
+  CSV_ROW cells = {0};
 
-      while (block != NULL) {
-        if (current_row == row) {
-          printf("| %10s | ", block->data);
-          break;
-        }
-        current_row += 1;
+  cells.cells = calloc(metadata->fields, sizeof(CSV_CELL));
 
-        block = block->next_block;
+  for (size_t index = 0; index < metadata->items; index++) {
+    if (!csv_row(index, &cells, csv_list, metadata)) {
+      continue;
+    }
 
-        if (block == NULL) {
-          last_row = true;
-        }
+    for (unsigned i = 0; i < cells.fields; i++) {
+      CSV_CELL *cell = &cells.cells[i];
+
+      switch (cell->field_type) {
+      case CHAR_TYPE:
+        printf("| %10.*s | ", (int)cell->char_length, cell->char_data);
+        break;
+      case INT_TYPE:
+        printf("| %10lld | ", (long long)cell->int_data);
+        break;
+      case DOUBLE_TYPE:
+        printf("| %10.2lf | ", cell->double_data);
+        break;
       }
     }
 
-    row += 1;
     printf("\n");
-
-    if (last_row) {
-      break;
-    }
   }
 
+  free(cells.cells);
+
   /************ csv_field() ************/
 
   printf("\nExtracting 'First name' field...\n");
 
   CSV_FIELD_LIST *first_field = csv_field("First name", csv_list, metadata);
 
-  CSV_CHAR_BLOCK *block = first_field->char_block_head;
+  CSV_ITERATOR block = csv_iterator(first_field);
 
-  while (block != NULL) {
-    printf("| %10s | ", block->data);
-
-    block = block->next_block;
+  while (csv_iterator_next(&block)) {
+    printf("| %10s | ", block.char_data);
   }
 
   printf("\n");
 
   /************ csv_export() ************/
 
-  csv_export(csv_list, NULL, metadata);
+  csv_export(csv_list, metadata, CSV_DEFAULT_FILE_NAME);
 
   /************ csv_column() ************/
 
@@ -81,23 +80,73 @@ int main(int argc, char **argv) {
 
   CSV_FIELD_LIST *first_column = csv_column(0, csv_list, metadata);
 
-  CSV_CHAR_BLOCK *column = first_column->char_block_head;
-
-  while (column != NULL) {
-    printf("| %10s | ", column->data);
+  CSV_ITERATOR column = csv_iterator(first_column);
 
-    column = column->next_block;
+  while (csv_iterator_next(&column)) {
+    printf("| %10s | ", column.char_data);
   }
 
   printf("\n");
 
+  /************ csv_agg_sum() ************/
+
+  printf("\nSumming 'Identifier' field...\n");
+
+  CSV_FIELD_LIST *identifier = csv_field("Identifier", csv_list, metadata);
+
+  printf("| %10.0f | %10.2f |\n", csv_agg_sum(identifier, NULL, CSV_SUM_FAST),
+         csv_agg_mean(identifier, NULL, CSV_SUM_FAST));
+
+  /************ csv_sort() ************/
+
+  printf("\nSorting by 'Identifier' field...\n");
+
+  unsigned sort_key = csv_field_index("Identifier", csv_list, metadata);
+  CSV_DIRECTION direction = CSV_DESCENDING;
+  size_t sorted_rows = 0;
+
+  size_t *order = csv_sort(csv_list, metadata, &sort_key, &direction, 1,
+                           &sorted_rows, NULL);
+
+  csv_export_ordered(csv_list, metadata, CSV_DEFAULT_FILE_NAME, order,
+                     sorted_rows);
+
+  free(order);
+
+  /************ csv_join() ************/
+
+  printf("\nJoining the list with itself on 'Identifier' field...\n");
+
+  CSV_METADATA *join_metadata = NULL;
+  CSV_JOIN join = {CSV_JOIN_INNER, sort_key, sort_key, NULL, NULL};
+
+  CSV_LIST *join_list = csv_join(csv_list, metadata, csv_list, metadata, &join,
+                                 &join_metadata, NULL);
+
+  if (join_list != NULL) {
+    csv_show(join_list, join_metadata);
+    csv_clear(join_list, join_metadata);
+  }
+
   /************ csv_add_row() ************/
 
   printf("\nAdding data row...\n");
 
-  csv_add_row("booker12, 9012, Rachel, Booker", csv_list, metadata);
+  char row[] = "booker12, 9012, Rachel, Booker";
+
+  csv_add_row(row, csv_list, metadata);
+
+  csv_export(csv_list, metadata, CSV_DEFAULT_FILE_NAME);
+
+  /* -- Doubles are written with two decimals, a large one is 300 digits */
+  printf("\nAdding a row with a large double...\n");
 
-  csv_export(csv_list, NULL, metadata);
+  char large_row[] = "large01, 1.5e300, Large, Double";
+
+  csv_add_row(large_row, csv_list, metadata);
+
+  csv_export(csv_list, metadata, CSV_DEFAULT_FILE_NAME);
+  csv_show(csv_list, metadata);
 
   /************ csv_remove_row() ************/
 
@@ -105,7 +154,9 @@ int main(int argc, char **argv) {
 
   csv_remove_row(2, csv_list, metadata);
 
-  csv_export(csv_list, NULL, metadata);
+  csv_export(csv_list, metadata, CSV_DEFAULT_FILE_NAME);
+
+  csv_clear(csv_list, metadata);
 
   return 0;
 }
\ No newline at end of file